@@ -0,0 +1,285 @@
+/*
+ *  bench.c
+ *  Contains 'apex_bench', which times the simulator itself: loading
+ *  programs, running them through the pipeline or the out-of-order
+ *  core, and fast-forwarding them with each engine. Every measurement
+ *  is repeated and reported with its mean, spread and rates
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpu.h"
+
+/* What is timed */
+enum
+{
+  BENCH_LOAD,         // APEX_cpu_init and APEX_cpu_stop
+  BENCH_PIPELINE,     // APEX_cpu_run on the in-order pipeline
+  BENCH_OOO,          // APEX_cpu_run on the out-of-order core
+  BENCH_TRANSLATE,    // APEX_cpu_fast_forward with each engine
+  BENCH_THREADED,
+  BENCH_INTERPRET,
+  BENCH_NUM
+};
+
+static const char* const bench_names[BENCH_NUM] = {
+  [BENCH_LOAD]      = "load",
+  [BENCH_PIPELINE]  = "pipeline",
+  [BENCH_OOO]       = "ooo",
+  [BENCH_TRANSLATE] = "translate",
+  [BENCH_THREADED]  = "threaded",
+  [BENCH_INTERPRET] = "interpret",
+};
+
+static const int bench_engines[BENCH_NUM] = {
+  [BENCH_TRANSLATE] = APEX_ENGINE_TRANSLATE,
+  [BENCH_THREADED]  = APEX_ENGINE_THREADED,
+  [BENCH_INTERPRET] = APEX_ENGINE_INTERPRET,
+};
+
+/* One timed run */
+typedef struct Sample
+{
+  double seconds;
+  long long cycles;         // Simulated, 0 where nothing is simulated
+  long long instructions;   // Retired, executed or loaded
+} Sample;
+
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Times one run of the program. Setting up the CPU is not timed, except
+ * in load mode where it is all that is timed.
+ * Returns 0, or -1 if the CPU cannot be set up.
+ */
+static int
+measure(const char* filename, int mode, int clockcycles,
+        const APEX_Config* config, Sample* sample)
+{
+  memset(sample, 0, sizeof(*sample));
+  double start = now();
+  APEX_CPU* cpu = APEX_cpu_init(filename, "quiet", clockcycles);
+  if (!cpu)
+  {
+    fprintf(stderr, "APEX_Error : Unable to initialize from %s\n", filename);
+    return -1;
+  }
+  if (mode == BENCH_LOAD)
+  {
+    sample->instructions = cpu->code_memory_size;
+    APEX_cpu_stop(cpu);
+    sample->seconds = now() - start;
+    return 0;
+  }
+
+  APEX_Config run_config = *config;
+  run_config.core = mode == BENCH_OOO ? APEX_CORE_OOO : APEX_CORE_INORDER;
+  if (APEX_cpu_configure(cpu, &run_config) != 0)
+  {
+    fprintf(stderr, "APEX_Error : Unable to allocate the data cache\n");
+    APEX_cpu_stop(cpu);
+    return -1;
+  }
+
+  if (mode == BENCH_PIPELINE || mode == BENCH_OOO)
+  {
+    start = now();
+    APEX_cpu_run(cpu);
+    sample->seconds = now() - start;
+    sample->cycles = cpu->clock;
+    sample->instructions = cpu->stats.retired;
+  }
+  else
+  {
+    cpu->fast_forward_engine = bench_engines[mode];
+    start = now();
+    sample->instructions = APEX_cpu_fast_forward(cpu, -1, LLONG_MAX);
+    sample->seconds = now() - start;
+  }
+  APEX_cpu_stop(cpu);
+  return 0;
+}
+
+/* Prints the mean, standard deviation and fastest of the runs, and the
+ * rates at the mean */
+static void
+report(const char* filename, int mode, const Sample* samples, int runs,
+       int csv)
+{
+  double sum = 0.0;
+  double best = samples[0].seconds;
+  for (int i = 0; i < runs; ++i)
+  {
+    sum += samples[i].seconds;
+    best = samples[i].seconds < best ? samples[i].seconds : best;
+  }
+  double mean = sum / runs;
+  double squares = 0.0;
+  for (int i = 0; i < runs; ++i)
+  {
+    squares += (samples[i].seconds - mean) * (samples[i].seconds - mean);
+  }
+  double stddev = runs > 1 ? sqrt(squares / (runs - 1)) : 0.0;
+  long long cycles = samples[0].cycles;
+  long long instructions = samples[0].instructions;
+  double cycle_rate = mean > 0.0 ? cycles / mean : 0.0;
+  double instruction_rate = mean > 0.0 ? instructions / mean : 0.0;
+
+  /* Cycles are left blank where nothing was simulated */
+  char cycles_text[32] = "";
+  char cycle_rate_text[32] = "";
+  if (cycles)
+  {
+    snprintf(cycles_text, sizeof(cycles_text), "%lld", cycles);
+    snprintf(cycle_rate_text, sizeof(cycle_rate_text), csv ? "%.0f" : "%.2f",
+             csv ? cycle_rate : cycle_rate / 1e6);
+  }
+  if (csv)
+  {
+    printf("%s,%s,%d,%.3f,%.3f,%.3f,%s,%lld,%s,%.0f\n", filename,
+           bench_names[mode], runs, mean * 1e3, stddev * 1e3, best * 1e3,
+           cycles_text, instructions, cycle_rate_text, instruction_rate);
+    return;
+  }
+  printf("%-24s %-9s %4d %10.2f %8.2f %10.2f %11s %12lld %9s %9.2f\n",
+         filename, bench_names[mode], runs, mean * 1e3, stddev * 1e3,
+         best * 1e3, cycles ? cycles_text : "-", instructions,
+         cycles ? cycle_rate_text : "-", instruction_rate / 1e6);
+}
+
+static void
+usage(const char* prog)
+{
+  fprintf(stderr, "APEX_Help : Usage %s [options] <input_file> [<input_file> ...]\n", prog);
+  fprintf(stderr, "APEX_Help :   --modes <list>    any of load,pipeline,ooo,translate,threaded,interpret\n");
+  fprintf(stderr, "APEX_Help :                     (pipeline,translate,threaded,interpret)\n");
+  fprintf(stderr, "APEX_Help :   --repeat <n>      timed runs of each (5)\n");
+  fprintf(stderr, "APEX_Help :   --cycles <n>      cycle limit of pipeline and ooo (none)\n");
+  fprintf(stderr, "APEX_Help :   --bypass, --halt, --width, --dcache and the other pipeline\n");
+  fprintf(stderr, "APEX_Help :                     options as for apex_sim, the mode picks the core\n");
+  fprintf(stderr, "APEX_Help :   --csv             print CSV rows\n");
+  exit(1);
+}
+
+int
+main(int argc, char const* argv[])
+{
+  int modes[BENCH_NUM] = { 0 };
+  int modes_set = 0;
+  int repeat = 5;
+  int clockcycles = -1;
+  int csv = 0;
+  APEX_Config config;
+  APEX_config_default(&config);
+
+  int i = 1;
+  for (; i < argc && strncmp(argv[i], "--", 2) == 0; ++i)
+  {
+    if (strcmp(argv[i], "--modes") == 0 && i + 1 < argc)
+    {
+      char* list = strdup(argv[++i]);
+      for (char* name = strtok(list, ","); name; name = strtok(NULL, ","))
+      {
+        int mode = 0;
+        while (mode < BENCH_NUM && strcmp(name, bench_names[mode]) != 0)
+        {
+          mode++;
+        }
+        if (mode == BENCH_NUM)
+        {
+          usage(argv[0]);
+        }
+        modes[mode] = 1;
+      }
+      free(list);
+      modes_set = 1;
+    }
+    else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+    {
+      repeat = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc)
+    {
+      clockcycles = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--csv") == 0)
+    {
+      csv = 1;
+    }
+    else if (i + 1 < argc &&
+             APEX_config_set(&config, argv[i] + 2, argv[i + 1]) == 0)
+    {
+      /* One of the pipeline options, see APEX_config_set */
+      ++i;
+    }
+    else
+    {
+      usage(argv[0]);
+    }
+  }
+  if (i == argc || repeat < 1)
+  {
+    usage(argv[0]);
+  }
+  if (!modes_set)
+  {
+    modes[BENCH_PIPELINE] = 1;
+    modes[BENCH_TRANSLATE] = 1;
+    modes[BENCH_THREADED] = 1;
+    modes[BENCH_INTERPRET] = 1;
+  }
+
+  Sample* samples = malloc(sizeof(*samples) * repeat);
+  if (!samples)
+  {
+    fprintf(stderr, "APEX_Error : Out of memory\n");
+    exit(1);
+  }
+  if (csv)
+  {
+    printf("program,mode,runs,mean_ms,stddev_ms,min_ms,cycles,instructions,"
+           "cycles_per_sec,instructions_per_sec\n");
+  }
+  else
+  {
+    printf("%-24s %-9s %4s %10s %8s %10s %11s %12s %9s %9s\n", "program",
+           "mode", "runs", "mean ms", "stddev", "min ms", "cycles",
+           "instructions", "Mcycles/s", "Minstr/s");
+  }
+
+  int status = 0;
+  for (; i < argc; ++i)
+  {
+    for (int mode = 0; mode < BENCH_NUM; ++mode)
+    {
+      int runs = 0;
+      while (modes[mode] && runs < repeat &&
+             measure(argv[i], mode, clockcycles, &config, &samples[runs]) == 0)
+      {
+        runs++;
+      }
+      if (runs)
+      {
+        report(argv[i], mode, samples, runs, csv);
+        fflush(stdout);
+      }
+      status |= modes[mode] && runs < repeat;
+    }
+  }
+  free(samples);
+  return status;
+}
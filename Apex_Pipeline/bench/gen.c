@@ -0,0 +1,256 @@
+/*
+ *  gen.c
+ *  Contains 'apex_gen', which writes synthetic APEX programs of a given
+ *  dynamic length to stdout, one per workload shape, for timing the
+ *  simulator
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Instructions in the body of the chain and stream loops */
+#define BODY 16
+
+static unsigned int rng_state = 1;
+
+/* Same sequence on every host for the same seed */
+static unsigned int
+rng(void)
+{
+  rng_state = rng_state * 1103515245u + 12345u;
+  return rng_state >> 8;
+}
+
+static long long
+iterations(long long instructions, long long per_iteration)
+{
+  long long n = instructions / per_iteration;
+  if (n < 1)
+  {
+    n = 1;
+  }
+  if (n > 0x7fffffff)
+  {
+    n = 0x7fffffff;
+  }
+  return n;
+}
+
+/* Closes a loop of body instructions counted down in R15 */
+static void
+end_loop(int body)
+{
+  printf("SUBL,R15,R15,#1\n");
+  printf("BNZ,#%d\n", -4 * (body + 1));
+  printf("HALT,\n");
+}
+
+/* Every instruction of the body depends on the one before it */
+static void
+gen_chain(long long instructions)
+{
+  static const char* const ops[] = {
+    "ADD,R1,R1,R2", "MUL,R1,R1,R3", "SUB,R1,R1,R2", "EX-OR,R1,R1,R3",
+    "OR,R1,R1,R2", "ADDL,R1,R1,#7", "SUBL,R1,R1,#1", "AND,R1,R1,R4",
+  };
+  printf("MOVC,R2,#3\nMOVC,R3,#5\nMOVC,R4,#-1\n");
+  printf("MOVC,R15,#%lld\n", iterations(instructions, BODY + 2));
+  for (int i = 0; i < BODY; ++i)
+  {
+    printf("%s\n", ops[i % 8]);
+  }
+  end_loop(BODY);
+}
+
+/* No instruction of the body depends on another */
+static void
+gen_stream(long long instructions)
+{
+  static const char* const ops[] = { "ADD", "SUB", "AND", "OR", "EX-OR", "MUL" };
+  printf("MOVC,R13,#3\nMOVC,R14,#5\n");
+  printf("MOVC,R15,#%lld\n", iterations(instructions, BODY + 2));
+  for (int i = 0; i < BODY; ++i)
+  {
+    printf("%s,R%d,R13,R14\n", ops[i % 6], 1 + i % 12);
+  }
+  end_loop(BODY);
+}
+
+/* A three instruction loop left through BZ */
+static void
+gen_loop(long long instructions)
+{
+  printf("MOVC,R1,#%lld\n", iterations(instructions, 3));
+  printf("SUBL,R1,R1,#1\n");
+  printf("BZ,#8\n");
+  printf("BNZ,#-8\n");
+  printf("HALT,\n");
+}
+
+/* Sweeps of span words, every stride words loaded, incremented and
+ * stored back */
+static void
+gen_stride(long long instructions, int span, int stride)
+{
+  int inner = span / stride > 0 ? span / stride : 1;
+  printf("MOVC,R15,#%lld\n", iterations(instructions, 6LL * inner + 4));
+  printf("MOVC,R3,#0\n");
+  printf("MOVC,R4,#%d\n", inner);
+  printf("LOAD,R2,R3,#0\n");
+  printf("ADDL,R2,R2,#1\n");
+  printf("STORE,R2,R3,#0\n");
+  printf("ADDL,R3,R3,#%d\n", stride);
+  printf("SUBL,R4,R4,#1\n");
+  printf("BNZ,#-20\n");
+  end_loop(8);
+}
+
+/* Loads and stores at addresses from a linear congruential generator,
+ * masked to span words */
+static void
+gen_random(long long instructions, int span)
+{
+  printf("MOVC,R0,#0\n");
+  printf("MOVC,R6,#%u\n", rng() & 0xffff);
+  printf("MOVC,R7,#1103515245\n");
+  printf("MOVC,R8,#%d\n", span - 1);
+  printf("MOVC,R15,#%lld\n", iterations(instructions, 8));
+  printf("MUL,R6,R6,R7\n");
+  printf("ADDL,R6,R6,#12345\n");
+  printf("AND,R9,R6,R8\n");
+  printf("LDR,R10,R9,R0\n");
+  printf("ADD,R10,R10,R6\n");
+  printf("STR,R10,R9,R0\n");
+  end_loop(6);
+}
+
+/* Random straight-line ALU, load and store instructions, for the cost of
+ * loading a program as much as of running it */
+static void
+gen_straight(long long instructions)
+{
+  static const char* const ops[] = { "ADD", "SUB", "MUL", "AND", "OR", "EX-OR" };
+  printf("MOVC,R13,#0\n");
+  for (int r = 1; r <= 12; ++r)
+  {
+    printf("MOVC,R%d,#%u\n", r, rng() % 100);
+  }
+  for (long long i = 14; i < instructions; ++i)
+  {
+    unsigned int k = rng() % 10;
+    int rd = 1 + rng() % 12;
+    if (k < 6)
+    {
+      printf("%s,R%d,R%d,R%d\n", ops[k], rd, 1 + rng() % 12, 1 + rng() % 12);
+    }
+    else if (k == 6)
+    {
+      printf("ADDL,R%d,R%d,#%u\n", rd, 1 + rng() % 12, rng() % 16);
+    }
+    else if (k == 7)
+    {
+      printf("MOVC,R%d,#%u\n", rd, rng() % 1000);
+    }
+    else if (k == 8)
+    {
+      printf("LOAD,R%d,R13,#%u\n", rd, rng() % 1024);
+    }
+    else
+    {
+      printf("STORE,R%d,R13,#%u\n", rd, rng() % 1024);
+    }
+  }
+  printf("HALT,\n");
+}
+
+static void
+usage(const char* prog)
+{
+  fprintf(stderr, "APEX_Help : Usage %s <workload> <instructions> [options]\n", prog);
+  fprintf(stderr, "APEX_Help :   workloads: chain    dependent ALU instructions in a loop\n");
+  fprintf(stderr, "APEX_Help :              stream   independent ALU instructions in a loop\n");
+  fprintf(stderr, "APEX_Help :              loop     a three instruction BZ loop\n");
+  fprintf(stderr, "APEX_Help :              stride   strided LOAD/STORE sweeps\n");
+  fprintf(stderr, "APEX_Help :              random   LDR/STR at pseudo-random addresses\n");
+  fprintf(stderr, "APEX_Help :              straight random code without branches\n");
+  fprintf(stderr, "APEX_Help :   --span <words>    data words touched, a power of two for random (4096)\n");
+  fprintf(stderr, "APEX_Help :   --stride <words>  step of the stride sweeps (1)\n");
+  fprintf(stderr, "APEX_Help :   --seed <n>        seed of random and straight (1)\n");
+  exit(1);
+}
+
+int
+main(int argc, char const* argv[])
+{
+  if (argc < 3)
+  {
+    usage(argv[0]);
+  }
+  long long instructions = atoll(argv[2]);
+  int span = 4096;
+  int stride = 1;
+  for (int i = 3; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--span") == 0 && i + 1 < argc)
+    {
+      span = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--stride") == 0 && i + 1 < argc)
+    {
+      stride = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+    {
+      rng_state = (unsigned int)atoi(argv[++i]);
+    }
+    else
+    {
+      usage(argv[0]);
+    }
+  }
+  if (instructions < 1 || span < 1 || stride < 1)
+  {
+    fprintf(stderr, "APEX_Error : Instructions, span and stride must be positive\n");
+    exit(1);
+  }
+
+  const char* workload = argv[1];
+  if (strcmp(workload, "chain") == 0)
+  {
+    gen_chain(instructions);
+  }
+  else if (strcmp(workload, "stream") == 0)
+  {
+    gen_stream(instructions);
+  }
+  else if (strcmp(workload, "loop") == 0)
+  {
+    gen_loop(instructions);
+  }
+  else if (strcmp(workload, "stride") == 0)
+  {
+    gen_stride(instructions, span, stride);
+  }
+  else if (strcmp(workload, "random") == 0)
+  {
+    if (span & (span - 1))
+    {
+      fprintf(stderr, "APEX_Error : The span of random must be a power of two\n");
+      exit(1);
+    }
+    gen_random(instructions, span);
+  }
+  else if (strcmp(workload, "straight") == 0)
+  {
+    gen_straight(instructions);
+  }
+  else
+  {
+    usage(argv[0]);
+  }
+  return 0;
+}
@@ -0,0 +1,133 @@
+#ifndef _APEX_H_
+#define _APEX_H_
+/**
+ *  apex.h
+ *  The libapex interface: an APEX simulator behind an opaque handle.
+ *  Every simulator keeps all of its state to itself, so any number of
+ *  them can run in one process, each on one thread at a time, and
+ *  everything one prints goes to its output callback
+ *
+ *  A typical use:
+ *
+ *    APEX_Sim_Stats stats;
+ *    APEX_Sim* sim = APEX_sim_create();
+ *    APEX_sim_set_option(sim, "predictor", "gshare");
+ *    if (APEX_sim_load(sim, "input.asm") == 0)
+ *    {
+ *      while (APEX_sim_step(sim, 1000) == APEX_SIM_READY)
+ *      {
+ *      }
+ *      APEX_sim_stats(sim, &stats);
+ *    }
+ *    APEX_sim_destroy(sim);
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#if defined(__GNUC__)
+#define APEX_API __attribute__((visibility("default")))
+#else
+#define APEX_API
+#endif
+
+typedef struct APEX_Sim APEX_Sim;
+
+/* Streams of the output callback */
+enum
+{
+  APEX_OUTPUT_REPORT,   // What apex_sim prints to stdout
+  APEX_OUTPUT_ERROR,    // and to stderr
+};
+
+/* Receives each piece of text a simulator prints, not always a whole
+ * line */
+typedef void (*APEX_Output)(void* context, int stream, const char* text);
+
+/* Polled before every cycle by APEX_sim_run_until, stops it when it
+ * returns non-zero */
+typedef int (*APEX_Until)(void* context, const APEX_Sim* sim);
+
+/* Where a simulator stands */
+enum
+{
+  APEX_SIM_EMPTY,       // No program loaded
+  APEX_SIM_READY,       // Can run further
+  APEX_SIM_HALTED,      // HALT reached writeback
+  APEX_SIM_COMPLETED,   // Every instruction retired, with HALT squashing
+  APEX_SIM_FAULT,       // Stopped at a load or store outside data memory
+  APEX_SIM_ERROR,       // Out of memory while running
+};
+
+typedef struct APEX_Sim_Stats
+{
+  int status;                   // APEX_SIM_*
+  int pc;                       // Next to fetch, or to commit out of order
+  long long cycles;
+  long long retired;            // Instructions that reached writeback
+  long long fast_forwarded;     // Instructions APEX_sim_fast_forward executed
+  long long branches;
+  long long mispredicted;
+  long long dcache_hits;
+  long long dcache_misses;
+} APEX_Sim_Stats;
+
+/* A simulator with the default options and no program, or NULL */
+APEX_API APEX_Sim*
+APEX_sim_create(void);
+
+/* Sends output to the callback, or to stdout and stderr if it is NULL */
+APEX_API void
+APEX_sim_set_output(APEX_Sim* sim, APEX_Output output, void* context);
+
+/*
+ * Sets an option before the program is loaded. Names and values are
+ * those of apex_sim without the dashes: bypass, halt, predictor, btb,
+ * dcache, width, units, core, ooo and fast-forward-engine, profile, on
+ * or off (the default), and mode, one of simulate, display or quiet (the
+ * default).
+ * Returns 0, or -1 for an unknown option or value, or once loaded.
+ */
+APEX_API int
+APEX_sim_set_option(APEX_Sim* sim, const char* name, const char* value);
+
+/* Loads an input file or image. Returns 0, or -1 if it cannot be */
+APEX_API int
+APEX_sim_load(APEX_Sim* sim, const char* filename);
+
+/* Executes up to that many instructions functionally before the first
+ * cycle. Returns the number executed, or -1 once cycles have run */
+APEX_API long long
+APEX_sim_fast_forward(APEX_Sim* sim, long long instructions);
+
+/* Runs up to that many cycles. Returns the APEX_SIM_* status */
+APEX_API int
+APEX_sim_step(APEX_Sim* sim, int cycles);
+
+/* Runs until until returns non-zero, or to the end if it is NULL, for at
+ * most max_cycles cycles, any number if negative. Returns the status */
+APEX_API int
+APEX_sim_run_until(APEX_Sim* sim, APEX_Until until, void* context,
+                   int max_cycles);
+
+/* Fills stats. Returns the status */
+APEX_API int
+APEX_sim_stats(const APEX_Sim* sim, APEX_Sim_Stats* stats);
+
+/* Architectural state, 0 outside it or before a program is loaded */
+APEX_API int
+APEX_sim_register(const APEX_Sim* sim, int reg);
+
+APEX_API int
+APEX_sim_memory(const APEX_Sim* sim, int address);
+
+/* Prints the final state and counters, as in "display" mode, and the
+ * profile if there is one */
+APEX_API void
+APEX_sim_display(APEX_Sim* sim);
+
+APEX_API void
+APEX_sim_destroy(APEX_Sim* sim);
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ *  asm.c
+ *  Assembles an APEX input file into a binary image that apex_sim
+ *  can map directly into code memory
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+
+int
+main(int argc, char const* argv[])
+{
+  if (argc != 3) {
+    fprintf(stderr, "APEX_Help : Usage %s <input_file> <image_file>\n", argv[0]);
+    exit(1);
+  }
+
+  int size = 0;
+  APEX_Instruction* code_memory = create_code_memory(argv[1], &size);
+  if (!code_memory)
+  {
+    fprintf(stderr, "APEX_Error : Unable to parse %s\n", argv[1]);
+    exit(1);
+  }
+
+  if (write_code_image(argv[2], code_memory, size) != 0)
+  {
+    fprintf(stderr, "APEX_Error : Unable to write %s\n", argv[2]);
+    free(code_memory);
+    exit(1);
+  }
+
+  free(code_memory);
+  return 0;
+}
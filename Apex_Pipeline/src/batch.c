@@ -0,0 +1,386 @@
+/*
+ *  batch.c
+ *  Runs the programs listed in a manifest on a pool of worker threads
+ *  and prints one summary row per job
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "cpu.h"
+
+/* One line of the manifest and its result */
+typedef struct APEX_Job
+{
+  char* filename;
+  int clockcycles;
+  char* options;            // Pipeline options as listed, "" for none
+  APEX_Config config;
+
+  int status;               // 0 if the CPU could not be initialized
+  int halted;
+  int faulted;              // A load or store left data memory
+  int cycles;
+  APEX_Stats stats;
+} APEX_Job;
+
+/* State shared by the workers, jobs are claimed in manifest order */
+typedef struct APEX_Batch
+{
+  APEX_Job* jobs;
+  int num_jobs;
+  int next_job;
+  pthread_mutex_t lock;
+} APEX_Batch;
+
+/*
+ * Reads the pipeline options following the clock cycles of a line, pairs
+ * of "--<option> <value>" as apex_sim takes them, into config and their
+ * text into options. Returns 0, or -1 after reporting the first option
+ * that is unknown or invalid.
+ */
+static int
+read_job_options(const char* manifest, int line_num, APEX_Config* config,
+                 char* options, size_t size)
+{
+  APEX_config_default(config);
+  options[0] = '\0';
+  char* name;
+  while ((name = strtok(NULL, " \t\r\n")))
+  {
+    char* value = strtok(NULL, " \t\r\n");
+    int set = strncmp(name, "--", 2) != 0
+                  ? -2 : APEX_config_set(config, name + 2, value ? value : "");
+    if (set != 0 || !value)
+    {
+      fprintf(stderr, "APEX_Error : %s:%d: %s option %s\n", manifest,
+              line_num, set == -2 ? "unknown" : value ? "invalid" : "no value for",
+              name);
+      return -1;
+    }
+    snprintf(options + strlen(options), size - strlen(options), "%s%s %s",
+             options[0] ? " " : "", name, value);
+  }
+  return 0;
+}
+
+/*
+ * Reads "<input_file> <clock_cycles> [--<option> <value> ...]" lines,
+ * skipping blank lines and lines starting with '#', so a manifest can
+ * list programs, configurations or both. A line with a malformed cycle
+ * count or option is reported and skipped. Returns 0 on success, even
+ * if no job is listed, and -1 if the manifest cannot be opened or memory
+ * runs out.
+ */
+static int
+read_manifest(const char* manifest, APEX_Job** out_jobs, int* num_jobs)
+{
+  FILE* fp = fopen(manifest, "r");
+  if (!fp)
+  {
+    fprintf(stderr, "APEX_Error : Unable to read manifest %s\n", manifest);
+    return -1;
+  }
+
+  char* line = NULL;
+  size_t len = 0;
+  int capacity = 0;
+  int count = 0;
+  int line_num = 0;
+  int failed = 0;
+  APEX_Job* jobs = NULL;
+
+  while (getline(&line, &len, fp) != -1)
+  {
+    line_num++;
+    char* filename = strtok(line, " \t\r\n");
+    if (!filename || filename[0] == '#')
+    {
+      continue;
+    }
+    char* cycles = strtok(NULL, " \t\r\n");
+    if (!cycles)
+    {
+      fprintf(stderr, "APEX_Error : %s:%d: missing clock cycles\n",
+              manifest, line_num);
+      continue;
+    }
+    char* end;
+    errno = 0;
+    long clockcycles = strtol(cycles, &end, 10);
+    if (end == cycles || *end != '\0' || errno == ERANGE ||
+        clockcycles < INT_MIN || clockcycles > INT_MAX)
+    {
+      fprintf(stderr, "APEX_Error : %s:%d: invalid clock cycles %s\n",
+              manifest, line_num, cycles);
+      continue;
+    }
+    APEX_Config config;
+    char options[256];
+    if (read_job_options(manifest, line_num, &config, options,
+                         sizeof(options)) != 0)
+    {
+      continue;
+    }
+
+    if (count == capacity)
+    {
+      capacity = capacity ? capacity * 2 : 64;
+      APEX_Job* grown = realloc(jobs, sizeof(*jobs) * capacity);
+      if (!grown)
+      {
+        failed = 1;
+        break;
+      }
+      jobs = grown;
+    }
+    memset(&jobs[count], 0, sizeof(jobs[count]));
+    jobs[count].filename = strdup(filename);
+    jobs[count].options = strdup(options);
+    if (!jobs[count].filename || !jobs[count].options)
+    {
+      free(jobs[count].filename);
+      free(jobs[count].options);
+      failed = 1;
+      break;
+    }
+    jobs[count].clockcycles = (int)clockcycles;
+    jobs[count].config = config;
+    count++;
+  }
+
+  free(line);
+  fclose(fp);
+  if (failed)
+  {
+    fprintf(stderr, "APEX_Error : Out of memory reading manifest %s at line %d\n",
+            manifest, line_num);
+    for (int i = 0; i < count; ++i)
+    {
+      free(jobs[i].filename);
+      free(jobs[i].options);
+    }
+    free(jobs);
+    return -1;
+  }
+  *out_jobs = jobs;
+  *num_jobs = count;
+  return 0;
+}
+
+/*
+ * Simulates a single job on its own CPU, nothing is shared with other
+ * workers apart from the read-only opcode table
+ */
+static void
+run_job(APEX_Job* job)
+{
+  APEX_CPU* cpu = APEX_cpu_init(job->filename, "quiet", job->clockcycles);
+  if (!cpu)
+  {
+    return;
+  }
+  if (APEX_cpu_configure(cpu, &job->config) != 0)
+  {
+    APEX_cpu_stop(cpu);
+    return;
+  }
+
+  job->faulted = APEX_cpu_run(cpu) != 0;
+  APEX_cpu_print_fault(cpu);
+  job->status = 1;
+  job->halted = cpu->halt_flag;
+  job->cycles = cpu->clock;
+  job->stats = cpu->stats;
+  APEX_cpu_stop(cpu);
+}
+
+static void*
+batch_worker(void* arg)
+{
+  APEX_Batch* batch = arg;
+  while (1)
+  {
+    pthread_mutex_lock(&batch->lock);
+    int index = batch->next_job++;
+    pthread_mutex_unlock(&batch->lock);
+
+    if (index >= batch->num_jobs)
+    {
+      break;
+    }
+    run_job(&batch->jobs[index]);
+  }
+  return NULL;
+}
+
+static const char*
+job_status(const APEX_Job* job)
+{
+  if (!job->status)
+  {
+    return "error";
+  }
+  if (job->faulted)
+  {
+    return "fault";
+  }
+  if (job->halted)
+  {
+    return "halted";
+  }
+  return job->cycles == job->clockcycles ? "cycle_limit" : "completed";
+}
+
+/* Writes a CSV field, quoted if it holds a separator, doubling any
+ * quotes */
+static void
+print_csv_field(const char* text)
+{
+  if (text[strcspn(text, ",\"\r\n")])
+  {
+    putchar('"');
+    for (const char* c = text; *c; ++c)
+    {
+      if (*c == '"')
+      {
+        putchar('"');
+      }
+      putchar(*c);
+    }
+    putchar('"');
+  }
+  else
+  {
+    fputs(text, stdout);
+  }
+}
+
+static void
+print_job_csv(int index, const APEX_Job* job)
+{
+  printf("%d,", index);
+  print_csv_field(job->filename);
+  putchar(',');
+  print_csv_field(job->options);
+  printf(",%s,%d,%lld", job_status(job), job->cycles, job->stats.retired);
+  for (int i = 0; i < APEX_CPI_NUM; ++i)
+  {
+    printf(",%lld", job->stats.cycles[i]);
+  }
+  printf(",%lld,%lld\n", job->stats.branches, job->stats.mispredicted);
+}
+
+/* Writes a JSON string, escaping quotes and backslashes */
+static void
+print_json_string(const char* text)
+{
+  putchar('"');
+  for (const char* c = text; *c; ++c)
+  {
+    if (*c == '"' || *c == '\\')
+    {
+      putchar('\\');
+    }
+    putchar(*c);
+  }
+  putchar('"');
+}
+
+static void
+print_job_json(int index, const APEX_Job* job)
+{
+  printf("{\"job\":%d,\"program\":", index);
+  print_json_string(job->filename);
+  printf(",\"options\":");
+  print_json_string(job->options);
+  printf(",\"status\":\"%s\",\"cycles\":%d,\"instructions\":%lld,"
+         "\"cpi_stack\":{",
+         job_status(job), job->cycles, job->stats.retired);
+  for (int i = 0; i < APEX_CPI_NUM; ++i)
+  {
+    printf("%s\"%s\":%lld", i ? "," : "", cpi_names[i], job->stats.cycles[i]);
+  }
+  printf("},\"branches\":%lld,\"mispredicted\":%lld}\n",
+         job->stats.branches, job->stats.mispredicted);
+}
+
+/*
+ * Runs every job of the manifest on the given number of threads. Rows are
+ * printed in manifest order once all jobs are done, as CSV or JSON lines.
+ */
+int
+APEX_run_batch(const char* manifest, int jobs, int json)
+{
+  APEX_Batch batch;
+  batch.jobs = NULL;
+  batch.num_jobs = 0;
+  batch.next_job = 0;
+  if (read_manifest(manifest, &batch.jobs, &batch.num_jobs) != 0)
+  {
+    return -1;
+  }
+  pthread_mutex_init(&batch.lock, NULL);
+
+  if (jobs < 1)
+  {
+    jobs = 1;
+  }
+  pthread_t* workers = malloc(sizeof(*workers) * jobs);
+  int started = 0;
+  for (int i = 0; workers && i < jobs; ++i)
+  {
+    if (pthread_create(&workers[i], NULL, batch_worker, &batch) != 0)
+    {
+      break;
+    }
+    started++;
+  }
+
+  /* Fall back to the calling thread if no worker could be started */
+  if (!started)
+  {
+    batch_worker(&batch);
+  }
+  for (int i = 0; i < started; ++i)
+  {
+    pthread_join(workers[i], NULL);
+  }
+
+  int failed = 0;
+  if (!json)
+  {
+    printf("job,program,options,status,cycles,instructions");
+    for (int i = 0; i < APEX_CPI_NUM; ++i)
+    {
+      printf(",%s", cpi_names[i]);
+    }
+    printf(",branches,mispredicted\n");
+  }
+  for (int i = 0; i < batch.num_jobs; ++i)
+  {
+    if (json)
+    {
+      print_job_json(i, &batch.jobs[i]);
+    }
+    else
+    {
+      print_job_csv(i, &batch.jobs[i]);
+    }
+    failed += !batch.jobs[i].status;
+    free(batch.jobs[i].filename);
+    free(batch.jobs[i].options);
+  }
+
+  free(workers);
+  free(batch.jobs);
+  pthread_mutex_destroy(&batch.lock);
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,682 @@
+/*
+ *  cache.c
+ *  Contains the L1 data cache model between Memory 1 and data memory
+ *
+ *  Only tags are modelled: loads and stores still read and write
+ *  data_memory, the cache decides how long Memory 1 takes to do so.
+ *  In a multicore run the caches of the cores are kept coherent over a
+ *  shared bus with MSI or MESI.
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+/* 64 sets of 2 ways with 16 byte lines (2KB), LRU, write-back and a
+ * 10 cycle miss, used for any field --dcache does not set */
+static const APEX_Cache_Config dcache_defaults = {
+  .sets = 64,
+  .ways = 2,
+  .line_bytes = 16,
+  .replacement = APEX_REPLACE_LRU,
+  .write_policy = APEX_WRITE_BACK,
+  .miss_latency = 10,
+};
+
+static int
+is_power_of_two(int value)
+{
+  return value > 0 && !(value & (value - 1));
+}
+
+/*
+ * Sets the cache from "off", "on" or a comma separated list of
+ * sets=N, ways=N, line=BYTES, replace=lru|random, write=back|through
+ * and miss=CYCLES. Returns 0 on success, -1 on an invalid list.
+ */
+int
+APEX_dcache_parse(APEX_Cache_Config* config, const char* list)
+{
+  if (strcmp(list, "off") == 0)
+  {
+    memset(config, 0, sizeof(*config));
+    return 0;
+  }
+
+  APEX_Cache_Config parsed = dcache_defaults;
+  if (strcmp(list, "on") != 0)
+  {
+    const char* field = list;
+    while (1)
+    {
+      size_t length = strcspn(field, ",");
+      const char* value = memchr(field, '=', length);
+      if (!value)
+      {
+        return -1;
+      }
+      size_t key_length = value - field;
+      value++;
+      size_t value_length = length - key_length - 1;
+
+#define KEY_IS(name) \
+      (key_length == sizeof(name) - 1 && strncmp(field, name, key_length) == 0)
+#define VALUE_IS(name) \
+      (value_length == sizeof(name) - 1 && strncmp(value, name, value_length) == 0)
+
+      if (KEY_IS("sets"))
+      {
+        parsed.sets = atoi(value);
+      }
+      else if (KEY_IS("ways"))
+      {
+        parsed.ways = atoi(value);
+      }
+      else if (KEY_IS("line"))
+      {
+        parsed.line_bytes = atoi(value);
+      }
+      else if (KEY_IS("miss"))
+      {
+        parsed.miss_latency = atoi(value);
+      }
+      else if (KEY_IS("replace") && (VALUE_IS("lru") || VALUE_IS("random")))
+      {
+        parsed.replacement = VALUE_IS("lru") ? APEX_REPLACE_LRU
+                                             : APEX_REPLACE_RANDOM;
+      }
+      else if (KEY_IS("write") && (VALUE_IS("back") || VALUE_IS("through")))
+      {
+        parsed.write_policy = VALUE_IS("back") ? APEX_WRITE_BACK
+                                               : APEX_WRITE_THROUGH;
+      }
+      else
+      {
+        return -1;
+      }
+#undef KEY_IS
+#undef VALUE_IS
+
+      if (field[length] == '\0')
+      {
+        break;
+      }
+      field += length + 1;
+    }
+  }
+
+  if (!APEX_dcache_valid(&parsed))
+  {
+    return -1;
+  }
+  *config = parsed;
+  return 0;
+}
+
+/* True for a disabled cache or a usable geometry */
+int
+APEX_dcache_valid(const APEX_Cache_Config* config)
+{
+  if (!config->sets)
+  {
+    return 1;
+  }
+  return is_power_of_two(config->sets) && config->ways > 0 &&
+         (long long)config->sets * config->ways <= APEX_DCACHE_MAX_LINES &&
+         is_power_of_two(config->line_bytes) && config->line_bytes >= 4 &&
+         config->miss_latency >= 0 &&
+         (config->replacement == APEX_REPLACE_LRU ||
+          config->replacement == APEX_REPLACE_RANDOM) &&
+         (config->write_policy == APEX_WRITE_BACK ||
+          config->write_policy == APEX_WRITE_THROUGH);
+}
+
+/* Allocates empty lines for the configured geometry */
+int
+APEX_dcache_init(APEX_Cache* cache, const APEX_Cache_Config* config)
+{
+  free(cache->lines);
+  memset(cache, 0, sizeof(*cache));
+  cache->random_state = 0x2545F491u;
+  if (!config->sets)
+  {
+    return 0;
+  }
+  cache->lines = calloc((size_t)config->sets * config->ways,
+                        sizeof(APEX_Cache_Line));
+  return cache->lines ? 0 : -1;
+}
+
+void
+APEX_dcache_free(APEX_Cache* cache)
+{
+  free(cache->lines);
+  cache->lines = NULL;
+}
+
+/* Way to refill in a full set */
+static int
+victim_way(APEX_Cache* cache, const APEX_Cache_Config* config,
+           const APEX_Cache_Line* set)
+{
+  if (config->replacement == APEX_REPLACE_RANDOM)
+  {
+    /* xorshift32, so runs are repeatable */
+    uint32_t x = cache->random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    cache->random_state = x;
+    return x % config->ways;
+  }
+
+  int victim = 0;
+  for (int way = 1; way < config->ways; ++way)
+  {
+    if (set[way].last_used < set[victim].last_used)
+    {
+      victim = way;
+    }
+  }
+  return victim;
+}
+
+/* Way of the set holding tag, or -1 on a miss */
+static int
+find_way(const APEX_Cache_Config* config, const APEX_Cache_Line* set,
+         uint32_t tag)
+{
+  for (int way = 0; way < config->ways; ++way)
+  {
+    if (set[way].valid && set[way].tag == tag)
+    {
+      return way;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Fills tag into a free or victim way of the set for a load or a store
+ * and returns that way. latency is set to the miss latency, plus the
+ * same again to write back a dirty victim.
+ */
+static int
+fill_line(APEX_CPU* cpu, APEX_Cache_Line* set, uint32_t tag, int is_store,
+          int* latency)
+{
+  const APEX_Cache_Config* config = &cpu->config.dcache;
+  APEX_Cache* cache = &cpu->dcache;
+  APEX_Stats* stats = &cpu->stats;
+
+  int victim = -1;
+  for (int way = 0; way < config->ways && victim < 0; ++way)
+  {
+    if (!set[way].valid)
+    {
+      victim = way;
+    }
+  }
+  *latency = config->miss_latency;
+  if (victim < 0)
+  {
+    victim = victim_way(cache, config, set);
+    stats->dcache_evictions++;
+    if (set[victim].dirty)
+    {
+      stats->dcache_writebacks++;
+      *latency += config->miss_latency;
+    }
+  }
+
+  set[victim].tag = tag;
+  set[victim].valid = 1;
+  set[victim].dirty = is_store;
+  set[victim].exclusive = 0;
+  set[victim].invalidated = 0;
+  set[victim].last_used = cache->clock;
+  return victim;
+}
+
+static int coherent_access(APEX_CPU* cpu, int addr, int is_store);
+
+/*
+ * Looks up the data memory word at addr for a load or a store and
+ * returns the cycles Memory 1 is held beyond its own.
+ *
+ * A miss costs the miss latency to fill the line, plus the same again
+ * to write back a dirty victim. Write-through stores update a line they
+ * hit, go to memory through a write buffer that never stalls, and do not
+ * allocate on a miss.
+ */
+int
+APEX_dcache_access(APEX_CPU* cpu, int addr, int is_store)
+{
+  if (cpu->interconnect)
+  {
+    return coherent_access(cpu, addr, is_store);
+  }
+
+  const APEX_Cache_Config* config = &cpu->config.dcache;
+  APEX_Cache* cache = &cpu->dcache;
+  APEX_Stats* stats = &cpu->stats;
+
+  uint32_t line = (uint32_t)addr / (config->line_bytes / 4);
+  uint32_t tag = line / config->sets;
+  APEX_Cache_Line* set = &cache->lines[(size_t)(line % config->sets) * config->ways];
+  int write_through = config->write_policy == APEX_WRITE_THROUGH;
+
+  cache->clock++;
+  if (is_store && write_through)
+  {
+    stats->dcache_write_throughs++;
+  }
+
+  int way = find_way(config, set, tag);
+  if (way >= 0)
+  {
+    stats->dcache_hits++;
+    set[way].last_used = cache->clock;
+    if (is_store && !write_through)
+    {
+      set[way].dirty = 1;
+    }
+    return 0;
+  }
+
+  stats->dcache_misses++;
+  if (is_store && write_through)
+  {
+    return 0;
+  }
+  int latency;
+  fill_line(cpu, set, tag, is_store, &latency);
+  return latency;
+}
+
+/* Coherence between the data caches of the cores of a multicore run.
+ * Every core has the same cache geometry, so a line maps to the same set
+ * index everywhere; a lock per group of set indices orders the accesses
+ * of all cores to those sets, and a bus lock the interconnect counters.
+ */
+#define BUS_SET_LOCKS  64
+
+/* Cycles a transaction holds the bus */
+#define BUS_OCCUPANCY  2
+
+/* Lines counted per set lock for the most contended lines */
+#define HOT_LINES  32
+
+/* Bus transactions */
+enum
+{
+  BUS_READ,           // Load miss, other copies become shared
+  BUS_READ_EXCLUSIVE, // Store miss, other copies are invalidated
+  BUS_UPGRADE,        // Store to a shared line, other copies are invalidated
+  BUS_WRITE,          // Write-through store, other copies are invalidated
+  BUS_WRITEBACK,      // Dirty victim written back
+  BUS_NUM
+};
+
+static const char* const bus_names[BUS_NUM] = {
+  [BUS_READ]           = "read",
+  [BUS_READ_EXCLUSIVE] = "read-exclusive",
+  [BUS_UPGRADE]        = "upgrade",
+  [BUS_WRITE]          = "write",
+  [BUS_WRITEBACK]      = "writeback",
+};
+
+const char* const coherence_names[APEX_COHERENCE_NUM] = {
+  [APEX_COHERENCE_MSI]  = "msi",
+  [APEX_COHERENCE_MESI] = "mesi",
+};
+
+/* A line and how often other cores took it away, see hot_line */
+typedef struct APEX_Hot_Line
+{
+  uint32_t line;
+  uint32_t invalidations;
+} APEX_Hot_Line;
+
+struct APEX_Interconnect
+{
+  APEX_CPU** cores;
+  int num_cores;
+  pthread_mutex_t set_lock[BUS_SET_LOCKS];
+  APEX_Hot_Line hot[BUS_SET_LOCKS][HOT_LINES];  // Under the set lock
+
+  pthread_mutex_t bus_lock;
+  long long busy_until;   // Cycle the bus is free again
+  long long transactions[BUS_NUM];
+  long long invalidations;
+  long long interventions;
+  long long wait_cycles;
+  long long max_wait;
+
+  /* What other cores did to each core's lines, kept apart from its
+   * counters, which only its own thread touches while it runs */
+  long long invalidated[APEX_MAX_CORES];
+  long long interventions_of[APEX_MAX_CORES];
+};
+
+/*
+ * Connects the data caches of the cores, which must all have the same
+ * geometry and coherence protocol. Returns NULL if out of memory.
+ */
+APEX_Interconnect*
+APEX_interconnect_create(APEX_CPU** cores, int num_cores)
+{
+  APEX_Interconnect* interconnect = calloc(1, sizeof(*interconnect));
+  if (!interconnect)
+  {
+    return NULL;
+  }
+  interconnect->cores = cores;
+  interconnect->num_cores = num_cores;
+  for (int i = 0; i < BUS_SET_LOCKS; ++i)
+  {
+    pthread_mutex_init(&interconnect->set_lock[i], NULL);
+  }
+  pthread_mutex_init(&interconnect->bus_lock, NULL);
+  for (int i = 0; i < num_cores; ++i)
+  {
+    cores[i]->interconnect = interconnect;
+    cores[i]->core_id = i;
+  }
+  return interconnect;
+}
+
+/* Adds what the other cores did to each core's lines to its counters,
+ * once every core has stopped */
+void
+APEX_interconnect_collect(APEX_Interconnect* interconnect)
+{
+  for (int i = 0; i < interconnect->num_cores; ++i)
+  {
+    APEX_Stats* stats = &interconnect->cores[i]->stats;
+    stats->dcache_invalidated += interconnect->invalidated[i];
+    stats->dcache_interventions += interconnect->interventions_of[i];
+    interconnect->invalidated[i] = 0;
+    interconnect->interventions_of[i] = 0;
+  }
+}
+
+void
+APEX_interconnect_free(APEX_Interconnect* interconnect)
+{
+  for (int i = 0; i < interconnect->num_cores; ++i)
+  {
+    interconnect->cores[i]->interconnect = NULL;
+  }
+  for (int i = 0; i < BUS_SET_LOCKS; ++i)
+  {
+    pthread_mutex_destroy(&interconnect->set_lock[i]);
+  }
+  pthread_mutex_destroy(&interconnect->bus_lock);
+  free(interconnect);
+}
+
+/* Counts an invalidation of line, in an open addressed table per set
+ * lock that stops counting new lines once full */
+static void
+hot_line(APEX_Hot_Line* hot, uint32_t line)
+{
+  for (int i = 0; i < HOT_LINES; ++i)
+  {
+    APEX_Hot_Line* entry = &hot[(line + i) % HOT_LINES];
+    if (!entry->invalidations || entry->line == line)
+    {
+      entry->line = line;
+      entry->invalidations++;
+      return;
+    }
+  }
+}
+
+/*
+ * Snoops the other cores' copies of a line for a transaction. A read
+ * leaves them shared, the other transactions invalidate them, and a
+ * modified copy is written back to supply the data. Sets *shared when a
+ * copy existed and *invalidations, *interventions to the copies taken
+ * away and supplied.
+ */
+static void
+snoop(APEX_CPU* cpu, size_t set_index, uint32_t tag, int bus, int* shared,
+      int* invalidations, int* interventions)
+{
+  APEX_Interconnect* interconnect = cpu->interconnect;
+  const APEX_Cache_Config* config = &cpu->config.dcache;
+
+  for (int i = 0; i < interconnect->num_cores; ++i)
+  {
+    APEX_CPU* other = interconnect->cores[i];
+    if (other == cpu)
+    {
+      continue;
+    }
+    APEX_Cache_Line* set = &other->dcache.lines[set_index * config->ways];
+    int way = find_way(config, set, tag);
+    if (way < 0)
+    {
+      continue;
+    }
+
+    /* Other cores can snoop the same core under other set locks */
+    *shared = 1;
+    if (set[way].dirty)
+    {
+      ++*interventions;
+      __atomic_fetch_add(&interconnect->interventions_of[i], 1,
+                         __ATOMIC_RELAXED);
+    }
+    set[way].dirty = 0;
+    set[way].exclusive = 0;
+    if (bus != BUS_READ)
+    {
+      set[way].valid = 0;
+      set[way].invalidated = 1;
+      ++*invalidations;
+      __atomic_fetch_add(&interconnect->invalidated[i], 1, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+/*
+ * Puts a transaction on the bus and returns the cycles it queued behind
+ * earlier ones. Cores run up to a quantum apart in simulated time, so a
+ * transaction is queued behind at most one pending transaction of every
+ * other core; a longer queue only means the other cores ran ahead.
+ */
+static int
+bus_transaction(APEX_CPU* cpu, int bus, int invalidations, int interventions)
+{
+  APEX_Interconnect* interconnect = cpu->interconnect;
+  long long now = cpu->clock;
+  long long limit = (long long)BUS_OCCUPANCY * (interconnect->num_cores - 1);
+
+  pthread_mutex_lock(&interconnect->bus_lock);
+  long long wait = interconnect->busy_until - now;
+  if (wait < 0 || wait > limit)
+  {
+    wait = 0;
+  }
+  if (now + wait + BUS_OCCUPANCY > interconnect->busy_until)
+  {
+    interconnect->busy_until = now + wait + BUS_OCCUPANCY;
+  }
+  interconnect->transactions[bus]++;
+  interconnect->invalidations += invalidations;
+  interconnect->interventions += interventions;
+  interconnect->wait_cycles += wait;
+  if (wait > interconnect->max_wait)
+  {
+    interconnect->max_wait = wait;
+  }
+  pthread_mutex_unlock(&interconnect->bus_lock);
+
+  cpu->stats.bus_wait_cycles += wait;
+  return wait;
+}
+
+/*
+ * APEX_dcache_access for a core of a multicore run, following MSI or
+ * MESI. Loads hit in any valid state. A store hits silently on a
+ * modified line, and under MESI on an exclusive one; on a shared line it
+ * upgrades, invalidating the other copies, which costs the miss latency.
+ * A load miss fills the line shared, or exclusive under MESI when no
+ * other core has it; a store miss fills it modified. Write-through
+ * stores invalidate the other copies without waiting.
+ */
+static int
+coherent_access(APEX_CPU* cpu, int addr, int is_store)
+{
+  const APEX_Cache_Config* config = &cpu->config.dcache;
+  APEX_Interconnect* interconnect = cpu->interconnect;
+  APEX_Cache* cache = &cpu->dcache;
+  APEX_Stats* stats = &cpu->stats;
+
+  uint32_t line = (uint32_t)addr / (config->line_bytes / 4);
+  uint32_t tag = line / config->sets;
+  size_t set_index = line % config->sets;
+  APEX_Cache_Line* set = &cache->lines[set_index * config->ways];
+  int write_through = config->write_policy == APEX_WRITE_THROUGH;
+  int lock = set_index % BUS_SET_LOCKS;
+
+  pthread_mutex_lock(&interconnect->set_lock[lock]);
+  cache->clock++;
+  if (is_store && write_through)
+  {
+    stats->dcache_write_throughs++;
+  }
+
+  int bus = -1;
+  int way = find_way(config, set, tag);
+  if (way >= 0)
+  {
+    stats->dcache_hits++;
+    set[way].last_used = cache->clock;
+    if (is_store && write_through)
+    {
+      bus = BUS_WRITE;
+    }
+    else if (is_store && !set[way].dirty)
+    {
+      if (!set[way].exclusive)
+      {
+        bus = BUS_UPGRADE;
+        stats->dcache_upgrades++;
+      }
+      set[way].dirty = 1;
+      set[way].exclusive = 0;
+    }
+  }
+  else
+  {
+    stats->dcache_misses++;
+    for (int i = 0; i < config->ways; ++i)
+    {
+      if (!set[i].valid && set[i].invalidated && set[i].tag == tag)
+      {
+        stats->dcache_coherence_misses++;
+        break;
+      }
+    }
+    bus = !is_store ? BUS_READ : write_through ? BUS_WRITE : BUS_READ_EXCLUSIVE;
+  }
+
+  int latency = 0;
+  if (bus >= 0)
+  {
+    int shared = 0;
+    int invalidations = 0;
+    int interventions = 0;
+    snoop(cpu, set_index, tag, bus, &shared, &invalidations, &interventions);
+    if (invalidations)
+    {
+      hot_line(interconnect->hot[lock], line);
+    }
+    int wait = bus_transaction(cpu, bus, invalidations, interventions);
+
+    if (bus == BUS_UPGRADE)
+    {
+      latency = wait + config->miss_latency;
+    }
+    else if (bus != BUS_WRITE)
+    {
+      int fill_latency;
+      way = fill_line(cpu, set, tag, is_store, &fill_latency);
+      set[way].exclusive = bus == BUS_READ && !shared &&
+                           cpu->config.coherence == APEX_COHERENCE_MESI;
+      if (fill_latency > config->miss_latency)
+      {
+        bus_transaction(cpu, BUS_WRITEBACK, 0, 0);
+      }
+      latency = wait + fill_latency;
+    }
+  }
+  pthread_mutex_unlock(&interconnect->set_lock[lock]);
+  return latency;
+}
+
+static int
+compare_hot_lines(const void* a, const void* b)
+{
+  const APEX_Hot_Line* x = a;
+  const APEX_Hot_Line* y = b;
+  if (x->invalidations != y->invalidations)
+  {
+    return x->invalidations < y->invalidations ? 1 : -1;
+  }
+  return x->line < y->line ? -1 : x->line > y->line;
+}
+
+/* Prints the bus transactions and what they did to the other copies,
+ * the cycles spent queued for the bus and the lines other cores took
+ * away most often */
+void
+APEX_interconnect_print(const APEX_Interconnect* interconnect)
+{
+  const APEX_CPU* first = interconnect->cores[0];
+  const APEX_Cache_Config* config = &first->config.dcache;
+
+  printf("==================INTERCONNECT==============\n");
+  printf(" | cores=%d | coherence=%s |", interconnect->num_cores,
+         config->sets ? coherence_names[first->config.coherence] : "off");
+  for (int bus = 0; bus < BUS_NUM; ++bus)
+  {
+    printf(" %s=%lld |", bus_names[bus], interconnect->transactions[bus]);
+  }
+  printf("\n");
+  printf(" | invalidations=%lld | interventions=%lld | wait cycles=%lld |"
+         " max wait=%lld |\n",
+         interconnect->invalidations, interconnect->interventions,
+         interconnect->wait_cycles, interconnect->max_wait);
+
+  /* Most invalidated lines first */
+  APEX_Hot_Line hot[BUS_SET_LOCKS * HOT_LINES];
+  int count = 0;
+  for (int i = 0; i < BUS_SET_LOCKS; ++i)
+  {
+    for (int j = 0; j < HOT_LINES; ++j)
+    {
+      if (interconnect->hot[i][j].invalidations)
+      {
+        hot[count++] = interconnect->hot[i][j];
+      }
+    }
+  }
+  qsort(hot, count, sizeof(hot[0]), compare_hot_lines);
+  int words = config->sets ? config->line_bytes / 4 : 0;
+  for (int i = 0; i < count && i < 8; ++i)
+  {
+    printf(" | line MEM[%u..%u] | invalidations=%u |\n",
+           hot[i].line * words, hot[i].line * words + words - 1,
+           hot[i].invalidations);
+  }
+}
@@ -0,0 +1,546 @@
+/*
+ *  checkpoint.c
+ *  Contains functions to save the complete state of an APEX cpu to a
+ *  binary checkpoint and to resume from it
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+#define APEX_CHECKPOINT_MAGIC    0x4b435041  // "APCK"
+#define APEX_CHECKPOINT_VERSION  8
+
+/*
+ * All values are stored little endian with a fixed width, so checkpoints
+ * can be shared between hosts
+ */
+static void
+put_u32(FILE* fp, uint32_t value)
+{
+  uint8_t bytes[4];
+  for (int i = 0; i < 4; ++i)
+  {
+    bytes[i] = value >> (8 * i);
+  }
+  fwrite(bytes, 1, sizeof(bytes), fp);
+}
+
+static void
+put_u64(FILE* fp, uint64_t value)
+{
+  put_u32(fp, (uint32_t)value);
+  put_u32(fp, (uint32_t)(value >> 32));
+}
+
+static void
+put_u8(FILE* fp, uint8_t value)
+{
+  fputc(value, fp);
+}
+
+static int
+get_u32(FILE* fp, uint32_t* value)
+{
+  uint8_t bytes[4];
+  if (fread(bytes, 1, sizeof(bytes), fp) != sizeof(bytes))
+  {
+    return -1;
+  }
+  *value = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    *value |= (uint32_t)bytes[i] << (8 * i);
+  }
+  return 0;
+}
+
+static int
+get_i32(FILE* fp, int* value)
+{
+  uint32_t raw;
+  if (get_u32(fp, &raw) != 0)
+  {
+    return -1;
+  }
+  *value = (int32_t)raw;
+  return 0;
+}
+
+static int
+get_i64(FILE* fp, long long* value)
+{
+  uint32_t lo, hi;
+  if (get_u32(fp, &lo) != 0 || get_u32(fp, &hi) != 0)
+  {
+    return -1;
+  }
+  *value = (long long)(((uint64_t)hi << 32) | lo);
+  return 0;
+}
+
+static int
+get_u8(FILE* fp, uint8_t* value)
+{
+  int c = fgetc(fp);
+  if (c == EOF)
+  {
+    return -1;
+  }
+  *value = c;
+  return 0;
+}
+
+/* FNV-1a hash of code memory, ties a checkpoint to its program */
+static uint32_t
+hash_code_memory(const APEX_CPU* cpu)
+{
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < cpu->code_memory_size; ++i)
+  {
+    const APEX_Instruction* ins = &cpu->code_memory[i];
+    uint8_t fields[9] = { ins->opcode, ins->rd, ins->rs1, ins->rs2, ins->rs3,
+                          (uint8_t)ins->imm, (uint8_t)(ins->imm >> 8),
+                          (uint8_t)(ins->imm >> 16), (uint8_t)(ins->imm >> 24) };
+    for (int j = 0; j < 9; ++j)
+    {
+      hash = (hash ^ fields[j]) * 16777619u;
+    }
+  }
+  return hash;
+}
+
+static void
+put_stage(FILE* fp, const CPU_Stage* stage)
+{
+  put_u32(fp, stage->pc);
+  put_u8(fp, stage->opcode);
+  put_u8(fp, stage->rd);
+  put_u8(fp, stage->rs1);
+  put_u8(fp, stage->rs2);
+  put_u8(fp, stage->rs3);
+  put_u8(fp, stage->busy);
+  put_u8(fp, stage->stalled);
+  put_u8(fp, stage->stall_cause);
+  put_u32(fp, stage->src_mask | (uint32_t)stage->dst_mask << 16);
+  put_u32(fp, stage->imm);
+  put_u32(fp, stage->rs1_value);
+  put_u32(fp, stage->rs2_value);
+  put_u32(fp, stage->rs3_value);
+  put_u32(fp, stage->buffer);
+  put_u32(fp, stage->mem_address);
+  put_u32(fp, stage->seq);
+}
+
+static int
+get_stage(FILE* fp, CPU_Stage* stage)
+{
+  uint32_t masks = 0;
+  memset(stage, 0, sizeof(*stage));
+  if (get_i32(fp, &stage->pc) || get_u8(fp, &stage->opcode) ||
+      get_u8(fp, &stage->rd) || get_u8(fp, &stage->rs1) ||
+      get_u8(fp, &stage->rs2) || get_u8(fp, &stage->rs3) ||
+      get_u8(fp, &stage->busy) || get_u8(fp, &stage->stalled) ||
+      get_u8(fp, &stage->stall_cause) || get_u32(fp, &masks) ||
+      get_i32(fp, &stage->imm) || get_i32(fp, &stage->rs1_value) ||
+      get_i32(fp, &stage->rs2_value) || get_i32(fp, &stage->rs3_value) ||
+      get_i32(fp, &stage->buffer) || get_i32(fp, &stage->mem_address) ||
+      get_u32(fp, &stage->seq))
+  {
+    return -1;
+  }
+  stage->src_mask = masks;
+  stage->dst_mask = masks >> 16;
+  if (stage->opcode >= NUM_OPCODES || stage->rd >= 16 || stage->rs1 >= 16 ||
+      stage->rs2 >= 16 || stage->rs3 >= 16 ||
+      stage->stall_cause >= APEX_CPI_NUM)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Writes the architectural and pipeline state of the cpu, along with the
+ * pipeline variant it belongs to. Data memory is stored as runs of
+ * non-zero words, since most of it is usually unused.
+ */
+int
+APEX_cpu_save_checkpoint(const APEX_CPU* cpu, const char* filename)
+{
+  FILE* fp = fopen(filename, "wb");
+  if (!fp)
+  {
+    return -1;
+  }
+
+  put_u32(fp, APEX_CHECKPOINT_MAGIC);
+  put_u32(fp, APEX_CHECKPOINT_VERSION);
+  put_u32(fp, cpu->code_memory_size);
+  put_u32(fp, hash_code_memory(cpu));
+
+  put_u32(fp, cpu->clock);
+  put_u32(fp, cpu->pc);
+  put_u32(fp, cpu->z_flag_set);
+  put_u32(fp, cpu->halt_flag);
+  put_u32(fp, cpu->ins_completed);
+  put_u32(fp, cpu->config.bypass);
+  put_u32(fp, cpu->config.halt);
+  put_u32(fp, cpu->config.predictor);
+  put_u32(fp, cpu->config.btb_entries);
+  put_u32(fp, cpu->config.dcache.sets);
+  put_u32(fp, cpu->config.dcache.ways);
+  put_u32(fp, cpu->config.dcache.line_bytes);
+  put_u32(fp, cpu->config.dcache.replacement);
+  put_u32(fp, cpu->config.dcache.write_policy);
+  put_u32(fp, cpu->config.dcache.miss_latency);
+  put_u32(fp, cpu->config.width);
+  for (int i = 0; i < APEX_UNIT_NUM; ++i)
+  {
+    put_u32(fp, cpu->config.units[i]);
+  }
+  put_u32(fp, cpu->issue_seq);
+
+  /* Checkpoints are taken between cycles, when only forwarded values
+   * are left on the bypass network */
+  for (int i = 0; i < 16; ++i)
+  {
+    put_u32(fp, cpu->regs[i]);
+    put_u8(fp, !(cpu->scoreboard.busy & (1u << i)));
+    put_u32(fp, cpu->scoreboard.producer_pc[i]);
+    put_u32(fp, cpu->scoreboard.ready_cycle[i]);
+    put_u32(fp, cpu->scoreboard.producer_seq[i]);
+    put_u8(fp, !!(cpu->bypass.forwarded & (1u << i)));
+    put_u8(fp, cpu->bypass.path[i]);
+    put_u32(fp, cpu->bypass.value[i]);
+  }
+  for (int i = 0; i < NUM_STAGES; ++i)
+  {
+    for (int j = 0; j < cpu->config.width; ++j)
+    {
+      put_stage(fp, &cpu->stage[i][j]);
+    }
+  }
+
+  put_u32(fp, cpu->predictor.history);
+  fwrite(cpu->predictor.counters, 1, sizeof(cpu->predictor.counters), fp);
+  for (int i = 0; i < cpu->config.btb_entries; ++i)
+  {
+    put_u32(fp, cpu->predictor.btb[i].pc);
+    put_u32(fp, cpu->predictor.btb[i].target);
+  }
+
+  /* Valid data cache lines as a count and (index, tag, dirty, last used)
+   * entries */
+  put_u32(fp, cpu->dcache.clock);
+  put_u32(fp, cpu->dcache.random_state);
+  put_u32(fp, cpu->dcache_wait);
+  uint32_t num_lines = (uint32_t)cpu->config.dcache.sets * cpu->config.dcache.ways;
+  uint32_t valid_lines = 0;
+  for (uint32_t i = 0; i < num_lines; ++i)
+  {
+    valid_lines += cpu->dcache.lines[i].valid;
+  }
+  put_u32(fp, valid_lines);
+  for (uint32_t i = 0; i < num_lines; ++i)
+  {
+    const APEX_Cache_Line* line = &cpu->dcache.lines[i];
+    if (line->valid)
+    {
+      put_u32(fp, i);
+      put_u32(fp, line->tag);
+      put_u8(fp, line->dirty);
+      put_u32(fp, line->last_used);
+    }
+  }
+
+  put_u64(fp, cpu->stats.retired);
+  for (int i = 0; i < APEX_CPI_NUM; ++i)
+  {
+    put_u64(fp, cpu->stats.cycles[i]);
+  }
+  put_u64(fp, cpu->stats.fast_forwarded);
+  for (int i = 0; i < APEX_BYPASS_NUM; ++i)
+  {
+    put_u64(fp, cpu->stats.bypass[i]);
+  }
+  put_u64(fp, cpu->stats.branches);
+  put_u64(fp, cpu->stats.mispredicted);
+  put_u64(fp, cpu->stats.dcache_hits);
+  put_u64(fp, cpu->stats.dcache_misses);
+  put_u64(fp, cpu->stats.dcache_evictions);
+  put_u64(fp, cpu->stats.dcache_writebacks);
+  put_u64(fp, cpu->stats.dcache_write_throughs);
+  for (int i = 0; i <= cpu->config.width; ++i)
+  {
+    put_u64(fp, cpu->stats.issued[i]);
+  }
+
+  /* Outcomes of the branches that ran, as a count and (index, executed,
+   * taken, mispredicted) entries */
+  uint32_t branches = 0;
+  for (int i = 0; i < cpu->code_memory_size; ++i)
+  {
+    branches += cpu->branch_stats[i].executed != 0;
+  }
+  put_u32(fp, branches);
+  for (int i = 0; i < cpu->code_memory_size; ++i)
+  {
+    const APEX_Branch_Stats* branch = &cpu->branch_stats[i];
+    if (branch->executed)
+    {
+      put_u32(fp, i);
+      put_u32(fp, branch->executed);
+      put_u32(fp, branch->taken);
+      put_u32(fp, branch->mispredicted);
+    }
+  }
+
+  put_u32(fp, cpu->data_fault);
+  put_u32(fp, cpu->fault_pc);
+  put_u32(fp, cpu->fault_address);
+
+  /* (start, length, words...) runs of the allocated pages, terminated by
+   * a zero length run */
+  for (uint32_t number = 0;
+       number < (uint32_t)APEX_PAGE_TABLES * APEX_TABLE_PAGES; ++number)
+  {
+    const int* page = APEX_data_page(&cpu->data_memory, number);
+    if (!page)
+    {
+      continue;
+    }
+    int offset = 0;
+    while (offset < APEX_PAGE_WORDS)
+    {
+      if (!page[offset])
+      {
+        offset++;
+        continue;
+      }
+      int end = offset;
+      while (end < APEX_PAGE_WORDS && page[end])
+      {
+        end++;
+      }
+      put_u32(fp, number * APEX_PAGE_WORDS + offset);
+      put_u32(fp, end - offset);
+      for (; offset < end; ++offset)
+      {
+        put_u32(fp, page[offset]);
+      }
+    }
+  }
+  put_u32(fp, 0);
+  put_u32(fp, 0);
+
+  int failed = ferror(fp);
+  if (fclose(fp) != 0 || failed)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Restores a checkpoint into a cpu that has loaded the same program,
+ * including the pipeline variant and data cache contents it was taken
+ * with.
+ * Returns -1 without a usable state if the file is invalid or belongs to
+ * another program.
+ */
+int
+APEX_cpu_load_checkpoint(APEX_CPU* cpu, const char* filename)
+{
+  FILE* fp = fopen(filename, "rb");
+  if (!fp)
+  {
+    return -1;
+  }
+
+  uint32_t magic, version, size, hash;
+  if (get_u32(fp, &magic) || get_u32(fp, &version) || get_u32(fp, &size) ||
+      get_u32(fp, &hash) || magic != APEX_CHECKPOINT_MAGIC ||
+      version != APEX_CHECKPOINT_VERSION ||
+      size != (uint32_t)cpu->code_memory_size ||
+      hash != hash_code_memory(cpu))
+  {
+    fclose(fp);
+    return -1;
+  }
+
+  int failed = get_i32(fp, &cpu->clock) || get_i32(fp, &cpu->pc) ||
+               get_i32(fp, &cpu->z_flag_set) || get_i32(fp, &cpu->halt_flag) ||
+               get_i32(fp, &cpu->ins_completed);
+  uint32_t bypass = 0, halt = 0, predictor = 0, btb_entries = 0;
+  failed = failed || get_u32(fp, &bypass) || get_u32(fp, &halt) ||
+           get_u32(fp, &predictor) || get_u32(fp, &btb_entries) ||
+           bypass >= (1u << APEX_BYPASS_NUM) || halt > APEX_HALT_SQUASH ||
+           predictor >= APEX_PREDICT_NUM || btb_entries > APEX_BTB_MAX_ENTRIES ||
+           (btb_entries & (btb_entries - 1));
+  cpu->config.bypass = bypass;
+  cpu->config.halt = halt;
+  cpu->config.predictor = predictor;
+  cpu->config.btb_entries = btb_entries;
+
+  APEX_Config config = cpu->config;
+  uint32_t dcache[6] = { 0 };
+  for (int i = 0; !failed && i < 6; ++i)
+  {
+    failed = get_u32(fp, &dcache[i]);
+  }
+  config.dcache.sets = dcache[0];
+  config.dcache.ways = dcache[1];
+  config.dcache.line_bytes = dcache[2];
+  config.dcache.replacement = dcache[3];
+  config.dcache.write_policy = dcache[4];
+  config.dcache.miss_latency = dcache[5];
+  uint32_t width = 0;
+  failed = failed || get_u32(fp, &width) || width < 1 ||
+           width > APEX_MAX_WIDTH;
+  config.width = width;
+  for (int i = 0; !failed && i < APEX_UNIT_NUM; ++i)
+  {
+    uint32_t limit = 0;
+    failed = get_u32(fp, &limit) || limit > APEX_MAX_WIDTH;
+    config.units[i] = limit;
+  }
+  failed = failed || dcache[0] > APEX_DCACHE_MAX_LINES ||
+           dcache[1] > APEX_DCACHE_MAX_LINES || dcache[2] > (1u << 30) ||
+           dcache[5] > (1u << 30) || !APEX_dcache_valid(&config.dcache) ||
+           APEX_cpu_configure(cpu, &config) != 0;
+  failed = failed || get_u32(fp, &cpu->issue_seq);
+
+  cpu->scoreboard.busy = 0;
+  memset(&cpu->bypass, 0, sizeof(cpu->bypass));
+  for (int i = 0; !failed && i < 16; ++i)
+  {
+    uint8_t valid = 0, forwarded = 0;
+    failed = get_i32(fp, &cpu->regs[i]) || get_u8(fp, &valid) ||
+             get_i32(fp, &cpu->scoreboard.producer_pc[i]) ||
+             get_i32(fp, &cpu->scoreboard.ready_cycle[i]) ||
+             get_u32(fp, &cpu->scoreboard.producer_seq[i]) ||
+             get_u8(fp, &forwarded) || get_u8(fp, &cpu->bypass.path[i]) ||
+             get_i32(fp, &cpu->bypass.value[i]) ||
+             cpu->bypass.path[i] >= APEX_BYPASS_NUM;
+    if (!valid)
+    {
+      cpu->scoreboard.busy |= 1u << i;
+    }
+    if (forwarded)
+    {
+      cpu->bypass.forwarded |= 1u << i;
+    }
+  }
+  for (int i = 0; !failed && i < NUM_STAGES; ++i)
+  {
+    for (int j = 0; !failed && j < cpu->config.width; ++j)
+    {
+      failed = get_stage(fp, &cpu->stage[i][j]);
+    }
+  }
+
+  APEX_predictor_reset(&cpu->predictor);
+  failed = failed || get_u32(fp, &cpu->predictor.history) ||
+           fread(cpu->predictor.counters, 1, sizeof(cpu->predictor.counters),
+                 fp) != sizeof(cpu->predictor.counters);
+  for (int i = 0; !failed && i < cpu->config.btb_entries; ++i)
+  {
+    failed = get_i32(fp, &cpu->predictor.btb[i].pc) ||
+             get_i32(fp, &cpu->predictor.btb[i].target);
+  }
+  uint32_t wait = 0, valid_lines = 0;
+  uint32_t num_lines = (uint32_t)cpu->config.dcache.sets * cpu->config.dcache.ways;
+  failed = failed || get_u32(fp, &cpu->dcache.clock) ||
+           get_u32(fp, &cpu->dcache.random_state) || get_u32(fp, &wait) ||
+           get_u32(fp, &valid_lines) ||
+           wait > 2u * cpu->config.dcache.miss_latency ||
+           valid_lines > num_lines;
+  cpu->dcache_wait = wait;
+  for (uint32_t i = 0; !failed && i < valid_lines; ++i)
+  {
+    uint32_t index;
+    APEX_Cache_Line line = { .valid = 1 };
+    failed = get_u32(fp, &index) || get_u32(fp, &line.tag) ||
+             get_u8(fp, &line.dirty) || get_u32(fp, &line.last_used) ||
+             index >= num_lines;
+    if (!failed)
+    {
+      cpu->dcache.lines[index] = line;
+    }
+  }
+
+  failed = failed || get_i64(fp, &cpu->stats.retired);
+  for (int i = 0; !failed && i < APEX_CPI_NUM; ++i)
+  {
+    failed = get_i64(fp, &cpu->stats.cycles[i]);
+  }
+  failed = failed || get_i64(fp, &cpu->stats.fast_forwarded);
+  for (int i = 0; !failed && i < APEX_BYPASS_NUM; ++i)
+  {
+    failed = get_i64(fp, &cpu->stats.bypass[i]);
+  }
+  failed = failed || get_i64(fp, &cpu->stats.branches) ||
+           get_i64(fp, &cpu->stats.mispredicted) ||
+           get_i64(fp, &cpu->stats.dcache_hits) ||
+           get_i64(fp, &cpu->stats.dcache_misses) ||
+           get_i64(fp, &cpu->stats.dcache_evictions) ||
+           get_i64(fp, &cpu->stats.dcache_writebacks) ||
+           get_i64(fp, &cpu->stats.dcache_write_throughs);
+  memset(cpu->stats.issued, 0, sizeof(cpu->stats.issued));
+  for (int i = 0; !failed && i <= cpu->config.width; ++i)
+  {
+    failed = get_i64(fp, &cpu->stats.issued[i]);
+  }
+
+  uint32_t branches = 0;
+  failed = failed || get_u32(fp, &branches);
+  memset(cpu->branch_stats, 0,
+         sizeof(APEX_Branch_Stats) * cpu->code_memory_size);
+  for (uint32_t i = 0; !failed && i < branches; ++i)
+  {
+    uint32_t index;
+    APEX_Branch_Stats branch;
+    failed = get_u32(fp, &index) || get_u32(fp, &branch.executed) ||
+             get_u32(fp, &branch.taken) || get_u32(fp, &branch.mispredicted) ||
+             index >= (uint32_t)cpu->code_memory_size;
+    if (!failed)
+    {
+      cpu->branch_stats[index] = branch;
+    }
+  }
+
+  failed = failed || get_i32(fp, &cpu->data_fault) ||
+           get_i32(fp, &cpu->fault_pc) || get_i32(fp, &cpu->fault_address);
+
+  APEX_data_free(&cpu->data_memory);
+  while (!failed)
+  {
+    uint32_t start, length;
+    if (get_u32(fp, &start) || get_u32(fp, &length) ||
+        start > INT_MAX || length > INT_MAX - start + 1u)
+    {
+      failed = 1;
+      break;
+    }
+    if (!length)
+    {
+      break;
+    }
+    for (uint32_t i = 0; !failed && i < length; ++i)
+    {
+      int value;
+      failed = get_i32(fp, &value) ||
+               APEX_data_store(&cpu->data_memory, start + i, value);
+    }
+  }
+
+  fclose(fp);
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,2468 @@
+/*
+ *  cpu.c
+ *  Contains APEX cpu pipeline implementation
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+const char* const bypass_names[APEX_BYPASS_NUM] = {
+  [APEX_BYPASS_EX1]  = "ex1",
+  [APEX_BYPASS_EX2]  = "ex2",
+  [APEX_BYPASS_MEM1] = "mem1",
+  [APEX_BYPASS_MEM2] = "mem2",
+  [APEX_BYPASS_WB]   = "wb",
+};
+
+const char* const unit_names[APEX_UNIT_NUM] = {
+  [APEX_UNIT_NONE]   = "none",
+  [APEX_UNIT_ALU]    = "alu",
+  [APEX_UNIT_MUL]    = "mul",
+  [APEX_UNIT_MEM]    = "mem",
+  [APEX_UNIT_BRANCH] = "branch",
+};
+
+/*
+ * What a variant of the in-order pipeline fixes at compile time: the
+ * stages take it by value instead of looking these up in the cpu on
+ * every cycle, and as they are inlined into each copy of the cycle loop
+ * a constant policy removes the paths it disables, see run_pipeline.
+ * The per-opcode handlers, reached through their tables, and HALT
+ * itself still read cpu->config, which always matches the policy.
+ */
+typedef struct APEX_Policy
+{
+  unsigned bypass;    // APEX_Config.bypass
+  int halt;           // APEX_Config.halt
+  int width;          // APEX_Config.width
+  int debug;          // Print every stage, in "simulate" mode
+  int trace;          // Record a binary trace
+  int profile;        // Count what each instruction did, see profile.c
+} APEX_Policy;
+
+#define APEX_SPECIALIZE static inline __attribute__((always_inline))
+
+/* Bypass paths of the Part A and Part B defaults */
+#define APEX_BYPASS_PART_A  (1u << APEX_BYPASS_WB)
+#define APEX_BYPASS_PART_B  ((1u << APEX_BYPASS_EX2) | \
+                             (1u << APEX_BYPASS_MEM2) | \
+                             (1u << APEX_BYPASS_WB))
+
+/* The policy a cpu runs with */
+static inline APEX_Policy
+policy_of(const APEX_CPU* cpu)
+{
+  APEX_Policy policy = {
+    cpu->config.bypass, cpu->config.halt, cpu->config.width,
+    cpu->enable_debug_messages, cpu->trace != NULL, cpu->profile != NULL
+  };
+  return policy;
+}
+
+/*
+ * Part A reads results only once writeback has updated the register
+ * file and holds the earlier stages behind HALT. Part B also forwards
+ * ALU results from Execute 2 and loads from Memory 2, and squashes the
+ * stages behind HALT. Both predict branches not taken and JUMPs with a
+ * 64 entry BTB, reach data memory in one cycle without a cache and
+ * handle one instruction per cycle. The out-of-order core, when chosen,
+ * has a 32 entry ROB, a 16 entry issue queue and LSQ and 64 physical
+ * registers. The data caches of a multicore run follow MESI.
+ */
+void
+APEX_config_default(APEX_Config* config)
+{
+#ifdef APEX_PART_B
+  config->bypass = APEX_BYPASS_PART_B;
+  config->halt = APEX_HALT_SQUASH;
+#else
+  config->bypass = APEX_BYPASS_PART_A;
+  config->halt = APEX_HALT_BLOCK;
+#endif
+  config->predictor = APEX_PREDICT_STATIC;
+  config->btb_entries = 64;
+  memset(&config->dcache, 0, sizeof(config->dcache));
+  config->width = 1;
+  memset(config->units, 0, sizeof(config->units));
+  config->core = APEX_CORE_INORDER;
+  config->ooo.size[APEX_OOO_ROB] = 32;
+  config->ooo.size[APEX_OOO_IQ] = 16;
+  config->ooo.size[APEX_OOO_LSQ] = 16;
+  config->ooo.size[APEX_OOO_REGS] = 64;
+  config->coherence = APEX_COHERENCE_MESI;
+}
+
+/*
+ * Sets the enabled bypass paths from a comma separated list of path
+ * names, or "none". Returns 0 on success, -1 on an unknown name.
+ */
+int
+APEX_config_parse_bypass(APEX_Config* config, const char* list)
+{
+  unsigned bypass = 0;
+  if (strcmp(list, "none") != 0)
+  {
+    const char* name = list;
+    while (1)
+    {
+      size_t length = strcspn(name, ",");
+      int path = 0;
+      while (path < APEX_BYPASS_NUM &&
+             (strlen(bypass_names[path]) != length ||
+              strncmp(name, bypass_names[path], length) != 0))
+      {
+        ++path;
+      }
+      if (path == APEX_BYPASS_NUM)
+      {
+        return -1;
+      }
+      bypass |= 1u << path;
+      if (name[length] == '\0')
+      {
+        break;
+      }
+      name += length + 1;
+    }
+  }
+  config->bypass = bypass;
+  return 0;
+}
+
+/*
+ * Sets the issue limits from a comma separated list of unit=N, for the
+ * units alu, mul, mem and branch. Returns 0 on success, -1 on an unknown
+ * unit or a limit outside 1 to APEX_MAX_WIDTH.
+ */
+int
+APEX_config_parse_units(APEX_Config* config, const char* list)
+{
+  int units[APEX_UNIT_NUM];
+  memcpy(units, config->units, sizeof(units));
+  const char* field = list;
+  while (1)
+  {
+    size_t length = strcspn(field, ",");
+    const char* value = memchr(field, '=', length);
+    int unit = APEX_UNIT_ALU;
+    while (value && unit < APEX_UNIT_NUM &&
+           (strlen(unit_names[unit]) != (size_t)(value - field) ||
+            strncmp(field, unit_names[unit], value - field) != 0))
+    {
+      ++unit;
+    }
+    if (!value || unit == APEX_UNIT_NUM)
+    {
+      return -1;
+    }
+    units[unit] = atoi(value + 1);
+    if (units[unit] < 1 || units[unit] > APEX_MAX_WIDTH)
+    {
+      return -1;
+    }
+    if (field[length] == '\0')
+    {
+      break;
+    }
+    field += length + 1;
+  }
+  memcpy(config->units, units, sizeof(units));
+  return 0;
+}
+
+/* Index of value among count names, or -1 */
+int
+APEX_find_name(const char* const* names, int count, const char* value)
+{
+  for (int i = 0; i < count; ++i)
+  {
+    if (strcmp(names[i], value) == 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* Reads a decimal int taking up all of value. Returns 0, or -1 */
+static int
+parse_int(const char* value, int* number)
+{
+  char* end;
+  errno = 0;
+  long parsed = strtol(value, &end, 10);
+  if (end == value || *end != '\0' || errno == ERANGE ||
+      parsed < INT_MIN || parsed > INT_MAX)
+  {
+    return -1;
+  }
+  *number = (int)parsed;
+  return 0;
+}
+
+/*
+ * Sets one pipeline option, named as apex_sim takes it without the
+ * dashes: bypass, halt, predictor, btb, dcache, width, units, core, ooo
+ * or coherence. apex_sim, apex_bench, batch manifests and libapex all set
+ * their options here. Returns 0, -1 for an invalid value, leaving config
+ * as it was, or -2 for a name that is not a pipeline option.
+ */
+int
+APEX_config_set(APEX_Config* config, const char* name, const char* value)
+{
+  static const char* const halt_names[] = {
+    [APEX_HALT_BLOCK] = "block",
+    [APEX_HALT_SQUASH] = "squash",
+  };
+  int index;
+
+  if (strcmp(name, "bypass") == 0)
+  {
+    return APEX_config_parse_bypass(config, value);
+  }
+  if (strcmp(name, "halt") == 0)
+  {
+    index = APEX_find_name(halt_names, 2, value);
+    config->halt = index >= 0 ? index : config->halt;
+    return index >= 0 ? 0 : -1;
+  }
+  if (strcmp(name, "predictor") == 0)
+  {
+    index = APEX_find_name(predictor_names, APEX_PREDICT_NUM, value);
+    config->predictor = index >= 0 ? index : config->predictor;
+    return index >= 0 ? 0 : -1;
+  }
+  if (strcmp(name, "btb") == 0)
+  {
+    if (parse_int(value, &index) != 0 || index < 0 ||
+        index > APEX_BTB_MAX_ENTRIES || (index & (index - 1)))
+    {
+      return -1;
+    }
+    config->btb_entries = index;
+    return 0;
+  }
+  if (strcmp(name, "dcache") == 0)
+  {
+    return APEX_dcache_parse(&config->dcache, value);
+  }
+  if (strcmp(name, "width") == 0)
+  {
+    if (parse_int(value, &index) != 0 || index < 1 || index > APEX_MAX_WIDTH)
+    {
+      return -1;
+    }
+    config->width = index;
+    return 0;
+  }
+  if (strcmp(name, "units") == 0)
+  {
+    return APEX_config_parse_units(config, value);
+  }
+  if (strcmp(name, "core") == 0)
+  {
+    index = APEX_find_name(core_names, APEX_CORE_NUM, value);
+    config->core = index >= 0 ? index : config->core;
+    return index >= 0 ? 0 : -1;
+  }
+  if (strcmp(name, "ooo") == 0)
+  {
+    return APEX_ooo_parse(&config->ooo, value);
+  }
+  if (strcmp(name, "coherence") == 0)
+  {
+    index = APEX_find_name(coherence_names, APEX_COHERENCE_NUM, value);
+    config->coherence = index >= 0 ? index : config->coherence;
+    return index >= 0 ? 0 : -1;
+  }
+  return -2;
+}
+
+/*
+ * Checks that the features of a run, APEX_RUN_* bits, can be combined
+ * with each other and with the core of config. Returns NULL, or the
+ * reason they cannot.
+ */
+const char*
+APEX_config_check(const APEX_Config* config, unsigned features)
+{
+  /* Several cores run a quantum at a time with nothing stepped cycle by
+   * cycle, so there is no single pipeline to show, trace or save */
+  if ((features & APEX_RUN_MULTICORE) &&
+      (features & (APEX_RUN_SIMULATE | APEX_RUN_TRACE | APEX_RUN_CHECKPOINT |
+                   APEX_RUN_RESTORE | APEX_RUN_FAST_FORWARD | APEX_RUN_CHECK |
+                   APEX_RUN_PROFILE)))
+  {
+    return "--cores cannot be combined with simulate, --trace, --checkpoint-at, --restore, fast-forward, --check or --profile";
+  }
+
+  /* The out-of-order core keeps its state to itself while it runs, so
+   * there are no latches to trace, checkpoint or profile */
+  if (config->core == APEX_CORE_OOO &&
+      (features & (APEX_RUN_TRACE | APEX_RUN_CHECKPOINT | APEX_RUN_RESTORE |
+                   APEX_RUN_PROFILE)))
+  {
+    return "--core ooo cannot be combined with --trace, --checkpoint-at, --restore or --profile";
+  }
+
+  /* A checkpoint can hold instructions in flight, which fast-forward would
+   * execute a second time, and it resumes the pipeline variant it was
+   * taken with */
+  if ((features & APEX_RUN_RESTORE) && (features & APEX_RUN_FAST_FORWARD))
+  {
+    return "--restore cannot be combined with fast-forward";
+  }
+  if ((features & APEX_RUN_RESTORE) && (features & APEX_RUN_CONFIGURED))
+  {
+    return "--restore cannot be combined with pipeline options";
+  }
+  return NULL;
+}
+
+/* Instructions of a unit class that can issue in one cycle. ALU work
+ * issues across the whole width unless limited, MUL, memory and control
+ * instructions one at a time */
+int
+APEX_unit_limit(const APEX_Config* config, int unit)
+{
+  if (config->units[unit])
+  {
+    return config->units[unit] < config->width ? config->units[unit]
+                                               : config->width;
+  }
+  return unit == APEX_UNIT_ALU ? config->width : 1;
+}
+
+/*
+ * Switches the cpu to another pipeline variant, before it runs or when
+ * restoring a checkpoint. The data cache starts empty.
+ * Returns 0 on success, -1 if the cache cannot be allocated.
+ */
+int
+APEX_cpu_configure(APEX_CPU* cpu, const APEX_Config* config)
+{
+  cpu->config = *config;
+  cpu->dcache_wait = 0;
+  return APEX_dcache_init(&cpu->dcache, &config->dcache);
+}
+
+/* Passes text a CPU prints to its output callback, or else to stdout or
+ * stderr */
+static void
+cpu_vprint(const APEX_CPU* cpu, int stream, const char* format, va_list args)
+{
+  if (!cpu->output)
+  {
+    vfprintf(stream == APEX_OUTPUT_ERROR ? stderr : stdout, format, args);
+    return;
+  }
+
+  char buffer[512];
+  va_list again;
+  va_copy(again, args);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  if (length < (int)sizeof(buffer))
+  {
+    cpu->output(cpu->output_context, stream, buffer);
+  }
+  else
+  {
+    char* text = malloc(length + 1);
+    if (text)
+    {
+      vsnprintf(text, length + 1, format, again);
+      cpu->output(cpu->output_context, stream, text);
+      free(text);
+    }
+  }
+  va_end(again);
+}
+
+/* Prints a report: stage contents, the final state and counters */
+void
+APEX_cpu_printf(const APEX_CPU* cpu, const char* format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  cpu_vprint(cpu, APEX_OUTPUT_REPORT, format, args);
+  va_end(args);
+}
+
+/* Prints a diagnostic */
+void
+APEX_cpu_error(const APEX_CPU* cpu, const char* format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  cpu_vprint(cpu, APEX_OUTPUT_ERROR, format, args);
+  va_end(args);
+}
+
+/* Lists code memory as loaded */
+void
+APEX_cpu_print_code(const APEX_CPU* cpu)
+{
+  APEX_cpu_error(cpu,
+                 "APEX_CPU : Initialized APEX CPU, loaded %d instructions\n",
+                 cpu->code_memory_size);
+  APEX_cpu_error(cpu, "APEX_CPU : Printing Code Memory\n");
+  APEX_cpu_printf(cpu, "%-9s %-9s %-9s %-9s %-9s %-9s\n", "opcode", "rd", "rs1", "rs2","rs3","imm");
+
+  for (int i = 0; i < cpu->code_memory_size; ++i)
+  {
+    APEX_cpu_printf(cpu, "%-9s %-9d %-9d %-9d %-9d %-9d \n",
+                    opcode_info[cpu->code_memory[i].opcode].name,
+                    cpu->code_memory[i].rd,
+                    cpu->code_memory[i].rs1,
+                    cpu->code_memory[i].rs2,
+                    cpu->code_memory[i].rs3,
+                    cpu->code_memory[i].imm);
+  }
+}
+
+/*
+ * This function creates and initializes APEX cpu.
+ *
+ * Note : You are free to edit this function according to your
+ * 				implementation
+ */
+APEX_CPU*
+APEX_cpu_init(const char *filename, const char *simulate, const int clockcycles)
+{
+  if (!filename)
+  {
+    return NULL;
+  }
+
+  APEX_CPU* cpu = malloc(sizeof(*cpu));
+  if (!cpu)
+  {
+    return NULL;
+  }
+
+  /* "display" only dumps the final state, "quiet" prints nothing at all */
+  cpu->simulate = simulate;
+  if (strcmp(simulate, "display") == 0)
+  {
+    cpu->enable_debug_messages = 0;
+    cpu->enable_display = 1;
+  }
+  else if (strcmp(simulate, "quiet") == 0)
+  {
+    cpu->enable_debug_messages = 0;
+    cpu->enable_display = 0;
+  }
+  else
+  {
+    cpu->enable_debug_messages = 1;
+    cpu->enable_display = 1;
+  }
+  cpu->halt_flag = 0;
+  cpu->reached_end = 0;
+  cpu->output = NULL;
+  cpu->output_context = NULL;
+  cpu->checkpoint_file = NULL;
+  cpu->checkpoint_cycle = 0;
+  cpu->trace = NULL;
+  cpu->profile = NULL;
+  cpu->ooo = NULL;
+  cpu->interconnect = NULL;
+  cpu->core_id = 0;
+  cpu->fast_forward_engine = APEX_ENGINE_TRANSLATE;
+  cpu->translation = NULL;
+  cpu->threaded = NULL;
+  APEX_config_default(&cpu->config);
+  cpu->ins_completed = 0;
+  cpu->issue_seq = 0;
+  memset(&cpu->stats, 0, sizeof(cpu->stats));
+
+  /* Initialize PC, Registers and all pipeline stages */
+  cpu->pc = 4000;
+  memset(cpu->regs, 0, sizeof(int) * 16);
+  memset(&cpu->scoreboard, 0, sizeof(cpu->scoreboard));
+  memset(&cpu->bypass, 0, sizeof(cpu->bypass));
+  APEX_predictor_reset(&cpu->predictor);
+  memset(&cpu->dcache, 0, sizeof(cpu->dcache));
+  cpu->dcache_wait = 0;
+  memset(cpu->stage, 0, sizeof(cpu->stage));
+  APEX_data_init(&cpu->data_memory);
+  cpu->data_fault = 0;
+
+  /* Map a pre-assembled image, or parse input file and create code memory */
+  cpu->code_image_length = 0;
+  if (is_code_image(filename))
+  {
+    cpu->code_memory = map_code_image(filename, &cpu->code_memory_size,
+                                      &cpu->code_image_length);
+  }
+  else
+  {
+    cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
+  }
+
+  /*Initializing clock cycle to 1*/
+  cpu->clock = 0;
+
+   /* Setting the z flag to 0 */
+  cpu->z_flag_set = 0;
+  cpu->clockcycles = clockcycles;
+  if (!cpu->code_memory)
+  {
+    free(cpu);
+    return NULL;
+  }
+
+  /* Register masks are computed once per instruction, fetch copies them
+   * into the latch for decode
+   */
+  cpu->dependencies = malloc(sizeof(APEX_Dependency) *
+                             (cpu->code_memory_size ? cpu->code_memory_size : 1));
+  cpu->branch_stats = calloc(cpu->code_memory_size ? cpu->code_memory_size : 1,
+                             sizeof(APEX_Branch_Stats));
+  if (!cpu->dependencies || !cpu->branch_stats)
+  {
+    APEX_cpu_stop(cpu);
+    return NULL;
+  }
+  for (int i = 0; i < cpu->code_memory_size; ++i)
+  {
+    const APEX_Instruction* ins = &cpu->code_memory[i];
+    int flags = opcode_info[ins->opcode].flags;
+    APEX_Dependency* dep = &cpu->dependencies[i];
+    dep->src_mask = ((flags & OPF_READS_RS1) ? 1u << ins->rs1 : 0) |
+                    ((flags & OPF_READS_RS2) ? 1u << ins->rs2 : 0) |
+                    ((flags & OPF_READS_RS3) ? 1u << ins->rs3 : 0);
+    dep->dst_mask = (flags & OPF_WRITES_RD) ? 1u << ins->rd : 0;
+  }
+
+  if (cpu->enable_debug_messages)
+  {
+    APEX_cpu_print_code(cpu);
+  }
+
+  /* Make all stages busy except Fetch stage, initally to start the pipeline */
+  for (int i = 1; i < NUM_STAGES; ++i)
+  {
+    cpu->stage[i][0].busy = 1;
+  }
+
+  return cpu;
+}
+
+/*
+ * This function de-allocates APEX cpu.
+ *
+ * Note : You are free to edit this function according to your
+ * 				implementation
+ */
+void APEX_cpu_stop(APEX_CPU* cpu)
+{
+  if (cpu->code_image_length)
+  {
+    unmap_code_image(cpu->code_memory, cpu->code_image_length);
+  }
+  else
+  {
+    free(cpu->code_memory);
+  }
+  free(cpu->dependencies);
+  free(cpu->branch_stats);
+  free(cpu->profile);
+  APEX_dcache_free(&cpu->dcache);
+  APEX_data_free(&cpu->data_memory);
+  free(cpu->ooo);
+  APEX_translation_free(cpu->translation);
+  APEX_threaded_free(cpu->threaded, cpu->code_memory_size);
+  free(cpu);
+}
+
+/* Converts the PC(4000 series) into
+ * array index for code memory
+ *
+ * Note : You are not supposed to edit this function
+ *
+ */
+int get_code_index(int pc)
+{
+  return (pc - 4000) / 4;
+}
+
+static void
+print_instruction(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  APEX_Instruction ins = {
+    .opcode = stage->opcode, .rd = stage->rd, .rs1 = stage->rs1,
+    .rs2 = stage->rs2, .rs3 = stage->rs3, .imm = stage->imm,
+  };
+  char text[APEX_INSTRUCTION_TEXT];
+  APEX_format_instruction(text, sizeof(text), &ins);
+
+  /* Instructions with operands are followed by a space */
+  APEX_cpu_printf(cpu, "%s%s", text,
+                  opcode_info[stage->opcode].format == FMT_NONE ? "" : " ");
+}
+
+/* Debug function which dumps the cpu stage
+ * content
+ *
+ * Note : You are not supposed to edit this function
+ *
+ */
+void
+print_stage_content(APEX_CPU* cpu, char* name, CPU_Stage* stage)
+{
+  APEX_cpu_printf(cpu, "%-15s: pc(%d) ", name, stage->pc);
+  print_instruction(cpu, stage);
+  APEX_cpu_printf(cpu, "\n");
+}
+const char* const cpi_names[APEX_CPI_NUM] = {
+  [APEX_CPI_FETCH] = "fetch",
+  [APEX_CPI_BASE]  = "base",
+  [APEX_CPI_RAW]   = "raw",
+  [APEX_CPI_WAW]   = "waw",
+  [APEX_CPI_BRANCH] = "branch",
+  [APEX_CPI_DCACHE] = "dcache",
+  [APEX_CPI_HALT]  = "halt",
+};
+
+/* Prints cycles per retired instruction, split by where the cycles went */
+static void
+print_cpi_stack(APEX_CPU* cpu)
+{
+  long long total = 0;
+  double retired = cpu->stats.retired ? cpu->stats.retired : 1;
+
+  APEX_cpu_printf(cpu, "==================CPI STACK==============\n");
+  for (int i = 0; i < APEX_CPI_NUM; ++i)
+  {
+    APEX_cpu_printf(cpu, " | %-6s | Cycles=%lld | CPI=%.3f |\n", cpi_names[i],
+                    cpu->stats.cycles[i], cpu->stats.cycles[i] / retired);
+    total += cpu->stats.cycles[i];
+  }
+  APEX_cpu_printf(cpu, " | %-6s | Cycles=%lld | CPI=%.3f |\n", "total", total,
+                  total / retired);
+}
+
+/* Prints how many source operands were read over each bypass path */
+static void
+print_bypass_usage(APEX_CPU* cpu)
+{
+  APEX_cpu_printf(cpu, "==================BYPASS USAGE==============\n");
+  for (int i = 0; i < APEX_BYPASS_NUM; ++i)
+  {
+    APEX_cpu_printf(cpu, " | %-6s | %-3s | Reads=%lld |\n", bypass_names[i],
+                    (cpu->config.bypass & (1u << i)) ? "on" : "off",
+                    cpu->stats.bypass[i]);
+  }
+}
+
+/* Prints the sizes of the out-of-order structures, how full they were
+ * on average and how often a full one stopped rename */
+static void
+print_ooo_stats(APEX_CPU* cpu)
+{
+  long long cycles = 0;
+  for (int i = 0; i < APEX_CPI_NUM; ++i)
+  {
+    cycles += cpu->stats.cycles[i];
+  }
+
+  APEX_cpu_printf(cpu, "==================OUT-OF-ORDER==============\n");
+  for (int i = 0; i < APEX_OOO_NUM; ++i)
+  {
+    APEX_cpu_printf(cpu, " | %-4s | size=%d | average use=%.1f | full=%lld |\n",
+                    ooo_names[i], cpu->config.ooo.size[i],
+                    cycles ? (double)cpu->stats.ooo_occupancy[i] / cycles : 0.0,
+                    cpu->stats.ooo_full[i]);
+  }
+  APEX_cpu_printf(cpu, " | squashed=%lld | loads forwarded=%lld |\n",
+                  cpu->stats.ooo_squashed, cpu->stats.ooo_forwarded);
+}
+
+/* Prints the prediction accuracy, overall and for every branch that ran */
+static void
+print_branch_stats(APEX_CPU* cpu)
+{
+  long long branches = cpu->stats.branches;
+  long long correct = branches - cpu->stats.mispredicted;
+
+  APEX_cpu_printf(cpu, "==================BRANCH PREDICTION==============\n");
+  APEX_cpu_printf(cpu, " | predictor=%s | btb=%d | branches=%lld | mispredicted=%lld |"
+                  " accuracy=%.1f%% |\n",
+                  predictor_names[cpu->config.predictor], cpu->config.btb_entries,
+                  branches, cpu->stats.mispredicted,
+                  branches ? 100.0 * correct / branches : 100.0);
+  for (int i = 0; i < cpu->code_memory_size; ++i)
+  {
+    const APEX_Branch_Stats* branch = &cpu->branch_stats[i];
+    if (!branch->executed)
+    {
+      continue;
+    }
+    APEX_cpu_printf(cpu, " | pc(%d) %-4s | executed=%u | taken=%u | mispredicted=%u |"
+                    " accuracy=%.1f%% |\n",
+                    4000 + 4 * i, opcode_info[cpu->code_memory[i].opcode].name,
+                    branch->executed, branch->taken, branch->mispredicted,
+                    100.0 * (branch->executed - branch->mispredicted) / branch->executed);
+  }
+}
+
+/* Prints the data cache geometry and what its accesses did */
+static void
+print_dcache_stats(APEX_CPU* cpu)
+{
+  const APEX_Cache_Config* config = &cpu->config.dcache;
+  const APEX_Stats* stats = &cpu->stats;
+
+  APEX_cpu_printf(cpu, "==================DATA CACHE==============\n");
+  if (!config->sets)
+  {
+    APEX_cpu_printf(cpu, " | off |\n");
+    return;
+  }
+  long long accesses = stats->dcache_hits + stats->dcache_misses;
+  APEX_cpu_printf(cpu, " | sets=%d | ways=%d | line=%d | replace=%s | write=%s | miss=%d |\n",
+                  config->sets, config->ways, config->line_bytes,
+                  config->replacement == APEX_REPLACE_LRU ? "lru" : "random",
+                  config->write_policy == APEX_WRITE_BACK ? "back" : "through",
+                  config->miss_latency);
+  APEX_cpu_printf(cpu, " | hits=%lld | misses=%lld | hit rate=%.1f%% | evictions=%lld |"
+                  " writebacks=%lld | write-throughs=%lld |\n",
+                  stats->dcache_hits, stats->dcache_misses,
+                  accesses ? 100.0 * stats->dcache_hits / accesses : 0.0,
+                  stats->dcache_evictions, stats->dcache_writebacks,
+                  stats->dcache_write_throughs);
+  if (cpu->interconnect)
+  {
+    APEX_cpu_printf(cpu, " | coherence=%s | upgrades=%lld | coherence misses=%lld |"
+                    " invalidated=%lld | interventions=%lld | bus wait=%lld |\n",
+                    coherence_names[cpu->config.coherence], stats->dcache_upgrades,
+                    stats->dcache_coherence_misses, stats->dcache_invalidated,
+                    stats->dcache_interventions, stats->bus_wait_cycles);
+  }
+}
+
+/* Prints the issue width, the unit limits and how many instructions
+ * issued per cycle */
+static void
+print_issue_stats(APEX_CPU* cpu)
+{
+  long long cycles = 0;
+  for (int i = 0; i < APEX_CPI_NUM; ++i)
+  {
+    cycles += cpu->stats.cycles[i];
+  }
+
+  APEX_cpu_printf(cpu, "==================ISSUE==============\n");
+  APEX_cpu_printf(cpu, " | width=%d |", cpu->config.width);
+  for (int unit = APEX_UNIT_ALU; unit < APEX_UNIT_NUM; ++unit)
+  {
+    APEX_cpu_printf(cpu, " %s=%d |", unit_names[unit], APEX_unit_limit(&cpu->config, unit));
+  }
+  APEX_cpu_printf(cpu, " IPC=%.3f |\n", cycles ? (double)cpu->stats.retired / cycles : 0.0);
+  for (int i = 0; i <= cpu->config.width; ++i)
+  {
+    APEX_cpu_printf(cpu, " | issued %d | Cycles=%lld |\n", i, cpu->stats.issued[i]);
+  }
+}
+
+void
+APEX_cpu_display(APEX_CPU* cpu)
+{
+  APEX_cpu_printf(cpu, "\n");
+APEX_cpu_printf(cpu, "==================REGISTER VALUE==============");
+  for(int i=0;i<16;i++)
+  {
+    APEX_cpu_printf(cpu, "\n");
+    APEX_cpu_printf(cpu, " | Register[%d] | Value=%d | status=%s |",i,cpu->regs[i],(cpu->scoreboard.busy & (1u << i)) ? "Invalid" : "Valid");
+  }
+
+APEX_cpu_printf(cpu, "\n");
+APEX_cpu_printf(cpu, "==================DATA MEMORY ==============");
+APEX_cpu_printf(cpu, "\n");
+  for(int i=0;i<99;i++)
+  {
+    int value;
+    APEX_data_load(&cpu->data_memory, i, &value);
+    APEX_cpu_printf(cpu, " | MEM[%d] | Value=%d | \n",i,value);
+  }
+  APEX_cpu_printf(cpu, " | Pages=%d | Page size=%d words |\n", APEX_data_pages(&cpu->data_memory),
+                  APEX_PAGE_WORDS);
+  if (cpu->data_fault)
+  {
+    APEX_cpu_printf(cpu, "==================DATA MEMORY FAULT==============\n");
+    APEX_cpu_printf(cpu, " | pc(%d) | address=%d |\n", cpu->fault_pc, cpu->fault_address);
+  }
+  print_cpi_stack(cpu);
+  if (cpu->config.core == APEX_CORE_OOO)
+  {
+    print_ooo_stats(cpu);
+  }
+  else
+  {
+    print_bypass_usage(cpu);
+  }
+  print_branch_stats(cpu);
+  print_dcache_stats(cpu);
+  print_issue_stats(cpu);
+}
+
+/* True for a slot that holds an instruction rather than a bubble */
+static inline int
+slot_used(const CPU_Stage* stage)
+{
+  return stage->opcode != OPCODE_NONE && stage->opcode != OPCODE_EMPTY;
+}
+
+/* Turns the slots of a latch from first on into bubbles */
+APEX_SPECIALIZE void
+clear_slots(APEX_CPU* cpu, APEX_Policy policy, int stage_index, int first)
+{
+  for (int i = first; i < policy.width; ++i)
+  {
+    CPU_Stage* slot = &cpu->stage[stage_index][i];
+    slot->opcode = OPCODE_EMPTY;
+    slot->pc = 0;
+    slot->busy = 0;
+    slot->stalled = 0;
+    slot->src_mask = 0;
+    slot->dst_mask = 0;
+  }
+}
+
+/* Moves a whole latch to the next stage */
+APEX_SPECIALIZE void
+copy_latch(APEX_CPU* cpu, APEX_Policy policy, int to, int from)
+{
+  if (policy.width == 1)
+  {
+    cpu->stage[to][0] = cpu->stage[from][0];
+    return;
+  }
+  memcpy(cpu->stage[to], cpu->stage[from], sizeof(CPU_Stage) * policy.width);
+}
+
+/* Moves the first count slots of a latch to the next stage and the rest
+ * to the front of their own latch, so each keeps its oldest instruction
+ * in slot 0 */
+APEX_SPECIALIZE void
+split_latch(APEX_CPU* cpu, APEX_Policy policy, int to, int from, int count)
+{
+  CPU_Stage* slots = cpu->stage[from];
+  memcpy(cpu->stage[to], slots, sizeof(CPU_Stage) * count);
+  clear_slots(cpu, policy, to, count);
+  memmove(slots, slots + count, sizeof(CPU_Stage) * (policy.width - count));
+  clear_slots(cpu, policy, from, policy.width - count);
+}
+
+/* Dumps slot 0 of a latch like a scalar pipeline, followed by any other
+ * instruction the latch holds */
+static void
+print_latch(APEX_CPU* cpu, char* name, int stage_index)
+{
+  print_stage_content(cpu, name, &cpu->stage[stage_index][0]);
+  for (int i = 1; i < cpu->config.width; ++i)
+  {
+    if (slot_used(&cpu->stage[stage_index][i]))
+    {
+      print_stage_content(cpu, name, &cpu->stage[stage_index][i]);
+    }
+  }
+}
+
+/*
+ * Instructions fetch takes from pc in one cycle: up to the width and
+ * no further than a control instruction, so one prediction is made per
+ * cycle. HALT and the end of the program are fetched alone, which lets
+ * the stages behind HALT stop at a latch boundary.
+ */
+int
+APEX_fetch_group(const APEX_CPU* cpu, int pc)
+{
+  int count = 0;
+  while (count < cpu->config.width)
+  {
+    int index = get_code_index(pc + 4 * count);
+    int opcode = (index >= 0 && index < cpu->code_memory_size)
+                     ? cpu->code_memory[index].opcode
+                     : OPCODE_NONE;
+    if (count > 0 && (opcode == OPCODE_HALT || opcode == OPCODE_NONE))
+    {
+      break;
+    }
+    count++;
+    if (opcode == OPCODE_HALT || opcode == OPCODE_NONE ||
+        (opcode_info[opcode].flags & OPF_CONTROL))
+    {
+      break;
+    }
+  }
+  return count;
+}
+
+/*
+ *  Fetch Stage of APEX Pipeline
+ *
+ *  Note : You are free to edit this function according to your
+ * 				 implementation
+ */
+APEX_SPECIALIZE int
+fetch(APEX_CPU* cpu, APEX_Policy policy)
+{
+  CPU_Stage* stage = &cpu->stage[F][0];
+  if (!stage->busy && !stage->stalled)
+  {
+    int count = APEX_fetch_group(cpu, cpu->pc);
+    for (int i = 0; i < count; ++i)
+    {
+      CPU_Stage* slot = &cpu->stage[F][i];
+      if (i > 0)
+      {
+        slot->busy = 0;
+        slot->stalled = 0;
+      }
+
+      /* Store current PC in fetch latch */
+
+      slot->pc = cpu->pc;
+
+      /* Index into code memory using this pc and copy all instruction fields into
+       * fetch latch, past the end of the program there is nothing to fetch
+       */
+      int index = get_code_index(cpu->pc);
+      if (index >= 0 && index < cpu->code_memory_size)
+      {
+        APEX_Instruction* current_ins = &cpu->code_memory[index];
+        slot->opcode = current_ins->opcode;
+        slot->rd = current_ins->rd;
+        slot->rs1 = current_ins->rs1;
+        slot->rs2 = current_ins->rs2;
+        slot->rs3 = current_ins->rs3;
+        slot->imm = current_ins->imm;
+        slot->src_mask = cpu->dependencies[index].src_mask;
+        slot->dst_mask = cpu->dependencies[index].dst_mask;
+        if (policy.profile)
+        {
+          cpu->profile[index].fetched++;
+        }
+      }
+      else
+      {
+        slot->opcode = OPCODE_NONE;
+        slot->rd = 0;
+        slot->rs1 = 0;
+        slot->rs2 = 0;
+        slot->rs3 = 0;
+        slot->imm = 0;
+        slot->src_mask = 0;
+        slot->dst_mask = 0;
+      }
+
+      /* Update PC for next instruction, following the predicted path past
+       * BZ, BNZ and JUMP; the prediction travels in the latch buffer
+       */
+      if (opcode_info[slot->opcode].flags & OPF_CONTROL)
+      {
+        slot->buffer = APEX_predict_next_pc(cpu, &cpu->code_memory[index],
+                                            cpu->pc);
+        cpu->pc = slot->buffer;
+      }
+      else
+      {
+        cpu->pc += 4;
+      }
+    }
+    clear_slots(cpu, policy, F, count);
+
+    /* Copy data from fetch latch to decode latch*/
+    if (!cpu->stage[DRF][0].stalled)
+    {
+      copy_latch(cpu, policy, DRF, F);
+      cpu->stage[F][0].stalled=0;
+    }
+    else
+    {
+      stage->stalled = 1;
+    }
+    if (policy.debug)
+    {
+      print_latch(cpu, "Fetch Stage", F);
+    }
+  }
+    else
+    {
+
+      if (stage->opcode == OPCODE_EMPTY)
+      {
+        stage->stalled = 0;
+        if (policy.debug)
+         {
+          print_latch(cpu, "Fetch Stage", F);
+         }
+      }
+
+
+      if (!cpu->stage[DRF][0].stalled && cpu->stage[DRF][0].opcode != OPCODE_EMPTY)
+      {
+        stage->stalled = 0;
+        copy_latch(cpu, policy, DRF, F);
+        if (policy.debug)
+        {
+          print_latch(cpu, "Fetch Stage", F);
+        }
+    }
+
+    /* Show if next stage is not HALT */
+    if (cpu->stage[DRF][0].stalled && cpu->stage[DRF][0].opcode != OPCODE_HALT) {
+      if (policy.debug)
+      {
+        print_latch(cpu, "Fetch Stage", F);
+      }
+    }
+
+    }
+
+return 0;
+}
+
+/* Shows the stages behind Memory 1 while a data cache miss or a fault
+ * holds them */
+APEX_SPECIALIZE void
+print_held_stages(APEX_CPU* cpu, APEX_Policy policy)
+{
+  static const char* const names[] = {
+    [F] = "Fetch Stage",
+    [DRF] = "Decode/RF Stage",
+    [EX1] = "Execute 1 Stage",
+    [EX2] = "Execute 2 Stage",
+  };
+
+  if (!policy.debug)
+  {
+    return;
+  }
+  for (int i = EX2; i >= F; --i)
+  {
+    print_latch(cpu, (char*)names[i], i);
+  }
+}
+
+/* Per-opcode handler run by a pipeline stage */
+typedef void (*APEX_Stage_Handler)(APEX_CPU* cpu, CPU_Stage* stage);
+
+/* Cycles from decode until decode can read a result: the first enabled
+ * bypass path the result reaches, or the cycle after writeback */
+static int
+result_latency(APEX_CPU* cpu, const CPU_Stage* stage)
+{
+  int path = (opcode_info[stage->opcode].flags & OPF_LOAD) ? APEX_BYPASS_MEM1
+                                                           : APEX_BYPASS_EX1;
+  for (; path < APEX_BYPASS_NUM; ++path)
+  {
+    if (cpu->config.bypass & (1u << path))
+    {
+      return EX1 + path - DRF;
+    }
+  }
+  return WB + 1 - DRF;
+}
+
+/* Reads a source register, preferring a value forwarded to decode */
+static int
+read_source(APEX_CPU* cpu, int reg)
+{
+  if (cpu->bypass.forwarded & (1u << reg))
+  {
+    return cpu->bypass.value[reg];
+  }
+  return cpu->regs[reg];
+}
+
+/* Counts the sources of an issuing instruction that arrived over a
+ * bypass path rather than from the register file */
+static void
+count_bypass_reads(APEX_CPU* cpu, const CPU_Stage* stage)
+{
+  APEX_Bypass* bypass = &cpu->bypass;
+  uint32_t via = stage->src_mask & (bypass->forwarded | bypass->written);
+  while (via)
+  {
+    int reg = __builtin_ctz(via);
+    via &= via - 1;
+    if (bypass->forwarded & (1u << reg))
+    {
+      cpu->stats.bypass[bypass->path[reg]]++;
+    }
+    else
+    {
+      cpu->stats.bypass[APEX_BYPASS_WB]++;
+    }
+  }
+}
+
+/*
+ * Issues the instruction once none of its source registers and no older
+ * write of its destination is in flight, reading the sources and
+ * claiming the destination in the scoreboard.
+ */
+static void
+decode_issue(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  APEX_Scoreboard* scoreboard = &cpu->scoreboard;
+  if (scoreboard->busy & (stage->src_mask | stage->dst_mask))
+  {
+    stage->stalled = 1;
+    return;
+  }
+
+  stage->stalled = 0;
+  stage->rs1_value = read_source(cpu, stage->rs1);
+  stage->rs2_value = read_source(cpu, stage->rs2);
+  stage->rs3_value = read_source(cpu, stage->rs3);
+  count_bypass_reads(cpu, stage);
+
+  stage->seq = ++cpu->issue_seq;
+  if (stage->dst_mask)
+  {
+    scoreboard->busy |= stage->dst_mask;
+    scoreboard->producer_pc[stage->rd] = stage->pc;
+    scoreboard->producer_seq[stage->rd] = stage->seq;
+    scoreboard->ready_cycle[stage->rd] = cpu->clock + result_latency(cpu, stage);
+  }
+}
+
+/*
+ * Offers the result of the instruction in a stage to decode over the
+ * bypass path of that stage, if the path is enabled. Only the newest
+ * in-flight write of a register is forwarded, and only once the result
+ * exists: from Execute 1 on for ALU results, from Memory 1 on for loads.
+ */
+APEX_SPECIALIZE void
+bypass_forward(APEX_CPU* cpu, APEX_Policy policy, const CPU_Stage* stage,
+               int path)
+{
+  int flags = opcode_info[stage->opcode].flags;
+  if (!(policy.bypass & (1u << path)) || !(flags & OPF_WRITES_RD) ||
+      ((flags & OPF_LOAD) && path < APEX_BYPASS_MEM1))
+  {
+    return;
+  }
+
+  APEX_Scoreboard* scoreboard = &cpu->scoreboard;
+  if (!(scoreboard->busy & stage->dst_mask) ||
+      scoreboard->producer_seq[stage->rd] != stage->seq)
+  {
+    return;
+  }
+  cpu->bypass.value[stage->rd] = stage->buffer;
+  cpu->bypass.path[stage->rd] = path;
+  cpu->bypass.forwarded |= stage->dst_mask;
+  scoreboard->busy &= ~stage->dst_mask;
+}
+
+/*
+ * Called once writeback has updated the register file. Unless a younger
+ * write is in flight, the forwarded copy is dropped and the register is
+ * released: right away over the writeback path, or at the end of the
+ * cycle without it.
+ */
+APEX_SPECIALIZE void
+bypass_retire(APEX_CPU* cpu, APEX_Policy policy, const CPU_Stage* stage)
+{
+  APEX_Scoreboard* scoreboard = &cpu->scoreboard;
+  if (scoreboard->producer_seq[stage->rd] != stage->seq)
+  {
+    return;
+  }
+  cpu->bypass.forwarded &= ~stage->dst_mask;
+  if (scoreboard->busy & stage->dst_mask)
+  {
+    if (policy.bypass & (1u << APEX_BYPASS_WB))
+    {
+      scoreboard->busy &= ~stage->dst_mask;
+      cpu->bypass.written |= stage->dst_mask;
+    }
+    else
+    {
+      cpu->bypass.deferred |= stage->dst_mask;
+    }
+  }
+}
+
+/* Ends the cycle for the bypass network */
+static void
+bypass_end_cycle(APEX_CPU* cpu)
+{
+  cpu->scoreboard.busy &= ~cpu->bypass.deferred;
+  cpu->bypass.deferred = 0;
+  cpu->bypass.written = 0;
+}
+
+/*
+ * Stops the stages behind a HALT that has reached the given stage.
+ * APEX_HALT_BLOCK marks them busy so they keep their latches,
+ * APEX_HALT_SQUASH stalls the latch right behind HALT and clears its pc.
+ */
+static void
+halt_in_stage(APEX_CPU* cpu, int stage_index)
+{
+  CPU_Stage (*stage)[APEX_MAX_WIDTH] = cpu->stage;
+  if (cpu->config.halt == APEX_HALT_SQUASH)
+  {
+    if (stage_index > F)
+    {
+      stage[stage_index - 1][0].stalled = 1;
+      stage[stage_index - 1][0].pc = 0;
+    }
+    stage[F][0].busy = 1;
+    return;
+  }
+
+  switch (stage_index)
+  {
+    case EX1:
+      stage[DRF][0].busy = 1;
+      stage[F][0].busy = 0;
+      stage[F][0].stalled = 1;
+      break;
+
+    case EX2:
+      stage[EX1][0].busy = 1;
+      stage[DRF][0].busy = 1;
+      stage[F][0].stalled = 1;
+      break;
+
+    case MEM1:
+      stage[EX2][0].stalled = 1;
+      stage[DRF][0].busy = 1;
+      stage[EX1][0].busy = 1;
+      stage[F][0].stalled = 1;
+      break;
+
+    case MEM2:
+      stage[MEM1][0].busy = 1;
+      stage[DRF][0].busy = 1;
+      stage[EX1][0].busy = 1;
+      break;
+
+    case WB:
+      stage[F][0].busy = 1;
+      break;
+  }
+}
+
+/* HALT */
+static void
+decode_halt(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  halt_in_stage(cpu, DRF);
+}
+
+static const APEX_Stage_Handler decode_handlers[NUM_OPCODES] = {
+  [OPCODE_STORE] = decode_issue,
+  [OPCODE_STR]   = decode_issue,
+  [OPCODE_LOAD]  = decode_issue,
+  [OPCODE_LDR]   = decode_issue,
+  [OPCODE_MOVC]  = decode_issue,
+  [OPCODE_ADD]   = decode_issue,
+  [OPCODE_ADDL]  = decode_issue,
+  [OPCODE_SUB]   = decode_issue,
+  [OPCODE_SUBL]  = decode_issue,
+  [OPCODE_MUL]   = decode_issue,
+  [OPCODE_AND]   = decode_issue,
+  [OPCODE_OR]    = decode_issue,
+  [OPCODE_EXOR]  = decode_issue,
+  [OPCODE_JUMP]  = decode_issue,
+  [OPCODE_HALT]  = decode_halt,
+  [OPCODE_BZ]    = decode_issue,
+  [OPCODE_BNZ]   = decode_issue,
+};
+
+/*
+ * Runs the decode handler of each instruction in the latch, oldest
+ * first, until one has to wait for a register or finds every unit of
+ * its class taken this cycle, and marks that one stalled. Checking
+ * against the scoreboard the older ones have just updated also catches
+ * dependencies inside the latch. Returns how many went through.
+ */
+APEX_SPECIALIZE int
+decode_slots(APEX_CPU* cpu, APEX_Policy policy)
+{
+  CPU_Stage* slots = cpu->stage[DRF];
+  int used[APEX_UNIT_NUM] = { 0 };
+  int issued = 0;
+  while (issued < policy.width &&
+         (issued == 0 || slot_used(&slots[issued])))
+  {
+    CPU_Stage* stage = &slots[issued];
+    int unit = opcode_info[stage->opcode].unit;
+    if (issued > 0 && unit != APEX_UNIT_NONE &&
+        used[unit] == APEX_unit_limit(&cpu->config, unit))
+    {
+      stage->stalled = 1;
+      break;
+    }
+    APEX_Stage_Handler handler = decode_handlers[stage->opcode];
+    if (handler)
+    {
+      handler(cpu, stage);
+    }
+    if (stage->stalled)
+    {
+      break;
+    }
+    used[unit]++;
+    issued++;
+  }
+  return issued;
+}
+
+/* True if decode_slots held back an instruction, the one in the first
+ * slot that did not issue */
+APEX_SPECIALIZE int
+decode_held(APEX_CPU* cpu, APEX_Policy policy, int issued)
+{
+  return issued < policy.width && cpu->stage[DRF][issued].stalled;
+}
+
+/* Stalled instruction: repeat the checks from the oldest instruction
+ * left, unless HALT has already retired */
+APEX_SPECIALIZE void
+decode_retry_issue(APEX_CPU* cpu, APEX_Policy policy)
+{
+  if (cpu->halt_flag)
+  {
+    return;
+  }
+  int issued = decode_slots(cpu, policy);
+  if (!decode_held(cpu, policy, issued))
+  {
+    copy_latch(cpu, policy, EX1, DRF);
+  }
+  else if (issued > 0)
+  {
+    split_latch(cpu, policy, EX1, DRF, issued);
+  }
+  else if (policy.width > 1)
+  {
+    /* Execute 1 may still hold what issued in the previous cycle */
+    cpu->stage[EX1][0].opcode = OPCODE_EMPTY;
+    cpu->stage[EX1][0].pc = 0;
+    clear_slots(cpu, policy, EX1, 1);
+  }
+}
+
+/* Why the instruction in decode could not issue, one of APEX_CPI_* */
+static int
+decode_stall_cause(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  if (cpu->scoreboard.busy & stage->src_mask)
+  {
+    return APEX_CPI_RAW;
+  }
+  return APEX_CPI_WAW;
+}
+
+/* Names the in-flight instruction a stalled decode is waiting for */
+static void
+print_waiting_on(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  APEX_Scoreboard* scoreboard = &cpu->scoreboard;
+  uint32_t waiting = scoreboard->busy & stage->src_mask;
+  if (!waiting)
+  {
+    waiting = scoreboard->busy & stage->dst_mask;
+  }
+  if (!stage->stalled || !waiting)
+  {
+    return;
+  }
+
+  int reg = __builtin_ctz(waiting);
+  APEX_cpu_printf(cpu, "%-15s: waiting on R%d from pc(%d), ready in cycle %d\n", "",
+                  reg, scoreboard->producer_pc[reg], scoreboard->ready_cycle[reg]);
+}
+
+/* Dumps the decode latch with what each stalled instruction waits for */
+static void
+print_decode_latch(APEX_CPU* cpu, char* name)
+{
+  for (int i = 0; i < cpu->config.width; ++i)
+  {
+    CPU_Stage* slot = &cpu->stage[DRF][i];
+    if (i == 0 || slot_used(slot))
+    {
+      print_stage_content(cpu, name, slot);
+      print_waiting_on(cpu, slot);
+    }
+  }
+}
+
+/*
+ *  Decode Stage of APEX Pipeline
+ *
+ *  Note : You are free to edit this function according to your
+ * 				 implementation
+ */
+APEX_SPECIALIZE int
+decode(APEX_CPU* cpu, APEX_Policy policy)
+{
+  if (policy.halt == APEX_HALT_BLOCK &&
+      cpu->stage[F][0].busy == 1 && cpu->stage[F][0].stalled == 1)
+  {
+    cpu->stage[DRF][0].busy = 1;
+    cpu->stage[DRF][0].stalled = 1;
+  }
+   CPU_Stage* stage = &cpu->stage[DRF][0];
+  if (!stage->busy && !stage->stalled)
+    {
+
+    /* Read sources and check dependencies, in order across the latch */
+    int issued = decode_slots(cpu, policy);
+
+    if (policy.debug)
+    {
+      print_decode_latch(cpu, "Decode/RF Stage");
+    }
+
+    /* Copy data from decode latch to Execute 1 latch*/
+
+    if (issued > 0 && decode_held(cpu, policy, issued))
+    {
+      split_latch(cpu, policy, EX1, DRF, issued);
+    }
+    else if (!stage->stalled && !stage->busy) {
+      copy_latch(cpu, policy, EX1, DRF);
+    }
+    else
+    {
+      cpu->stage[EX1][0].opcode = OPCODE_EMPTY;
+      cpu->stage[EX1][0].pc = 0;
+      cpu->stage[EX1][0].stall_cause = decode_stall_cause(cpu, stage);
+      clear_slots(cpu, policy, EX1, 1);
+    }
+  }
+  else
+  {
+    if (stage->stalled && stage->opcode != OPCODE_HALT && !cpu->stage[EX1][0].stalled)
+    {
+      if (slot_used(stage))
+      {
+        decode_retry_issue(cpu, policy);
+      }
+
+      /* The bubble behind a stalled instruction takes the current cause */
+      if (stage->stalled && cpu->stage[EX1][0].opcode == OPCODE_EMPTY)
+      {
+        cpu->stage[EX1][0].stall_cause = decode_stall_cause(cpu, stage);
+      }
+
+      if (policy.debug)
+      {
+        print_decode_latch(cpu, "Decode/RF");
+      }
+
+      if (cpu->stage[EX1][0].stalled && cpu->stage[EX1][0].opcode != OPCODE_HALT)
+      {
+        if (policy.debug)
+        {
+          print_latch(cpu, "Decode/RF", DRF);
+        }
+      }
+
+      //TODO HALTING
+    }
+  }
+  return 0;
+}
+
+/* Store */
+static void
+execute_store(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->mem_address = APEX_add(stage->rs2_value, stage->imm);
+}
+
+/* STR */
+static void
+execute_str(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->mem_address = APEX_add(stage->rs2_value, stage->rs3_value);
+}
+
+/* LOAD */
+static void
+execute_load(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->mem_address = APEX_add(stage->rs1_value, stage->imm);
+}
+
+/* LDR */
+static void
+execute_ldr(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->mem_address = APEX_add(stage->rs1_value, stage->rs2_value);
+}
+
+/* MOVC */
+static void
+execute_movc(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->buffer = stage->imm + 0;
+}
+
+/* ADD */
+static void
+execute_add(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->buffer = APEX_add(stage->rs1_value, stage->rs2_value);
+  cpu->z_flag_set = (stage->buffer == 0);
+}
+
+/* ADDL */
+static void
+execute_addl(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->buffer = APEX_add(stage->rs1_value, stage->imm);
+  cpu->z_flag_set = (stage->buffer == 0);
+}
+
+/* SUB */
+static void
+execute_sub(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->buffer = APEX_sub(stage->rs1_value, stage->rs2_value);
+  cpu->z_flag_set = (stage->buffer == 0);
+}
+
+/* SUBL */
+static void
+execute_subl(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->buffer = APEX_sub(stage->rs1_value, stage->imm);
+  cpu->z_flag_set = (stage->buffer == 0);
+}
+
+/* AND */
+static void
+execute_and(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->buffer = stage->rs1_value & stage->rs2_value;
+}
+
+/* OR */
+static void
+execute_or(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->buffer = stage->rs1_value | stage->rs2_value;
+}
+
+/* EX-OR */
+static void
+execute_exor(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->buffer = stage->rs1_value ^ stage->rs2_value;
+}
+
+/* MUL */
+static void
+execute_mul(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  stage->buffer = APEX_mul(stage->rs1_value, stage->rs2_value);
+  cpu->z_flag_set = (stage->buffer == 0);
+}
+
+/*
+ * Resolves a control instruction against the pc fetch predicted for it.
+ * On a misprediction the only younger instructions, in Fetch and
+ * Decode/RF, have not issued yet, so turning their latches into bubbles
+ * and redirecting fetch in this same cycle is all the recovery needed.
+ * Fetch ends a group at a control instruction, so none is younger in
+ * its own latch.
+ */
+static void
+resolve_branch(APEX_CPU* cpu, CPU_Stage* stage, int taken, int target)
+{
+  int next_pc = taken ? target : stage->pc + 4;
+  int predicted_pc = stage->buffer;
+  stage->buffer = next_pc;
+  APEX_predictor_update(cpu, stage->pc, stage->opcode, taken, target);
+
+  APEX_Branch_Stats* branch = &cpu->branch_stats[get_code_index(stage->pc)];
+  branch->executed++;
+  branch->taken += taken != 0;
+  cpu->stats.branches++;
+  int to = get_code_index(next_pc);
+  if (cpu->profile && taken && to >= 0 && to < cpu->code_memory_size)
+  {
+    cpu->profile[to].branched_to++;
+  }
+  if (next_pc == predicted_pc)
+  {
+    return;
+  }
+
+  branch->mispredicted++;
+  cpu->stats.mispredicted++;
+  if (cpu->profile)
+  {
+    APEX_profile_squash(cpu);
+  }
+  for (int i = F; i < EX1; ++i)
+  {
+    CPU_Stage* younger = &cpu->stage[i][0];
+    younger->opcode = OPCODE_EMPTY;
+    younger->pc = 0;
+    younger->busy = 0;
+    younger->stalled = 0;
+    younger->stall_cause = APEX_CPI_BRANCH;
+    younger->src_mask = 0;
+    younger->dst_mask = 0;
+    clear_slots(cpu, policy_of(cpu), i, 1);
+  }
+  cpu->pc = next_pc;
+}
+
+/* JUMP */
+static void
+execute_jump(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  resolve_branch(cpu, stage, 1, APEX_add(stage->rs1_value, stage->imm));
+}
+
+/* HALT */
+static void
+execute_halt(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  halt_in_stage(cpu, EX1);
+}
+
+/* BZ, the Z flag is that of the last arithmetic instruction, which
+ * has already left Execute 1 */
+static void
+execute_bz(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  resolve_branch(cpu, stage, cpu->z_flag_set, APEX_add(stage->pc, stage->imm));
+}
+
+/* BNZ */
+static void
+execute_bnz(APEX_CPU* cpu, CPU_Stage* stage)
+{
+  resolve_branch(cpu, stage, !cpu->z_flag_set, APEX_add(stage->pc, stage->imm));
+}
+
+static const APEX_Stage_Handler execute_handlers[NUM_OPCODES] = {
+  [OPCODE_STORE] = execute_store,
+  [OPCODE_STR]   = execute_str,
+  [OPCODE_LOAD]  = execute_load,
+  [OPCODE_LDR]   = execute_ldr,
+  [OPCODE_MOVC]  = execute_movc,
+  [OPCODE_ADD]   = execute_add,
+  [OPCODE_ADDL]  = execute_addl,
+  [OPCODE_SUB]   = execute_sub,
+  [OPCODE_SUBL]  = execute_subl,
+  [OPCODE_AND]   = execute_and,
+  [OPCODE_OR]    = execute_or,
+  [OPCODE_EXOR]  = execute_exor,
+  [OPCODE_MUL]   = execute_mul,
+  [OPCODE_JUMP]  = execute_jump,
+  [OPCODE_HALT]  = execute_halt,
+  [OPCODE_BZ]    = execute_bz,
+  [OPCODE_BNZ]   = execute_bnz,
+};
+
+/*
+ *  Execute 1 Stage of APEX Pipeline
+ *
+ *  Note : You are free to edit this function according to your
+ * 				 implementation
+ */
+APEX_SPECIALIZE int
+execute1(APEX_CPU* cpu, APEX_Policy policy)
+{
+  CPU_Stage* stage = &cpu->stage[EX1][0];
+  if (!stage->busy && !stage->stalled)
+  {
+    /* Oldest first, so BZ and BNZ see the Z flag of an older instruction
+     * in the same latch */
+    for (int i = 0; i < policy.width; ++i)
+    {
+      CPU_Stage* slot = &cpu->stage[EX1][i];
+      APEX_Stage_Handler handler = execute_handlers[slot->opcode];
+      if (handler)
+      {
+        handler(cpu, slot);
+      }
+      bypass_forward(cpu, policy, slot, APEX_BYPASS_EX1);
+    }
+
+    /* Copy data from Execute 1 latch to Execute 2 latch*/
+    if (!stage->stalled)
+    {
+      copy_latch(cpu, policy, EX2, EX1);
+    }
+    else
+    {
+      cpu->stage[DRF][0].stalled = 1;
+      cpu->stage[EX2][0].opcode = OPCODE_EMPTY;
+      cpu->stage[EX2][0].pc = 0;
+      clear_slots(cpu, policy, EX2, 1);
+    }
+
+    if (policy.debug)
+    {
+      print_latch(cpu, "Execute 1 Stage", EX1);
+    }
+  }
+  return 0;
+}
+
+/*
+ *  Execute 2 Stage of APEX Pipeline
+ *
+ *  Note : You are free to edit this function according to your
+ * 				 implementation
+ */
+APEX_SPECIALIZE int
+execute2(APEX_CPU* cpu, APEX_Policy policy)
+{
+  CPU_Stage* stage = &cpu->stage[EX2][0];
+  if (!stage->busy && !stage->stalled)
+  {
+
+    /* Copy data from Execute 2 latch to Memory 1 latch*/
+    if (!stage->stalled)
+    {
+      copy_latch(cpu, policy, MEM1, EX2);
+    }
+    else
+    {
+      cpu->stage[EX1][0].stalled = 1;
+      cpu->stage[MEM1][0].opcode = OPCODE_EMPTY;
+      cpu->stage[MEM1][0].pc = 0;
+      clear_slots(cpu, policy, MEM1, 1);
+    }
+
+
+    if (stage->opcode == OPCODE_HALT)
+    {
+      halt_in_stage(cpu, EX2);
+    }
+    for (int i = 0; i < policy.width; ++i)
+    {
+      bypass_forward(cpu, policy, &cpu->stage[EX2][i], APEX_BYPASS_EX2);
+    }
+
+    if (policy.debug)
+    {
+      print_latch(cpu, "Execute 2 Stage", EX2);
+    }
+  }
+
+  return 0;
+}
+
+/*
+ *  Memory 1 Stage of APEX Pipeline
+ *
+ *  Note : You are free to edit this function according to your
+ * 				 implementation
+ */
+
+APEX_SPECIALIZE int
+memory1(APEX_CPU* cpu, APEX_Policy policy)
+{
+  CPU_Stage* stage = &cpu->stage[MEM1][0];
+
+  /* A blocking HALT keeps holding the earlier stages from here even once
+   * it has moved on and left its copy in this latch */
+  if (stage->opcode == OPCODE_HALT &&
+      (policy.halt == APEX_HALT_BLOCK || (!stage->busy && !stage->stalled)))
+  {
+    halt_in_stage(cpu, MEM1);
+  }
+
+  if (!stage->busy && !stage->stalled)
+  {
+    /* An access the data cache missed on holds this stage, and with it
+     * every earlier one, until the line arrives; the misses of one latch
+     * are served one after the other. A faulting access holds them for
+     * good, once the older instructions of its latch have moved on */
+    int passed = policy.width;
+    if (cpu->dcache_wait)
+    {
+      cpu->dcache_wait--;
+    }
+    else if (!cpu->data_fault)
+    {
+      for (int i = 0; i < policy.width; ++i)
+      {
+        CPU_Stage* slot = &cpu->stage[MEM1][i];
+        int flags = opcode_info[slot->opcode].flags;
+        int fault = 0;
+
+        /* STORE, STR */
+        if (flags & OPF_STORE)
+        {
+          fault = APEX_data_store(&cpu->data_memory, slot->mem_address,
+                                  slot->rs1_value);
+        }
+
+        /* LOAD, LDR */
+        if (flags & OPF_LOAD)
+        {
+          fault = APEX_data_load(&cpu->data_memory, slot->mem_address,
+                                 &slot->buffer);
+        }
+
+        if (fault)
+        {
+          cpu->data_fault = 1;
+          cpu->fault_pc = slot->pc;
+          cpu->fault_address = slot->mem_address;
+          break;
+        }
+        if ((flags & (OPF_LOAD | OPF_STORE)) && cpu->config.dcache.sets)
+        {
+          cpu->dcache_wait += APEX_dcache_access(cpu, slot->mem_address,
+                                                 flags & OPF_STORE);
+        }
+      }
+    }
+    if (cpu->data_fault)
+    {
+      passed = 0;
+      while (cpu->stage[MEM1][passed].pc != cpu->fault_pc)
+      {
+        passed++;
+      }
+    }
+
+    if (cpu->dcache_wait || (cpu->data_fault && !passed))
+    {
+      cpu->stage[MEM2][0].opcode = OPCODE_EMPTY;
+      cpu->stage[MEM2][0].pc = 0;
+      cpu->stage[MEM2][0].stall_cause = cpu->data_fault ? APEX_CPI_HALT
+                                                        : APEX_CPI_DCACHE;
+      clear_slots(cpu, policy, MEM2, 1);
+    }
+    else if (cpu->data_fault)
+    {
+      for (int i = 0; i < passed; ++i)
+      {
+        bypass_forward(cpu, policy, &cpu->stage[MEM1][i], APEX_BYPASS_MEM1);
+      }
+      split_latch(cpu, policy, MEM2, MEM1, passed);
+    }
+    else
+    {
+      for (int i = 0; i < policy.width; ++i)
+      {
+        bypass_forward(cpu, policy, &cpu->stage[MEM1][i], APEX_BYPASS_MEM1);
+      }
+
+      /* Copy data from Memory 1 latch to Mmemory 2 latch*/
+      if (!stage->stalled)
+      {
+        copy_latch(cpu, policy, MEM2, MEM1);
+      }
+      else
+      {
+        cpu->stage[EX2][0].stalled = 1;
+        cpu->stage[EX2][0].opcode = OPCODE_EMPTY;
+        //cpu->stage[EX2][0].pc = 0;
+      }
+    }
+
+    if (policy.debug)
+    {
+      print_latch(cpu, "Memory 1 Stage", MEM1);
+    }
+
+
+  }
+  return 0;
+}
+
+/*
+ *  Memory 2 Stage of APEX Pipeline
+ *  Note : You are free to edit this function according to your
+ * 				 implementation
+ */
+APEX_SPECIALIZE int
+memory2(APEX_CPU* cpu, APEX_Policy policy)
+{
+  CPU_Stage* stage = &cpu->stage[MEM2][0];
+  if (!stage->busy && !stage->stalled)
+  {
+    if (stage->opcode == OPCODE_HALT)
+    {
+      halt_in_stage(cpu, MEM2);
+    }
+    for (int i = 0; i < policy.width; ++i)
+    {
+      bypass_forward(cpu, policy, &cpu->stage[MEM2][i], APEX_BYPASS_MEM2);
+    }
+
+    /* Copy data from Memory 2 latch to writeback latch*/
+    if (!stage->stalled)
+    {
+      copy_latch(cpu, policy, WB, MEM2);
+    }
+    else
+    {
+      cpu->stage[MEM1][0].stalled = 1;
+      cpu->stage[WB][0].opcode = OPCODE_EMPTY;
+      //cpu->stage[WB][0].pc = 0;
+    }
+
+
+    if (policy.debug)
+    {
+      print_latch(cpu, "Memory 2 Stage", MEM2);
+    }
+
+
+  }
+  return 0;
+}
+
+/*
+ * Charges the current cycle to the oldest instruction in writeback if
+ * it retires. Otherwise a bubble carries the cause decode tagged it
+ * with, and anything else is pipeline fill or the drain behind HALT.
+ */
+static int
+cycle_cause(APEX_CPU* cpu, const CPU_Stage* stage)
+{
+  if (stage->opcode == OPCODE_EMPTY)
+  {
+    return stage->stall_cause;
+  }
+  if (!stage->busy && !stage->stalled && stage->opcode != OPCODE_NONE)
+  {
+    return APEX_CPI_BASE;
+  }
+  for (int i = 0; i < NUM_STAGES; ++i)
+  {
+    if (cpu->stage[i][0].opcode == OPCODE_HALT)
+    {
+      return APEX_CPI_HALT;
+    }
+  }
+  return APEX_CPI_FETCH;
+}
+
+/*
+ *  Writeback Stage of APEX Pipeline
+ *
+ *  Note : You are free to edit this function according to your
+ * 				 implementation
+ */
+APEX_SPECIALIZE int
+writeback(APEX_CPU* cpu, APEX_Policy policy)
+{
+  CPU_Stage* stage = &cpu->stage[WB][0];
+  if (!stage->busy && !stage->stalled)
+  {
+    for (int i = 0; i < policy.width; ++i)
+    {
+      CPU_Stage* slot = &cpu->stage[WB][i];
+      int flags = opcode_info[slot->opcode].flags;
+
+      if (slot->opcode == OPCODE_HALT)
+        {
+          cpu->halt_flag = 1;
+          halt_in_stage(cpu, WB);
+          if (cpu->enable_display && policy.halt == APEX_HALT_BLOCK)
+          {
+            APEX_cpu_printf(cpu, "CHECK CONDITION");
+          }
+        }
+      /* Update register file */
+      if (flags & OPF_WRITES_RD)
+      {
+        cpu->regs[slot->rd] = slot->buffer;
+        bypass_retire(cpu, policy, slot);
+      }
+
+      if (slot_used(slot))
+      {
+        cpu->ins_completed++;
+        cpu->stats.retired++;
+        if (policy.profile)
+        {
+          cpu->profile[get_code_index(slot->pc)].retired++;
+        }
+      }
+    }
+
+      if (policy.debug)
+      {
+        print_latch(cpu, "Writeback Stage", WB);
+      }
+
+  }
+  cpu->stats.cycles[cycle_cause(cpu, stage)]++;
+  return 0;
+}
+
+/* Machine state at the end of the previous cycle, kept while fetch is idle */
+typedef struct APEX_Idle_State
+{
+  int valid;
+  long long last_retired;   // stats.retired after the previous cycle
+  int pc;
+  int z_flag_set;
+  int regs[16];
+  APEX_Scoreboard scoreboard;
+  APEX_Bypass bypass;
+  CPU_Stage stage[NUM_STAGES][APEX_MAX_WIDTH];
+  int ins_completed;
+  APEX_Stats stats;
+} APEX_Idle_State;
+
+static void
+save_idle_state(APEX_CPU* cpu, APEX_Idle_State* idle)
+{
+  idle->valid = 1;
+  idle->pc = cpu->pc;
+  idle->z_flag_set = cpu->z_flag_set;
+  memcpy(idle->regs, cpu->regs, sizeof(idle->regs));
+  idle->scoreboard = cpu->scoreboard;
+  idle->bypass = cpu->bypass;
+  for (int i = 0; i < NUM_STAGES; ++i)
+  {
+    for (int j = 0; j < cpu->config.width; ++j)
+    {
+      idle->stage[i][j] = cpu->stage[i][j];
+    }
+  }
+  idle->ins_completed = cpu->ins_completed;
+  idle->stats = cpu->stats;
+}
+
+/* Compares two latches on everything but their pc */
+static int
+same_latch(const CPU_Stage* a, const CPU_Stage* b)
+{
+  return a->opcode == b->opcode && a->rd == b->rd && a->rs1 == b->rs1 &&
+         a->rs2 == b->rs2 && a->rs3 == b->rs3 && a->busy == b->busy &&
+         a->stalled == b->stalled && a->stall_cause == b->stall_cause &&
+         a->seq == b->seq &&
+         a->src_mask == b->src_mask && a->dst_mask == b->dst_mask &&
+         a->imm == b->imm &&
+         a->rs1_value == b->rs1_value && a->rs2_value == b->rs2_value &&
+         a->rs3_value == b->rs3_value && a->buffer == b->buffer &&
+         a->mem_address == b->mem_address;
+}
+
+/*
+ * Skips cycles in which no latch can change.
+ *
+ * A cycle that leaves every latch, register and flag as it found them
+ * will do the same on every following cycle, so the clock and counters
+ * can be moved on in one step. While fetch is running past the end of
+ * the program only pc values move, always by the same amount, and those
+ * are carried forward too. A data cache miss freezes the pipeline the
+ * same way once the stages behind Memory 1 have drained: every cycle
+ * but the last of the wait only counts it down and charges a bubble to
+ * the dcache cause, so those cycles are skipped too, leaving the one in
+ * which Memory 1 lets its latch go. Returns the number of cycles skipped.
+ *
+ * Note : Only used when no per-cycle trace is printed or recorded and
+ *        no profile is counted
+ */
+static long long
+skip_idle_cycles(APEX_CPU* cpu, APEX_Idle_State* idle, int pc_before)
+{
+  /* Unless fetch held its pc or is fetching beyond code memory, the
+   * pipeline is making progress, and so it is while instructions retire
+   */
+  int past_end = get_code_index(cpu->pc) >= cpu->code_memory_size;
+  int retiring = cpu->stats.retired != idle->last_retired;
+  idle->last_retired = cpu->stats.retired;
+  if ((!past_end && cpu->pc != pc_before) || retiring || cpu->data_fault)
+  {
+    idle->valid = 0;
+    return 0;
+  }
+
+  if (!idle->valid || cpu->z_flag_set != idle->z_flag_set ||
+      memcmp(cpu->regs, idle->regs, sizeof(idle->regs)) ||
+      memcmp(&cpu->scoreboard, &idle->scoreboard, sizeof(idle->scoreboard)) ||
+      memcmp(&cpu->bypass, &idle->bypass, sizeof(idle->bypass)))
+  {
+    save_idle_state(cpu, idle);
+    return 0;
+  }
+
+  int pc_step = cpu->pc - idle->pc;
+  if (pc_step != 0 && !past_end)
+  {
+    save_idle_state(cpu, idle);
+    return 0;
+  }
+  for (int i = 0; i < NUM_STAGES; ++i)
+  {
+    for (int j = 0; j < cpu->config.width; ++j)
+    {
+      int step = cpu->stage[i][j].pc - idle->stage[i][j].pc;
+      if ((step != 0 && step != pc_step) ||
+          !same_latch(&cpu->stage[i][j], &idle->stage[i][j]))
+      {
+        save_idle_state(cpu, idle);
+        return 0;
+      }
+    }
+  }
+
+  /* Stop short of the cycle limit and of a pending checkpoint */
+  long long skip = (long long)INT_MAX - cpu->clock;
+  if (cpu->clockcycles >= cpu->clock)
+  {
+    skip = cpu->clockcycles - cpu->clock;
+  }
+  if (cpu->checkpoint_file && cpu->checkpoint_cycle > cpu->clock &&
+      cpu->checkpoint_cycle - 1 - cpu->clock < skip)
+  {
+    skip = cpu->checkpoint_cycle - 1 - cpu->clock;
+  }
+  int ins_step = cpu->ins_completed - idle->ins_completed;
+  if (ins_step > 0 && (INT_MAX - cpu->ins_completed) / ins_step < skip)
+  {
+    skip = (INT_MAX - cpu->ins_completed) / ins_step;
+  }
+  if (pc_step > 0 && (INT_MAX - cpu->pc) / pc_step < skip)
+  {
+    skip = (INT_MAX - cpu->pc) / pc_step;
+  }
+  if (cpu->dcache_wait && cpu->dcache_wait - 1 < skip)
+  {
+    skip = cpu->dcache_wait - 1;
+  }
+
+  if (skip > 0)
+  {
+    long long retired_step = cpu->stats.retired - idle->stats.retired;
+    long long cycles_step[APEX_CPI_NUM];
+    for (int i = 0; i < APEX_CPI_NUM; ++i)
+    {
+      cycles_step[i] = cpu->stats.cycles[i] - idle->stats.cycles[i];
+    }
+    long long bypass_step[APEX_BYPASS_NUM];
+    for (int i = 0; i < APEX_BYPASS_NUM; ++i)
+    {
+      bypass_step[i] = cpu->stats.bypass[i] - idle->stats.bypass[i];
+    }
+    long long issued_step[APEX_MAX_WIDTH + 1];
+    for (int i = 0; i <= APEX_MAX_WIDTH; ++i)
+    {
+      issued_step[i] = cpu->stats.issued[i] - idle->stats.issued[i];
+    }
+    for (int i = 0; i < NUM_STAGES; ++i)
+    {
+      for (int j = 0; j < cpu->config.width; ++j)
+      {
+        if (cpu->stage[i][j].pc != idle->stage[i][j].pc)
+        {
+          cpu->stage[i][j].pc += skip * pc_step;
+        }
+      }
+    }
+    cpu->clock += skip;
+    cpu->dcache_wait -= cpu->dcache_wait ? skip : 0;
+    cpu->pc += skip * pc_step;
+    cpu->ins_completed += skip * ins_step;
+    cpu->stats.retired += skip * retired_step;
+    for (int i = 0; i < APEX_CPI_NUM; ++i)
+    {
+      cpu->stats.cycles[i] += skip * cycles_step[i];
+    }
+    for (int i = 0; i < APEX_BYPASS_NUM; ++i)
+    {
+      cpu->stats.bypass[i] += skip * bypass_step[i];
+    }
+    for (int i = 0; i <= APEX_MAX_WIDTH; ++i)
+    {
+      cpu->stats.issued[i] += skip * issued_step[i];
+    }
+  }
+  save_idle_state(cpu, idle);
+  return skip;
+}
+
+/* True once fetch has left the program and no instruction is left in
+ * any latch */
+APEX_SPECIALIZE int
+program_retired(APEX_CPU* cpu, APEX_Policy policy)
+{
+  int index = get_code_index(cpu->pc);
+  if (index >= 0 && index < cpu->code_memory_size)
+  {
+    return 0;
+  }
+  for (int i = 0; i < NUM_STAGES; ++i)
+  {
+    for (int j = 0; j < policy.width; ++j)
+    {
+      if (slot_used(&cpu->stage[i][j]))
+      {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/* True once the instructions older than a faulting load or store have
+ * left Memory 2 and writeback */
+APEX_SPECIALIZE int
+fault_drained(APEX_CPU* cpu, APEX_Policy policy)
+{
+  for (int i = MEM2; i <= WB; ++i)
+  {
+    for (int j = 0; j < policy.width; ++j)
+    {
+      if (slot_used(&cpu->stage[i][j]))
+      {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/* Cycles of the in-order pipeline, until the cycle limit, HALT, a fault
+ * or, with HALT squashing, the end of the program */
+APEX_SPECIALIZE void
+run_cycles(APEX_CPU* cpu, APEX_Policy policy)
+{
+  APEX_Idle_State idle;
+  idle.valid = 0;
+  idle.last_retired = cpu->stats.retired;
+
+  while (1)
+  {
+
+    /* All the instructions committed, so exit */
+    if ((policy.halt == APEX_HALT_SQUASH && program_retired(cpu, policy)) ||
+        cpu->clock == cpu->clockcycles)
+    {
+      cpu->reached_end = 1;
+      break;
+    }
+
+    /* A faulting load or store ends the run precisely, after every older
+     * instruction and none of the younger ones */
+    if (cpu->data_fault && fault_drained(cpu, policy))
+    {
+      break;
+    }
+
+    ++cpu->clock;
+    if (policy.debug)
+    {
+      APEX_cpu_printf(cpu, "--------------------------------\n");
+      APEX_cpu_printf(cpu, "Clock Cycle #: %d\n", cpu->clock);
+      APEX_cpu_printf(cpu, "--------------------------------\n");
+
+    }
+
+    if (policy.trace)
+    {
+      APEX_trace_cycle(cpu->trace, cpu);
+    }
+
+    int pc_before = cpu->pc;
+    uint32_t seq_before = cpu->issue_seq;
+
+    writeback(cpu, policy);
+    memory2(cpu, policy);
+    memory1(cpu, policy);
+    if (cpu->data_fault || cpu->dcache_wait)
+    {
+      print_held_stages(cpu, policy);
+      if (policy.profile)
+      {
+        APEX_profile_decode(cpu, 1);
+      }
+    }
+    else
+    {
+      execute2(cpu, policy);
+      execute1(cpu, policy);
+      decode(cpu, policy);
+      if (policy.profile)
+      {
+        APEX_profile_decode(cpu, 0);
+      }
+      fetch(cpu, policy);
+    }
+    bypass_end_cycle(cpu);
+    cpu->stats.issued[cpu->issue_seq - seq_before]++;
+
+    if (cpu->checkpoint_file && cpu->clock == cpu->checkpoint_cycle)
+    {
+      if (APEX_cpu_save_checkpoint(cpu, cpu->checkpoint_file) != 0)
+      {
+        APEX_cpu_error(cpu, "APEX_Error : Unable to write checkpoint %s\n",
+                       cpu->checkpoint_file);
+      }
+    }
+
+    if (cpu->halt_flag == 1)
+    {
+      break;
+    }
+
+    if (!policy.debug && !policy.trace && !policy.profile)
+    {
+      skip_idle_cycles(cpu, &idle, pc_before);
+    }
+  }
+}
+
+/*
+ *  APEX CPU simulation loop. Runs until the cycle limit, HALT, a fault
+ *  or the end of the program, printing nothing but the cycles in
+ *  "simulate" mode; the caller reports the outcome, see APEX_cpu_report.
+ *  Returns 0, or -1 after a fault.
+ *
+ *  Note : You are free to edit this function according to your
+ * 				 implementation
+ */
+/* Fixed policies of the variants below */
+static const APEX_Policy part_a_policy = {
+  APEX_BYPASS_PART_A, APEX_HALT_BLOCK, 1, 0, 0, 0
+};
+static const APEX_Policy part_b_policy = {
+  APEX_BYPASS_PART_B, APEX_HALT_SQUASH, 1, 0, 0, 0
+};
+static const APEX_Policy part_a_wide_policy = {
+  APEX_BYPASS_PART_A, APEX_HALT_BLOCK, 2, 0, 0, 0
+};
+static const APEX_Policy part_b_wide_policy = {
+  APEX_BYPASS_PART_B, APEX_HALT_SQUASH, 2, 0, 0, 0
+};
+
+static void
+run_part_a(APEX_CPU* cpu)
+{
+  run_cycles(cpu, part_a_policy);
+}
+
+static void
+run_part_b(APEX_CPU* cpu)
+{
+  run_cycles(cpu, part_b_policy);
+}
+
+static void
+run_part_a_wide(APEX_CPU* cpu)
+{
+  run_cycles(cpu, part_a_wide_policy);
+}
+
+static void
+run_part_b_wide(APEX_CPU* cpu)
+{
+  run_cycles(cpu, part_b_wide_policy);
+}
+
+/* A copy of the cycle loop compiled for one policy */
+typedef struct APEX_Pipeline_Variant
+{
+  const APEX_Policy* policy;
+  void (*run)(APEX_CPU* cpu);
+} APEX_Pipeline_Variant;
+
+/*
+ * The configurations run most often, the defaults of both Parts one and
+ * two wide, each without messages, trace or profile, so those checks and the
+ * loops over the width fold away in them. Both Parts carry every
+ * variant since either can be switched to the other's policy.
+ */
+static const APEX_Pipeline_Variant pipeline_variants[] = {
+  { &part_a_policy,      run_part_a },
+  { &part_b_policy,      run_part_b },
+  { &part_a_wide_policy, run_part_a_wide },
+  { &part_b_wide_policy, run_part_b_wide },
+};
+
+/* Runs the variant compiled for the policy of the cpu, or the generic
+ * loop, which reads the policy as it runs */
+static void
+run_pipeline(APEX_CPU* cpu)
+{
+  APEX_Policy policy = policy_of(cpu);
+  for (size_t i = 0;
+       i < sizeof(pipeline_variants) / sizeof(pipeline_variants[0]); ++i)
+  {
+    const APEX_Policy* fixed = pipeline_variants[i].policy;
+    if (fixed->bypass == policy.bypass && fixed->halt == policy.halt &&
+        fixed->width == policy.width && fixed->debug == policy.debug &&
+        fixed->trace == policy.trace && fixed->profile == policy.profile)
+    {
+      pipeline_variants[i].run(cpu);
+      return;
+    }
+  }
+  run_cycles(cpu, policy);
+}
+
+int APEX_cpu_run(APEX_CPU *cpu)
+{
+  cpu->reached_end = 0;
+  if (cpu->config.core == APEX_CORE_OOO)
+  {
+    if (APEX_ooo_run(cpu) != 0)
+    {
+      APEX_cpu_error(cpu, "APEX_Error : Unable to allocate the out-of-order core\n");
+      return -1;
+    }
+  }
+  else
+  {
+    run_pipeline(cpu);
+  }
+  return cpu->data_fault ? -1 : 0;
+}
+
+/* Names the address and pc of a fault, if the run ended in one */
+void
+APEX_cpu_print_fault(const APEX_CPU* cpu)
+{
+  if (cpu->data_fault)
+  {
+    APEX_cpu_error(cpu, "APEX_Error : data memory address %d out of range at pc(%d)\n",
+                   cpu->fault_address, cpu->fault_pc);
+  }
+}
+
+/* Reports how a run ended: in "simulate" and "display" mode that it
+ * completed, if it reached the cycle limit or the end of the program,
+ * and the final state; and any fault */
+void
+APEX_cpu_report(APEX_CPU* cpu)
+{
+  if (cpu->enable_display && cpu->reached_end)
+  {
+    APEX_cpu_printf(cpu, "(apex) >> Simulation Complete");
+  }
+  APEX_cpu_print_fault(cpu);
+  if (cpu->enable_display)
+  {
+    APEX_cpu_display(cpu);
+  }
+}
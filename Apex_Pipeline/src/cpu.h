@@ -0,0 +1,876 @@
+#ifndef _APEX_CPU_H_
+#define _APEX_CPU_H_
+/**
+ *  cpu.h
+ *  Contains various CPU and Pipeline Data structures
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#include "apex.h"
+
+enum
+{
+  F,
+  DRF,
+  EX1,
+  EX2,
+  MEM1,
+  MEM2,
+  WB,
+  NUM_STAGES
+};
+
+/* APEX opcodes, resolved once when code memory is created */
+enum
+{
+  OPCODE_NONE,    // No instruction (blank latch)
+  OPCODE_STORE,
+  OPCODE_STR,
+  OPCODE_LOAD,
+  OPCODE_LDR,
+  OPCODE_MOVC,
+  OPCODE_ADD,
+  OPCODE_ADDL,
+  OPCODE_SUB,
+  OPCODE_SUBL,
+  OPCODE_MUL,
+  OPCODE_AND,
+  OPCODE_OR,
+  OPCODE_EXOR,
+  OPCODE_BZ,
+  OPCODE_BNZ,
+  OPCODE_JUMP,
+  OPCODE_HALT,
+  OPCODE_EMPTY,   // Bubble inserted behind a stalled stage
+  NUM_OPCODES
+};
+
+/* Operand layout of an instruction in the input file */
+enum
+{
+  FMT_NONE,         // HALT
+  FMT_RD_IMM,       // MOVC,Rd,#imm
+  FMT_RD_RS1_RS2,   // ADD,Rd,Rs1,Rs2
+  FMT_RD_RS1_IMM,   // LOAD,Rd,Rs1,#imm
+  FMT_RS1_RS2_IMM,  // STORE,Rs1,Rs2,#imm
+  FMT_RS1_RS2_RS3,  // STR,Rs1,Rs2,Rs3
+  FMT_RS1,          // JUMP,Rs1[,#imm]
+  FMT_IMM           // BZ,#imm
+};
+
+/* Opcode properties tested by the pipeline stages */
+#define OPF_WRITES_RD   0x01  // Result is written to register rd
+#define OPF_ARITH       0x02  // ADD, ADDL, SUB, SUBL, MUL
+#define OPF_SETS_Z      0x04  // Result updates the Z flag in Execute 1
+#define OPF_LOAD        0x08  // Reads data memory
+#define OPF_STORE       0x10  // Writes data memory
+#define OPF_READS_RS1   0x20  // Source registers read in decode
+#define OPF_READS_RS2   0x40
+#define OPF_READS_RS3   0x80
+#define OPF_CONTROL     0x100 // BZ, BNZ, JUMP: resolved in Execute 1
+
+/* Functional unit classes, issue is limited per class and cycle */
+enum
+{
+  APEX_UNIT_NONE,     // HALT, takes an issue slot of its own
+  APEX_UNIT_ALU,      // MOVC, ADD, ADDL, SUB, SUBL, AND, OR, EX-OR
+  APEX_UNIT_MUL,
+  APEX_UNIT_MEM,      // LOAD, LDR, STORE, STR
+  APEX_UNIT_BRANCH,   // BZ, BNZ, JUMP
+  APEX_UNIT_NUM
+};
+
+extern const char* const unit_names[APEX_UNIT_NUM];
+
+/* Static description of an opcode */
+typedef struct APEX_Opcode_Info
+{
+  const char* name;   // Mnemonic as written in the input file
+  int format;         // Operand layout, one of FMT_*
+  int flags;          // OPF_* properties
+  int unit;           // APEX_UNIT_* it issues to
+} APEX_Opcode_Info;
+
+extern const APEX_Opcode_Info opcode_info[NUM_OPCODES];
+
+/* Format of an APEX instruction, fixed width so code memory stays compact */
+typedef struct APEX_Instruction
+{
+  uint8_t opcode;	// Operation Code, one of OPCODE_*
+  uint8_t rd;		// Destination Register Address
+  uint8_t rs1;		// Source-1 Register Address
+  uint8_t rs2;		// Source-2 Register Address
+  uint8_t rs3;		// Source-3 Register Address
+  int32_t imm;		// Literal Value
+} APEX_Instruction;
+
+/*
+ * Register arithmetic wraps around in 32 bits, as the translated code
+ * does on the host. It is done unsigned, where C defines the wrap, so
+ * that every engine agrees on a result that overflows.
+ */
+static inline int
+APEX_add(int a, int b)
+{
+  return (int)((uint32_t)a + (uint32_t)b);
+}
+
+static inline int
+APEX_sub(int a, int b)
+{
+  return (int)((uint32_t)a - (uint32_t)b);
+}
+
+static inline int
+APEX_mul(int a, int b)
+{
+  return (int)((uint32_t)a * (uint32_t)b);
+}
+
+/* Header of a pre-assembled program image, followed by the instructions */
+#define APEX_IMAGE_MAGIC    0x58455041  // "APEX"
+#define APEX_IMAGE_VERSION  1
+
+typedef struct APEX_Image_Header
+{
+  uint32_t magic;             // APEX_IMAGE_MAGIC
+  uint32_t version;           // APEX_IMAGE_VERSION
+  uint32_t instruction_size;  // sizeof(APEX_Instruction) of the writer
+  uint32_t count;             // Number of instructions in the image
+} APEX_Image_Header;
+
+/* Model of CPU stage latch
+ *
+ * Latches are copied from stage to stage every cycle, so operand fields are
+ * packed into bytes; the instruction itself is identified by its pc.
+ */
+typedef struct CPU_Stage
+{
+  int pc;		    // Program Counter
+  uint8_t opcode;	// Operation Code, one of OPCODE_*
+  uint8_t rd;		// Destination Register Address
+  uint8_t rs1;		// Source-1 Register Address
+  uint8_t rs2;		// Source-2 Register Address
+  uint8_t rs3;		// Source-3 Register Address
+  uint8_t busy;		// Flag to indicate, stage is performing some action
+  uint8_t stalled;	// Flag to indicate, stage is stalled
+  uint8_t stall_cause;	// APEX_CPI_* cause of a bubble (OPCODE_EMPTY)
+  uint16_t src_mask;	// Registers read, one bit per register
+  uint16_t dst_mask;	// Register written
+  int imm;		    // Literal Value
+  int rs1_value;	// Source-1 Register Value
+  int rs2_value;	// Source-2 Register Value
+  int rs3_value;	// Source-3 Register Value
+  int buffer;		// Latch to hold some value; the predicted, then the
+  			// resolved next pc of BZ, BNZ and JUMP
+  int mem_address;	// Computed Memory Address
+  uint32_t seq;		// Issue order, tags the result on the bypass network
+} CPU_Stage;
+
+/* All seven latches of a scalar pipeline should fit in five cache lines */
+_Static_assert(sizeof(CPU_Stage) * NUM_STAGES <= 320, "CPU_Stage grew too large");
+
+/* Instructions a latch can hold, see APEX_Config.width */
+#define APEX_MAX_WIDTH  8
+
+/* Register masks of an instruction, computed once per code memory entry */
+typedef struct APEX_Dependency
+{
+  uint16_t src_mask;
+  uint16_t dst_mask;
+} APEX_Dependency;
+
+/*
+ * Register scoreboard. A set bit in busy marks a register whose newest
+ * value is still in flight; decode issues an instruction once its masks
+ * and busy have no bit in common.
+ */
+typedef struct APEX_Scoreboard
+{
+  uint32_t busy;
+  int producer_pc[16];  // pc of the in-flight instruction writing the register
+  int ready_cycle[16];  // Cycle in which that result can be read
+  uint32_t producer_seq[16];  // Issue order of that instruction
+} APEX_Scoreboard;
+
+/* Bypass paths, one per stage from Execute 1 on. A result leaves on the
+ * path of the first enabled stage it reaches and decode reads it in the
+ * same cycle; with no path enabled it is read the cycle after writeback.
+ */
+enum
+{
+  APEX_BYPASS_EX1,
+  APEX_BYPASS_EX2,
+  APEX_BYPASS_MEM1,
+  APEX_BYPASS_MEM2,
+  APEX_BYPASS_WB,
+  APEX_BYPASS_NUM
+};
+
+extern const char* const bypass_names[APEX_BYPASS_NUM];
+
+/* Results forwarded to decode ahead of writeback */
+typedef struct APEX_Bypass
+{
+  uint32_t forwarded; // Registers whose newest value is in value[]
+  uint32_t written;   // Registers released by writeback this cycle
+  uint32_t deferred;  // Registers released at the end of this cycle
+  int value[16];
+  uint8_t path[16];   // APEX_BYPASS_* each value arrived on
+} APEX_Bypass;
+
+/* What happens behind a HALT */
+enum
+{
+  APEX_HALT_BLOCK,    // Earlier stages hold their latches (Part A)
+  APEX_HALT_SQUASH,   // Earlier latches are cleared, and the run also ends
+                      // once every instruction has retired (Part B)
+};
+
+/* Direction predictors for BZ and BNZ, see predictor.c */
+enum
+{
+  APEX_PREDICT_STATIC,    // Always not taken
+  APEX_PREDICT_BIMODAL,   // 2-bit counter per branch pc
+  APEX_PREDICT_GSHARE,    // 2-bit counter per pc xor global history
+  APEX_PREDICT_NUM
+};
+
+extern const char* const predictor_names[APEX_PREDICT_NUM];
+
+#define APEX_BHT_ENTRIES      4096
+#define APEX_BTB_MAX_ENTRIES  1024
+
+/* Last target of the JUMP at pc, pc 0 marks an empty entry */
+typedef struct APEX_BTB_Entry
+{
+  int pc;
+  int target;
+} APEX_BTB_Entry;
+
+typedef struct APEX_Predictor
+{
+  uint32_t history;                   // Latest outcomes, newest in bit 0
+  uint8_t counters[APEX_BHT_ENTRIES]; // 0,1 predict not taken; 2,3 taken
+  APEX_BTB_Entry btb[APEX_BTB_MAX_ENTRIES];
+} APEX_Predictor;
+
+/* Outcomes of one static branch */
+typedef struct APEX_Branch_Stats
+{
+  uint32_t executed;
+  uint32_t taken;
+  uint32_t mispredicted;
+} APEX_Branch_Stats;
+
+/* Why an instruction spent a cycle in decode without issuing */
+enum
+{
+  APEX_STALL_RAW,     // A source register was still in flight
+  APEX_STALL_WAW,     // An older write of rd was still in flight
+  APEX_STALL_UNIT,    // Every unit of its class was taken that cycle
+  APEX_STALL_ORDER,   // An older instruction of its latch had stalled
+  APEX_STALL_HELD,    // A later stage held decode: HALT, a cache miss, a fault
+  APEX_STALL_NUM
+};
+
+extern const char* const stall_names[APEX_STALL_NUM];
+
+/* What one code memory entry did in a profiled run, see profile.c */
+typedef struct APEX_Profile_Entry
+{
+  long long fetched;
+  long long retired;
+  long long squashed;                   // Fetched down a mispredicted path
+  long long branched_to;                // Taken branches and JUMPs landing here
+  long long stalled[APEX_STALL_NUM];    // Cycles in decode, by cause
+} APEX_Profile_Entry;
+
+/* L1 data cache, see cache.c */
+enum
+{
+  APEX_REPLACE_LRU,
+  APEX_REPLACE_RANDOM
+};
+
+enum
+{
+  APEX_WRITE_BACK,      // Stores dirty the line, written back on eviction
+  APEX_WRITE_THROUGH    // Stores go to memory, no allocation on a miss
+};
+
+#define APEX_DCACHE_MAX_LINES  (1 << 20)
+
+/* Protocols keeping the data caches of several cores coherent */
+enum
+{
+  APEX_COHERENCE_MSI,   // Modified, Shared, Invalid
+  APEX_COHERENCE_MESI,  // and Exclusive, written without a bus upgrade
+  APEX_COHERENCE_NUM
+};
+
+extern const char* const coherence_names[APEX_COHERENCE_NUM];
+
+/* Cores of a multicore run, each with its own program and data cache */
+#define APEX_MAX_CORES  64
+
+typedef struct APEX_Cache_Config
+{
+  int sets;           // Power of two, 0 for an ideal one cycle memory
+  int ways;
+  int line_bytes;     // Power of two, at least one word
+  int replacement;    // APEX_REPLACE_*
+  int write_policy;   // APEX_WRITE_*
+  int miss_latency;   // Cycles Memory 1 is held to fill a line
+} APEX_Cache_Config;
+
+typedef struct APEX_Cache_Line
+{
+  uint32_t tag;
+  uint8_t valid;
+  uint8_t dirty;        // Modified
+  uint8_t exclusive;    // Clean and the only copy among the cores (MESI)
+  uint8_t invalidated;  // Invalid because another core wrote the line
+  uint32_t last_used;   // Cache clock of the latest access, for LRU
+} APEX_Cache_Line;
+
+typedef struct APEX_Cache
+{
+  APEX_Cache_Line* lines;   // sets * ways, the ways of a set adjacent
+  uint32_t clock;           // Accesses so far
+  uint32_t random_state;    // For random replacement
+} APEX_Cache;
+
+/* Data memory is addressed by word, from 0 to INT_MAX. Pages are
+ * allocated on the first non-zero store to them, through a two level
+ * page table, so resident memory follows the pages a program touches */
+#define APEX_PAGE_SHIFT   10
+#define APEX_PAGE_WORDS   (1 << APEX_PAGE_SHIFT)
+#define APEX_TABLE_SHIFT  10
+#define APEX_TABLE_PAGES  (1 << APEX_TABLE_SHIFT)
+#define APEX_PAGE_TABLES  (1 << (31 - APEX_PAGE_SHIFT - APEX_TABLE_SHIFT))
+
+typedef struct APEX_Shared_Memory APEX_Shared_Memory;
+
+typedef struct APEX_Data_Memory
+{
+  int** tables[APEX_PAGE_TABLES];   // APEX_TABLE_PAGES pages each, or NULL
+  uint32_t last_number;     // Page number accessed last, UINT32_MAX before any
+  int* last_page;           // and that page
+  int pages;                // Pages allocated
+  APEX_Shared_Memory* shared;  // Pages of several cores, which the tables
+                               // only point to, or NULL
+} APEX_Data_Memory;
+
+/* Core model APEX_cpu_run simulates */
+enum
+{
+  APEX_CORE_INORDER,  // The 7 stage pipeline of cpu.c
+  APEX_CORE_OOO,      // Rename, issue queue, LSQ and ROB, see ooo.c
+  APEX_CORE_NUM
+};
+
+extern const char* const core_names[APEX_CORE_NUM];
+
+/* How APEX_cpu_fast_forward executes instructions */
+enum
+{
+  APEX_ENGINE_INTERPRET,  // One instruction at a time, see functional.c
+  APEX_ENGINE_THREADED,   // Decoded blocks run as threaded code, see threaded.c
+  APEX_ENGINE_TRANSLATE,  // Blocks compiled to host code, see translate.c
+  APEX_ENGINE_NUM
+};
+
+extern const char* const engine_names[APEX_ENGINE_NUM];
+
+/* Structures of the out-of-order core, in the order rename claims them;
+ * the names are the keys of --ooo */
+enum
+{
+  APEX_OOO_ROB,     // Reorder buffer entries
+  APEX_OOO_IQ,      // Issue queue entries
+  APEX_OOO_LSQ,     // Load-store queue entries
+  APEX_OOO_REGS,    // Physical registers
+  APEX_OOO_NUM
+};
+
+extern const char* const ooo_names[APEX_OOO_NUM];
+
+#define APEX_OOO_MAX_ROB   256
+#define APEX_OOO_MAX_IQ    128
+#define APEX_OOO_MAX_LSQ   128
+#define APEX_OOO_MAX_REGS  512
+
+/* The 16 registers and the Z flag are renamed, so at least 18 physical
+ * registers are needed to rename anything */
+#define APEX_OOO_ARCH_REGS  17
+
+typedef struct APEX_OoO_Config
+{
+  int size[APEX_OOO_NUM];   // Entries of each APEX_OOO_* structure
+} APEX_OoO_Config;
+
+/* Pipeline variant */
+typedef struct APEX_Config
+{
+  unsigned bypass;    // One bit per enabled APEX_BYPASS_* path
+  int halt;           // APEX_HALT_*
+  int predictor;      // APEX_PREDICT_*
+  int btb_entries;    // Power of two up to APEX_BTB_MAX_ENTRIES, 0 for none
+  APEX_Cache_Config dcache;
+  int width;          // Instructions fetched, issued and retired per cycle
+  int units[APEX_UNIT_NUM];  // Issue limit per APEX_UNIT_* class and
+                             // cycle, 0 for the default of the width
+  int core;           // APEX_CORE_*
+  APEX_OoO_Config ooo;
+  int coherence;      // APEX_COHERENCE_* between the cores of a multicore run
+} APEX_Config;
+
+/* Features of a run that not every other feature or core allows, see
+ * APEX_config_check */
+#define APEX_RUN_SIMULATE      0x001  // Every stage printed on every cycle
+#define APEX_RUN_TRACE         0x002
+#define APEX_RUN_CHECKPOINT    0x004
+#define APEX_RUN_RESTORE       0x008
+#define APEX_RUN_FAST_FORWARD  0x010
+#define APEX_RUN_CHECK         0x020
+#define APEX_RUN_PROFILE       0x040
+#define APEX_RUN_CONFIGURED    0x080  // Pipeline options were given
+#define APEX_RUN_MULTICORE     0x100
+
+/* Where a simulated cycle went: to the instruction retiring in
+ * writeback, or to the reason no instruction retired */
+enum
+{
+  APEX_CPI_FETCH,   // Nothing fetched: pipeline fill or past the program
+  APEX_CPI_BASE,    // An instruction retired
+  APEX_CPI_RAW,     // Decode waited for a source register
+  APEX_CPI_WAW,     // Decode waited for an older write of rd
+  APEX_CPI_BRANCH,  // Wrong-path instruction squashed by a branch
+  APEX_CPI_DCACHE,  // Memory 1 waited for a data cache miss
+  APEX_CPI_HALT,    // Draining the pipeline behind HALT
+  APEX_CPI_NUM
+};
+
+extern const char* const cpi_names[APEX_CPI_NUM];
+
+/* Counters collected while the pipeline runs */
+typedef struct APEX_Stats
+{
+  long long retired;              // Instructions that reached writeback
+  long long cycles[APEX_CPI_NUM]; // Every cycle, by APEX_CPI_* cause
+  long long fast_forwarded;       // Instructions executed by APEX_cpu_fast_forward
+  long long bypass[APEX_BYPASS_NUM]; // Source operands read over each path
+  long long branches;             // BZ, BNZ and JUMP resolved in Execute 1
+  long long mispredicted;         // Those that squashed the wrong path
+  long long dcache_hits;
+  long long dcache_misses;
+  long long dcache_evictions;     // Valid lines replaced
+  long long dcache_writebacks;    // Dirty lines written back
+  long long dcache_write_throughs; // Stores sent straight to memory
+  long long dcache_upgrades;      // Stores to a shared line
+  long long dcache_coherence_misses; // Misses on a line another core took
+  long long dcache_invalidated;   // Lines other cores' stores invalidated
+  long long dcache_interventions; // Modified lines supplied to another core
+  long long bus_wait_cycles;      // Cycles queued for the interconnect
+  long long issued[APEX_MAX_WIDTH + 1]; // Cycles by instructions issued
+  long long ooo_occupancy[APEX_OOO_NUM]; // Entries in use, summed over cycles
+  long long ooo_full[APEX_OOO_NUM];  // Cycles rename stopped on a full one
+  long long ooo_squashed;         // Wrong-path instructions removed from the ROB
+  long long ooo_forwarded;        // Loads served by an older store in the LSQ
+} APEX_Stats;
+
+/* Binary pipeline trace, written by trace.c and read by apex_trace */
+#define APEX_TRACE_MAGIC    0x52545041  // "APTR"
+#define APEX_TRACE_VERSION  2
+
+/* Stage state bits in a trace record */
+#define APEX_TRACE_BUSY     0x01
+#define APEX_TRACE_STALLED  0x02
+
+/* Latches at the end of one cycle. On disk the header is five 32-bit
+ * words (magic, version, stages, width, code memory size) and each record
+ * is the clock followed by pc, opcode and state of every slot of every
+ * stage, all little endian
+ */
+typedef struct APEX_Trace_Record
+{
+  uint32_t clock;
+  struct
+  {
+    int32_t pc;
+    uint8_t opcode;   // One of OPCODE_*
+    uint8_t state;    // APEX_TRACE_* bits
+  } stage[NUM_STAGES][APEX_MAX_WIDTH];
+} APEX_Trace_Record;
+
+#define APEX_TRACE_RECORD_BYTES(width)  (4 + 6 * NUM_STAGES * (width))
+
+typedef struct APEX_Trace APEX_Trace;
+typedef struct APEX_OoO APEX_OoO;
+typedef struct APEX_Interconnect APEX_Interconnect;
+typedef struct APEX_Translation APEX_Translation;
+typedef struct APEX_Threaded APEX_Threaded;
+
+/* Model of APEX CPU */
+typedef struct APEX_CPU
+{
+  const char* simulate;
+
+  /* Bypass paths and HALT behaviour, see APEX_config_default */
+  APEX_Config config;
+
+  /* Output options, set from the simulate mode */
+  int enable_debug_messages;
+  int enable_display;
+
+  /* Receives everything the CPU prints, stdout and stderr if NULL */
+  APEX_Output output;
+  void* output_context;
+
+  /* Set once HALT reaches writeback */
+  int halt_flag;
+
+  /* The last APEX_cpu_run stopped at the cycle limit or, with HALT
+   * squashing, the end of the program */
+  int reached_end;
+
+  /* Checkpoint written at the end of this cycle, if a file is given */
+  const char* checkpoint_file;
+  int checkpoint_cycle;
+
+  /* Binary trace of every cycle, or NULL */
+  APEX_Trace* trace;
+
+  /* State of the out-of-order core between runs, or NULL */
+  APEX_OoO* ooo;
+
+  /* Bus to the other cores of a multicore run, or NULL */
+  APEX_Interconnect* interconnect;
+  int core_id;
+
+  /* Fast-forward engine, APEX_ENGINE_*, with its translated and decoded
+   * blocks or NULL */
+  int fast_forward_engine;
+  APEX_Translation* translation;
+  APEX_Threaded* threaded;
+
+  int clockcycles;
+
+  /* Clock cycles elasped */
+  int clock;
+
+  /* Current program counter */
+  int pc;
+
+  /* Integer register file */
+  int regs[16];
+  APEX_Scoreboard scoreboard;
+  APEX_Bypass bypass;
+  uint32_t issue_seq;   // seq of the newest issued instruction
+  APEX_Predictor predictor;
+  APEX_Cache dcache;
+  int dcache_wait;      // Cycles Memory 1 still holds its access
+
+  /* 7 CPU_stage latches of config.width slots. Instructions are held
+   * oldest first and unused slots are EMPTY; busy and stalled of slot 0
+   * stand for the whole latch */
+  CPU_Stage stage[NUM_STAGES][APEX_MAX_WIDTH];
+
+  /* Z flag */
+  int z_flag_set;
+
+  int nop_flag;
+
+  /* Code Memory where instructions are stored */
+  APEX_Instruction* code_memory;
+  APEX_Dependency* dependencies;  // Masks of each code memory entry
+  APEX_Branch_Stats* branch_stats;  // Outcomes of each code memory entry
+  APEX_Profile_Entry* profile;      // Counts of each, NULL unless profiling
+  int code_memory_size;
+  size_t code_image_length;   // Non zero when code memory is a mapped image
+
+  /* Data Memory */
+  APEX_Data_Memory data_memory;
+
+  /* Set when a load or store in Memory 1 accesses an address outside data
+   * memory. The pipeline stops once the older instructions retire */
+  int data_fault;
+  int fault_pc;
+  int fault_address;
+
+  /* Some stats */
+  int ins_completed;
+  APEX_Stats stats;
+
+} APEX_CPU;
+
+APEX_Instruction*
+create_code_memory(const char* filename, int* size);
+
+/* Room for the longest instruction APEX_format_instruction writes */
+#define APEX_INSTRUCTION_TEXT 64
+
+int
+APEX_format_instruction(char* buf, size_t size, const APEX_Instruction* ins);
+
+int
+is_code_image(const char* filename);
+
+int
+write_code_image(const char* filename, const APEX_Instruction* code_memory,
+                 int size);
+
+APEX_Instruction*
+map_code_image(const char* filename, int* size, size_t* length);
+
+void
+unmap_code_image(APEX_Instruction* code_memory, size_t length);
+
+void
+APEX_config_default(APEX_Config* config);
+
+int
+APEX_config_parse_bypass(APEX_Config* config, const char* list);
+
+int
+APEX_config_parse_units(APEX_Config* config, const char* list);
+
+int
+APEX_find_name(const char* const* names, int count, const char* value);
+
+int
+APEX_config_set(APEX_Config* config, const char* name, const char* value);
+
+const char*
+APEX_config_check(const APEX_Config* config, unsigned features);
+
+int
+APEX_unit_limit(const APEX_Config* config, int unit);
+
+int
+APEX_fetch_group(const APEX_CPU* cpu, int pc);
+
+int
+APEX_ooo_parse(APEX_OoO_Config* config, const char* list);
+
+int
+APEX_ooo_run(APEX_CPU* cpu);
+
+int
+APEX_cpu_configure(APEX_CPU* cpu, const APEX_Config* config);
+
+APEX_CPU*
+APEX_cpu_init(const char* filename,const char *simulate,const int clockcycles);
+
+int
+APEX_cpu_run(APEX_CPU* cpu);
+
+void
+APEX_cpu_display(APEX_CPU* cpu);
+
+void
+APEX_cpu_report(APEX_CPU* cpu);
+
+void
+APEX_cpu_print_fault(const APEX_CPU* cpu);
+
+void
+APEX_cpu_print_code(const APEX_CPU* cpu);
+
+void
+APEX_cpu_printf(const APEX_CPU* cpu, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void
+APEX_cpu_error(const APEX_CPU* cpu, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void
+APEX_cpu_stop(APEX_CPU* cpu);
+
+int
+get_code_index(int pc);
+
+void
+print_stage_content(APEX_CPU* cpu, char* name, CPU_Stage* stage);
+
+int
+APEX_cpu_save_checkpoint(const APEX_CPU* cpu, const char* filename);
+
+int
+APEX_cpu_load_checkpoint(APEX_CPU* cpu, const char* filename);
+
+long long
+APEX_cpu_fast_forward(APEX_CPU* cpu, int stop_pc, long long max_instructions);
+
+long long
+APEX_cpu_interpret(APEX_CPU* cpu, int stop_pc, long long max_instructions);
+
+long long
+APEX_cpu_translate(APEX_CPU* cpu, int stop_pc, long long max_instructions);
+
+void
+APEX_translation_free(APEX_Translation* translation);
+
+long long
+APEX_cpu_threaded(APEX_CPU* cpu, int stop_pc, long long max_instructions);
+
+void
+APEX_threaded_free(APEX_Threaded* threaded, int size);
+
+int
+APEX_cpu_check(APEX_CPU* cpu);
+
+void
+APEX_predictor_reset(APEX_Predictor* predictor);
+
+int
+APEX_predict_next_pc(APEX_CPU* cpu, const APEX_Instruction* ins, int pc);
+
+void
+APEX_predictor_update(APEX_CPU* cpu, int pc, int opcode, int taken, int target);
+
+void
+APEX_data_init(APEX_Data_Memory* memory);
+
+void
+APEX_data_free(APEX_Data_Memory* memory);
+
+const int*
+APEX_data_page(const APEX_Data_Memory* memory, uint32_t number);
+
+int*
+APEX_data_refill(APEX_Data_Memory* memory, uint32_t number, int allocate);
+
+int
+APEX_data_pages(const APEX_Data_Memory* memory);
+
+int
+APEX_data_compare(const APEX_Data_Memory* a, const APEX_Data_Memory* b);
+
+APEX_Shared_Memory*
+APEX_shared_memory_create(void);
+
+void
+APEX_shared_memory_free(APEX_Shared_Memory* shared);
+
+void
+APEX_data_share(APEX_Data_Memory* memory, APEX_Shared_Memory* shared);
+
+/*
+ * Reads the word at addr into value; words never stored read as zero.
+ * Returns -1 for an address outside data memory.
+ * Inline, as the functional interpreter calls it for every load.
+ */
+static inline int
+APEX_data_load(APEX_Data_Memory* memory, int addr, int* value)
+{
+  if (addr < 0)
+  {
+    return -1;
+  }
+  uint32_t number = (uint32_t)addr >> APEX_PAGE_SHIFT;
+  const int* page = memory->last_number == number
+                        ? memory->last_page
+                        : APEX_data_refill(memory, number, 0);
+  /* Relaxed atomic, as the cores of a multicore run share pages; it
+   * compiles to a plain load */
+  *value = page ? __atomic_load_n(&page[addr & (APEX_PAGE_WORDS - 1)],
+                                  __ATOMIC_RELAXED)
+                : 0;
+  return 0;
+}
+
+/*
+ * Writes value to the word at addr. Storing zero to a page that was never
+ * allocated leaves it unallocated.
+ * Returns -1 for an address outside data memory or when the page cannot
+ * be allocated.
+ */
+static inline int
+APEX_data_store(APEX_Data_Memory* memory, int addr, int value)
+{
+  if (addr < 0)
+  {
+    return -1;
+  }
+  uint32_t number = (uint32_t)addr >> APEX_PAGE_SHIFT;
+  int* page = memory->last_number == number
+                  ? memory->last_page
+                  : APEX_data_refill(memory, number, value != 0);
+  if (!page)
+  {
+    return value ? -1 : 0;
+  }
+  __atomic_store_n(&page[addr & (APEX_PAGE_WORDS - 1)], value,
+                   __ATOMIC_RELAXED);
+  return 0;
+}
+
+int
+APEX_dcache_parse(APEX_Cache_Config* config, const char* list);
+
+int
+APEX_dcache_valid(const APEX_Cache_Config* config);
+
+int
+APEX_dcache_init(APEX_Cache* cache, const APEX_Cache_Config* config);
+
+void
+APEX_dcache_free(APEX_Cache* cache);
+
+int
+APEX_dcache_access(APEX_CPU* cpu, int addr, int is_store);
+
+APEX_Interconnect*
+APEX_interconnect_create(APEX_CPU** cores, int num_cores);
+
+void
+APEX_interconnect_collect(APEX_Interconnect* interconnect);
+
+void
+APEX_interconnect_free(APEX_Interconnect* interconnect);
+
+void
+APEX_interconnect_print(const APEX_Interconnect* interconnect);
+
+int
+APEX_profile_enable(APEX_CPU* cpu);
+
+void
+APEX_profile_decode(APEX_CPU* cpu, int held);
+
+void
+APEX_profile_squash(APEX_CPU* cpu);
+
+void
+APEX_profile_print(APEX_CPU* cpu);
+
+APEX_Trace*
+APEX_trace_open(const char* filename, const APEX_CPU* cpu);
+
+void
+APEX_trace_cycle(APEX_Trace* trace, const APEX_CPU* cpu);
+
+int
+APEX_trace_close(APEX_Trace* trace);
+
+int
+APEX_run_batch(const char* manifest, int jobs, int json);
+
+int
+APEX_run_lockstep(const char* filename, const char* seeds, long long max,
+                  int json);
+
+int
+APEX_run_multicore(const char* const* filenames, int num_cores,
+                   const char* simulate, int clockcycles,
+                   const APEX_Config* config, int quantum);
+
+#endif
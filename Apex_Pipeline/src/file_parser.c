@@ -0,0 +1,321 @@
+/*
+ *  file_parser.c
+ *  Contains functions to parse input file and create
+ *  code memory, you can edit this file to add new instructions
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+/* True for a token holding nothing but white space */
+static int
+is_blank(const char *token)
+{
+  return token[strspn(token, " \t\r\n")] == '\0';
+}
+
+/*
+ * Reads an operand, the number following its 'R' or '#' prefix, into
+ * value. Returns -1 for another prefix, a number that is not decimal or
+ * does not fit an int, or characters other than white space after it.
+ */
+static int
+get_num_from_string(const char *buffer, char prefix, int *value)
+{
+  while (*buffer == ' ' || *buffer == '\t')
+  {
+    buffer++;
+  }
+  if (*buffer != prefix || !(isdigit((unsigned char)buffer[1]) ||
+                             buffer[1] == '-' || buffer[1] == '+'))
+  {
+    return -1;
+  }
+
+  char *end;
+  errno = 0;
+  long num = strtol(buffer + 1, &end, 10);
+  if (end == buffer + 1 || errno == ERANGE || num < INT_MIN ||
+      num > INT_MAX || !is_blank(end))
+  {
+    return -1;
+  }
+  *value = (int)num;
+  return 0;
+}
+
+/*
+ * APEX instruction set, indexed by opcode
+ *
+ * Note : you can edit this table to add new instructions
+ */
+const APEX_Opcode_Info opcode_info[NUM_OPCODES] = {
+  [OPCODE_NONE]  = { "",      FMT_NONE,        0, APEX_UNIT_NONE },
+  [OPCODE_STORE] = { "STORE", FMT_RS1_RS2_IMM, OPF_STORE | OPF_READS_RS1 | OPF_READS_RS2, APEX_UNIT_MEM },
+  [OPCODE_STR]   = { "STR",   FMT_RS1_RS2_RS3, OPF_STORE | OPF_READS_RS1 | OPF_READS_RS2 | OPF_READS_RS3, APEX_UNIT_MEM },
+  [OPCODE_LOAD]  = { "LOAD",  FMT_RD_RS1_IMM,  OPF_WRITES_RD | OPF_LOAD | OPF_READS_RS1, APEX_UNIT_MEM },
+  [OPCODE_LDR]   = { "LDR",   FMT_RD_RS1_RS2,  OPF_WRITES_RD | OPF_LOAD | OPF_READS_RS1 | OPF_READS_RS2, APEX_UNIT_MEM },
+  [OPCODE_MOVC]  = { "MOVC",  FMT_RD_IMM,      OPF_WRITES_RD, APEX_UNIT_ALU },
+  [OPCODE_ADD]   = { "ADD",   FMT_RD_RS1_RS2,  OPF_WRITES_RD | OPF_ARITH | OPF_SETS_Z | OPF_READS_RS1 | OPF_READS_RS2, APEX_UNIT_ALU },
+  [OPCODE_ADDL]  = { "ADDL",  FMT_RD_RS1_IMM,  OPF_WRITES_RD | OPF_ARITH | OPF_SETS_Z | OPF_READS_RS1, APEX_UNIT_ALU },
+  [OPCODE_SUB]   = { "SUB",   FMT_RD_RS1_RS2,  OPF_WRITES_RD | OPF_ARITH | OPF_SETS_Z | OPF_READS_RS1 | OPF_READS_RS2, APEX_UNIT_ALU },
+  [OPCODE_SUBL]  = { "SUBL",  FMT_RD_RS1_IMM,  OPF_WRITES_RD | OPF_ARITH | OPF_SETS_Z | OPF_READS_RS1, APEX_UNIT_ALU },
+  [OPCODE_MUL]   = { "MUL",   FMT_RD_RS1_RS2,  OPF_WRITES_RD | OPF_ARITH | OPF_SETS_Z | OPF_READS_RS1 | OPF_READS_RS2, APEX_UNIT_MUL },
+  [OPCODE_AND]   = { "AND",   FMT_RD_RS1_RS2,  OPF_WRITES_RD | OPF_READS_RS1 | OPF_READS_RS2, APEX_UNIT_ALU },
+  [OPCODE_OR]    = { "OR",    FMT_RD_RS1_RS2,  OPF_WRITES_RD | OPF_READS_RS1 | OPF_READS_RS2, APEX_UNIT_ALU },
+  [OPCODE_EXOR]  = { "EX-OR", FMT_RD_RS1_RS2,  OPF_WRITES_RD | OPF_READS_RS1 | OPF_READS_RS2, APEX_UNIT_ALU },
+  [OPCODE_BZ]    = { "BZ",    FMT_IMM,         OPF_CONTROL, APEX_UNIT_BRANCH },
+  [OPCODE_BNZ]   = { "BNZ",   FMT_IMM,         OPF_CONTROL, APEX_UNIT_BRANCH },
+  [OPCODE_JUMP]  = { "JUMP",  FMT_RS1,         OPF_CONTROL | OPF_READS_RS1, APEX_UNIT_BRANCH },
+  [OPCODE_HALT]  = { "HALT",  FMT_NONE,        0, APEX_UNIT_NONE },
+  [OPCODE_EMPTY] = { "EMPTY", FMT_NONE,        0, APEX_UNIT_NONE },
+};
+
+/*
+ * Maps a mnemonic to its opcode, OPCODE_NONE if it is unknown
+ */
+static int
+get_opcode_from_string(const char *mnemonic)
+{
+  size_t len = strcspn(mnemonic, " \t\r\n");
+  for (int op = OPCODE_NONE + 1; op < OPCODE_EMPTY; ++op)
+  {
+    if (strlen(opcode_info[op].name) == len &&
+        strncmp(opcode_info[op].name, mnemonic, len) == 0)
+    {
+      return op;
+    }
+  }
+  return OPCODE_NONE;
+}
+
+/* Number of operands following the mnemonic, indexed by FMT_* */
+static const int format_operands[] = {
+  [FMT_NONE]        = 0,
+  [FMT_RD_IMM]      = 2,
+  [FMT_RD_RS1_RS2]  = 3,
+  [FMT_RD_RS1_IMM]  = 3,
+  [FMT_RS1_RS2_IMM] = 3,
+  [FMT_RS1_RS2_RS3] = 3,
+  [FMT_RS1]         = 1,
+  [FMT_IMM]         = 1,
+};
+
+/*
+ * This function is related to parsing input file. The line is split on
+ * commas in place. Returns 0 on success, -1 if the mnemonic is unknown,
+ * an operand is missing, extra or malformed or a register address is out
+ * of range.
+ *
+ * Note : you can edit this function to add new instructions
+ */
+static int
+create_APEX_instruction(APEX_Instruction *ins, char *buffer)
+{
+  char *tokens[6];
+  int token_num = 0;
+  char *token = buffer;
+  while (token && token_num < 6)
+  {
+    tokens[token_num++] = token;
+    token = strchr(token, ',');
+    if (token)
+    {
+      *token++ = '\0';
+    }
+  }
+
+  memset(ins, 0, sizeof(*ins));
+  ins->opcode = get_opcode_from_string(tokens[0]);
+
+  /* Blank lines load as empty instructions. Anything but white space
+   * after the mnemonic, or in place of an unknown one, is an error, and
+   * a trailing comma as in "HALT," ends the line without an operand */
+  if (!is_blank(tokens[0] + strlen(opcode_info[ins->opcode].name)))
+  {
+    return -1;
+  }
+  if (token_num > 1 && is_blank(tokens[token_num - 1]))
+  {
+    token_num--;
+  }
+
+  /* JUMP may be given an offset, no instruction takes more operands */
+  int format = opcode_info[ins->opcode].format;
+  int operands = token_num - 1;
+  if (operands < format_operands[format] ||
+      operands > format_operands[format] + (format == FMT_RS1))
+  {
+    return -1;
+  }
+
+  int rd = 0, rs1 = 0, rs2 = 0, rs3 = 0, imm = 0;
+  int bad = 0;
+  switch (format)
+  {
+    case FMT_RS1_RS2_IMM:
+      bad |= get_num_from_string(tokens[1], 'R', &rs1);
+      bad |= get_num_from_string(tokens[2], 'R', &rs2);
+      bad |= get_num_from_string(tokens[3], '#', &imm);
+      break;
+
+    case FMT_RS1_RS2_RS3:
+      bad |= get_num_from_string(tokens[1], 'R', &rs1);
+      bad |= get_num_from_string(tokens[2], 'R', &rs2);
+      bad |= get_num_from_string(tokens[3], 'R', &rs3);
+      break;
+
+    case FMT_RD_IMM:
+      bad |= get_num_from_string(tokens[1], 'R', &rd);
+      bad |= get_num_from_string(tokens[2], '#', &imm);
+      break;
+
+    case FMT_RD_RS1_RS2:
+      bad |= get_num_from_string(tokens[1], 'R', &rd);
+      bad |= get_num_from_string(tokens[2], 'R', &rs1);
+      bad |= get_num_from_string(tokens[3], 'R', &rs2);
+      break;
+
+    case FMT_RD_RS1_IMM:
+      bad |= get_num_from_string(tokens[1], 'R', &rd);
+      bad |= get_num_from_string(tokens[2], 'R', &rs1);
+      bad |= get_num_from_string(tokens[3], '#', &imm);
+      break;
+
+    case FMT_IMM:
+      bad |= get_num_from_string(tokens[1], '#', &imm);
+      break;
+
+    case FMT_RS1:
+      /* JUMP,Rs1[,#imm] jumps to Rs1 + imm */
+      bad |= get_num_from_string(tokens[1], 'R', &rs1);
+      if (token_num > 2)
+      {
+        bad |= get_num_from_string(tokens[2], '#', &imm);
+      }
+      break;
+
+    case FMT_NONE:
+      break;
+  }
+
+  if (bad || rd < 0 || rd >= 16 || rs1 < 0 || rs1 >= 16 ||
+      rs2 < 0 || rs2 >= 16 || rs3 < 0 || rs3 >= 16)
+  {
+    return -1;
+  }
+  ins->rd = rd;
+  ins->rs1 = rs1;
+  ins->rs2 = rs2;
+  ins->rs3 = rs3;
+  ins->imm = imm;
+  return 0;
+}
+
+/*
+ * Writes the instruction as it is written in an input file into buf,
+ * truncated to size bytes. Returns the length of the whole text, as
+ * snprintf does.
+ */
+int
+APEX_format_instruction(char *buf, size_t size, const APEX_Instruction *ins)
+{
+  const char *name = opcode_info[ins->opcode].name;
+  switch (opcode_info[ins->opcode].format)
+  {
+    case FMT_RS1_RS2_IMM:
+      return snprintf(buf, size, "%s,R%d,R%d,#%d", name, ins->rs1, ins->rs2, ins->imm);
+
+    case FMT_RD_RS1_IMM:
+      return snprintf(buf, size, "%s,R%d,R%d,#%d", name, ins->rd, ins->rs1, ins->imm);
+
+    case FMT_RS1_RS2_RS3:
+      return snprintf(buf, size, "%s,R%d,R%d,R%d", name, ins->rs1, ins->rs2, ins->rs3);
+
+    case FMT_RD_RS1_RS2:
+      return snprintf(buf, size, "%s,R%d,R%d,R%d", name, ins->rd, ins->rs1, ins->rs2);
+
+    case FMT_RD_IMM:
+      return snprintf(buf, size, "%s,R%d,#%d", name, ins->rd, ins->imm);
+
+    case FMT_IMM:
+      return snprintf(buf, size, "%s,#%d", name, ins->imm);
+
+    case FMT_RS1:
+      return snprintf(buf, size, "%s,R%d,#%d", name, ins->rs1, ins->imm);
+  }
+  return snprintf(buf, size, "%s", name);
+}
+
+/*
+ * Parses the input file in a single pass into a growing code memory, so
+ * the input can also be a pipe. A filename of "-" reads standard input.
+ */
+APEX_Instruction *
+create_code_memory(const char *filename, int *size)
+{
+  if (!filename)
+  {
+    return NULL;
+  }
+
+  FILE *fp = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
+  if (!fp)
+  {
+    return NULL;
+  }
+
+  char *line = NULL;
+  size_t len = 0;
+  int capacity = 0;
+  int code_memory_size = 0;
+  APEX_Instruction *code_memory = NULL;
+
+  while (getline(&line, &len, fp) != -1)
+  {
+    if (code_memory_size == capacity)
+    {
+      capacity = capacity ? capacity * 2 : 1024;
+      APEX_Instruction *grown =
+          realloc(code_memory, sizeof(*code_memory) * capacity);
+      if (!grown)
+      {
+        code_memory_size = 0;
+        break;
+      }
+      code_memory = grown;
+    }
+
+    if (create_APEX_instruction(&code_memory[code_memory_size], line) != 0)
+    {
+      fprintf(stderr, "APEX_Error : %s:%d: invalid instruction\n",
+              filename, code_memory_size + 1);
+      code_memory_size = 0;
+      break;
+    }
+    code_memory_size++;
+  }
+
+  free(line);
+  if (fp != stdin)
+  {
+    fclose(fp);
+  }
+
+  *size = code_memory_size;
+  if (!code_memory_size)
+  {
+    free(code_memory);
+    return NULL;
+  }
+  return code_memory;
+}
@@ -0,0 +1,257 @@
+/*
+ *  functional.c
+ *  Contains a functional APEX interpreter used to fast-forward a program
+ *  to a region of interest before cycle accurate simulation, and the
+ *  choice between it and the translator of translate.c
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+const char* const engine_names[APEX_ENGINE_NUM] = {
+  [APEX_ENGINE_INTERPRET] = "interpret",
+  [APEX_ENGINE_THREADED]  = "threaded",
+  [APEX_ENGINE_TRANSLATE] = "translate",
+};
+
+/*
+ * Executes instructions one at a time without the pipeline, starting at
+ * cpu->pc. Stops before the instruction at stop_pc, before HALT, after
+ * max_instructions, when the pc leaves code memory or before a load or
+ * store that would fault, which the pipeline then reports. Registers, data
+ * memory, pc and the Z flag are left in the CPU, so APEX_cpu_run can
+ * continue from there with an empty pipeline.
+ *
+ * Note : Instructions follow the semantics of the pipeline in cpu.c, so
+ *        the final state does not depend on where the switch-over happens
+ *
+ * Returns the number of instructions executed.
+ */
+long long
+APEX_cpu_interpret(APEX_CPU* cpu, int stop_pc, long long max_instructions)
+{
+  /* Work on local copies so the compiler need not assume stores to data
+   * memory alias the register file */
+  int regs[16];
+  memcpy(regs, cpu->regs, sizeof(regs));
+  APEX_Data_Memory* data_memory = &cpu->data_memory;
+  const APEX_Instruction* code_memory = cpu->code_memory;
+  unsigned int size = cpu->code_memory_size;
+  int pc = cpu->pc;
+  int z = cpu->z_flag_set;
+  long long executed = 0;
+
+  while (executed < max_instructions && pc != stop_pc)
+  {
+    unsigned int index = (unsigned int)(pc - 4000) >> 2;
+    if (pc < 4000 || index >= size)
+    {
+      break;
+    }
+
+    const APEX_Instruction* ins = &code_memory[index];
+    int next_pc = pc + 4;
+    int addr;
+
+    switch (ins->opcode)
+    {
+      case OPCODE_STORE:
+        addr = APEX_add(regs[ins->rs2], ins->imm);
+        if (APEX_data_store(data_memory, addr, regs[ins->rs1]))
+        {
+          goto done;
+        }
+        break;
+
+      case OPCODE_STR:
+        addr = APEX_add(regs[ins->rs2], regs[ins->rs3]);
+        if (APEX_data_store(data_memory, addr, regs[ins->rs1]))
+        {
+          goto done;
+        }
+        break;
+
+      case OPCODE_LOAD:
+        addr = APEX_add(regs[ins->rs1], ins->imm);
+        if (APEX_data_load(data_memory, addr, &regs[ins->rd]))
+        {
+          goto done;
+        }
+        break;
+
+      case OPCODE_LDR:
+        addr = APEX_add(regs[ins->rs1], regs[ins->rs2]);
+        if (APEX_data_load(data_memory, addr, &regs[ins->rd]))
+        {
+          goto done;
+        }
+        break;
+
+      case OPCODE_MOVC:
+        regs[ins->rd] = ins->imm;
+        break;
+
+      case OPCODE_ADD:
+        regs[ins->rd] = APEX_add(regs[ins->rs1], regs[ins->rs2]);
+        z = (regs[ins->rd] == 0);
+        break;
+
+      case OPCODE_ADDL:
+        regs[ins->rd] = APEX_add(regs[ins->rs1], ins->imm);
+        z = (regs[ins->rd] == 0);
+        break;
+
+      case OPCODE_SUB:
+        regs[ins->rd] = APEX_sub(regs[ins->rs1], regs[ins->rs2]);
+        z = (regs[ins->rd] == 0);
+        break;
+
+      case OPCODE_SUBL:
+        regs[ins->rd] = APEX_sub(regs[ins->rs1], ins->imm);
+        z = (regs[ins->rd] == 0);
+        break;
+
+      case OPCODE_MUL:
+        regs[ins->rd] = APEX_mul(regs[ins->rs1], regs[ins->rs2]);
+        z = (regs[ins->rd] == 0);
+        break;
+
+      case OPCODE_AND:
+        regs[ins->rd] = regs[ins->rs1] & regs[ins->rs2];
+        break;
+
+      case OPCODE_OR:
+        regs[ins->rd] = regs[ins->rs1] | regs[ins->rs2];
+        break;
+
+      case OPCODE_EXOR:
+        regs[ins->rd] = regs[ins->rs1] ^ regs[ins->rs2];
+        break;
+
+      /* Z is that of the last arithmetic instruction, as in the
+       * pipeline; the branch predictor is not trained here
+       */
+      case OPCODE_BZ:
+        if (z)
+        {
+          next_pc = APEX_add(pc, ins->imm);
+        }
+        break;
+
+      case OPCODE_BNZ:
+        if (!z)
+        {
+          next_pc = APEX_add(pc, ins->imm);
+        }
+        break;
+
+      case OPCODE_JUMP:
+        next_pc = APEX_add(regs[ins->rs1], ins->imm);
+        break;
+
+      case OPCODE_HALT:
+        /* Leave HALT for the pipeline so the run ends normally */
+        goto done;
+
+      default:
+        break;
+    }
+
+    pc = next_pc;
+    executed++;
+  }
+
+done:
+  memcpy(cpu->regs, regs, sizeof(regs));
+  cpu->pc = pc;
+  cpu->z_flag_set = z;
+  return executed;
+}
+
+/*
+ * Fast-forwards like APEX_cpu_interpret with the engine of the CPU, and
+ * counts the instructions as completed. An engine the host lacks falls
+ * back to the next simpler one: translated, threaded, interpreted.
+ * Returns the number of instructions executed.
+ */
+long long
+APEX_cpu_fast_forward(APEX_CPU* cpu, int stop_pc, long long max_instructions)
+{
+  long long executed = -1;
+  if (cpu->fast_forward_engine == APEX_ENGINE_TRANSLATE)
+  {
+    executed = APEX_cpu_translate(cpu, stop_pc, max_instructions);
+  }
+  if (executed < 0 && cpu->fast_forward_engine != APEX_ENGINE_INTERPRET)
+  {
+    executed = APEX_cpu_threaded(cpu, stop_pc, max_instructions);
+  }
+  if (executed < 0)
+  {
+    executed = APEX_cpu_interpret(cpu, stop_pc, max_instructions);
+  }
+  cpu->ins_completed += executed;
+  cpu->stats.fast_forwarded += executed;
+  return executed;
+}
+
+/*
+ * Checks the registers and data memory a finished run left against the
+ * functional model: the same program run from the start with the
+ * threaded engine up to HALT, a fault or the end of code memory. Prints
+ * the result, with the first difference found.
+ * Returns 0 when they agree, 1 when they differ, -1 if out of memory.
+ */
+int
+APEX_cpu_check(APEX_CPU* cpu)
+{
+  APEX_CPU* model = calloc(1, sizeof(*model));
+  if (!model)
+  {
+    return -1;
+  }
+  model->code_memory = cpu->code_memory;
+  model->code_memory_size = cpu->code_memory_size;
+  model->pc = 4000;
+  model->fast_forward_engine = APEX_ENGINE_THREADED;
+  APEX_data_init(&model->data_memory);
+  APEX_cpu_fast_forward(model, -1, LLONG_MAX);
+
+  int status = 0;
+  for (int i = 0; i < 16 && !status; ++i)
+  {
+    if (cpu->regs[i] != model->regs[i])
+    {
+      APEX_cpu_error(cpu, "APEX_Check : R%d is %d, the functional model has %d\n",
+                     i, cpu->regs[i], model->regs[i]);
+      status = 1;
+    }
+  }
+  int addr = status ? -1 : APEX_data_compare(&cpu->data_memory,
+                                             &model->data_memory);
+  if (addr >= 0)
+  {
+    int value, expected;
+    APEX_data_load(&cpu->data_memory, addr, &value);
+    APEX_data_load(&model->data_memory, addr, &expected);
+    APEX_cpu_error(cpu, "APEX_Check : MEM[%d] is %d, the functional model has %d\n",
+                   addr, value, expected);
+    status = 1;
+  }
+  if (!status)
+  {
+    APEX_cpu_error(cpu, "APEX_Check : Registers and data memory match the functional model\n");
+  }
+
+  APEX_threaded_free(model->threaded, model->code_memory_size);
+  APEX_data_free(&model->data_memory);
+  free(model);
+  return status;
+}
@@ -0,0 +1,153 @@
+/*
+ *  image.c
+ *  Contains functions to write pre-assembled program images and to
+ *  map them directly into code memory
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cpu.h"
+
+/*
+ * Returns 1 if the file starts with an APEX image header. Only regular
+ * files are inspected, so that pipes are left for the text parser.
+ */
+int
+is_code_image(const char *filename)
+{
+  APEX_Image_Header header;
+  struct stat st;
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+  {
+    return 0;
+  }
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+  {
+    close(fd);
+    return 0;
+  }
+
+  ssize_t nread = read(fd, &header, sizeof(header));
+  close(fd);
+  return nread == sizeof(header) && header.magic == APEX_IMAGE_MAGIC;
+}
+
+/*
+ * Writes code memory to a binary image: a header followed by the
+ * instructions exactly as they are laid out in memory
+ */
+int
+write_code_image(const char *filename, const APEX_Instruction *code_memory,
+                 int size)
+{
+  FILE *fp = fopen(filename, "wb");
+  if (!fp)
+  {
+    return -1;
+  }
+
+  APEX_Image_Header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = APEX_IMAGE_MAGIC;
+  header.version = APEX_IMAGE_VERSION;
+  header.instruction_size = sizeof(APEX_Instruction);
+  header.count = size;
+
+  /* Clear padding bytes so images are reproducible */
+  APEX_Instruction ins;
+  int ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+  for (int i = 0; ok && i < size; ++i)
+  {
+    memset(&ins, 0, sizeof(ins));
+    ins.opcode = code_memory[i].opcode;
+    ins.rd = code_memory[i].rd;
+    ins.rs1 = code_memory[i].rs1;
+    ins.rs2 = code_memory[i].rs2;
+    ins.rs3 = code_memory[i].rs3;
+    ins.imm = code_memory[i].imm;
+    ok = fwrite(&ins, sizeof(ins), 1, fp) == 1;
+  }
+
+  if (fclose(fp) != 0 || !ok)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Maps a binary image read-only and returns its instructions as code
+ * memory. The length of the mapping is returned so it can be unmapped.
+ */
+APEX_Instruction *
+map_code_image(const char *filename, int *size, size_t *length)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+  {
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(APEX_Image_Header))
+  {
+    close(fd);
+    return NULL;
+  }
+
+  void *image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED)
+  {
+    return NULL;
+  }
+
+  const APEX_Image_Header *header = image;
+  APEX_Instruction *code_memory =
+      (APEX_Instruction *)((char *)image + sizeof(*header));
+  size_t available = (st.st_size - sizeof(*header)) / sizeof(APEX_Instruction);
+
+  if (header->magic != APEX_IMAGE_MAGIC ||
+      header->version != APEX_IMAGE_VERSION ||
+      header->instruction_size != sizeof(APEX_Instruction) ||
+      header->count == 0 || header->count > available)
+  {
+    munmap(image, st.st_size);
+    return NULL;
+  }
+
+  /* Reject instructions the pipeline cannot index safely */
+  for (uint32_t i = 0; i < header->count; ++i)
+  {
+    const APEX_Instruction *ins = &code_memory[i];
+    if (ins->opcode >= NUM_OPCODES || ins->rd >= 16 || ins->rs1 >= 16 ||
+        ins->rs2 >= 16 || ins->rs3 >= 16)
+    {
+      munmap(image, st.st_size);
+      return NULL;
+    }
+  }
+
+  *size = header->count;
+  *length = st.st_size;
+  return code_memory;
+}
+
+/*
+ * Releases code memory obtained from map_code_image
+ */
+void
+unmap_code_image(APEX_Instruction *code_memory, size_t length)
+{
+  munmap((char *)code_memory - sizeof(APEX_Image_Header), length);
+}
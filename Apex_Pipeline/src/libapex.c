@@ -0,0 +1,287 @@
+/*
+ *  libapex.c
+ *  Implements the libapex interface of apex.h over APEX_CPU: a handle
+ *  holds the options until a program is loaded, then the CPU, which
+ *  runs a slice of cycles per call and prints through the callback
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+struct APEX_Sim
+{
+  APEX_CPU* cpu;            // NULL until a program is loaded
+  APEX_Config config;
+  int debug_messages;       // From the mode
+  int display;
+  int engine;
+  int profile;
+  int failed;               // APEX_cpu_run could not allocate its core
+  APEX_Output output;
+  void* output_context;
+};
+
+APEX_Sim*
+APEX_sim_create(void)
+{
+  APEX_Sim* sim = calloc(1, sizeof(*sim));
+  if (sim)
+  {
+    APEX_config_default(&sim->config);
+    sim->engine = APEX_ENGINE_TRANSLATE;
+  }
+  return sim;
+}
+
+void
+APEX_sim_set_output(APEX_Sim* sim, APEX_Output output, void* context)
+{
+  sim->output = output;
+  sim->output_context = context;
+  if (sim->cpu)
+  {
+    sim->cpu->output = output;
+    sim->cpu->output_context = context;
+  }
+}
+
+int
+APEX_sim_set_option(APEX_Sim* sim, const char* name, const char* value)
+{
+  int index;
+  if (sim->cpu)
+  {
+    return -1;
+  }
+
+  if (strcmp(name, "mode") == 0)
+  {
+    if (strcmp(value, "simulate") == 0)
+    {
+      sim->debug_messages = 1;
+      sim->display = 1;
+    }
+    else if (strcmp(value, "display") == 0 || strcmp(value, "quiet") == 0)
+    {
+      sim->debug_messages = 0;
+      sim->display = value[0] == 'd';
+    }
+    else
+    {
+      return -1;
+    }
+    return 0;
+  }
+  if (strcmp(name, "profile") == 0)
+  {
+    if (strcmp(value, "on") != 0 && strcmp(value, "off") != 0)
+    {
+      return -1;
+    }
+    sim->profile = value[1] == 'n';
+    return 0;
+  }
+  if (strcmp(name, "fast-forward-engine") == 0)
+  {
+    index = APEX_find_name(engine_names, APEX_ENGINE_NUM, value);
+    sim->engine = index >= 0 ? index : sim->engine;
+    return index >= 0 ? 0 : -1;
+  }
+  return APEX_config_set(&sim->config, name, value) == 0 ? 0 : -1;
+}
+
+int
+APEX_sim_load(APEX_Sim* sim, const char* filename)
+{
+  if (sim->cpu)
+  {
+    return -1;
+  }
+  APEX_CPU* cpu = APEX_cpu_init(filename, "quiet", -1);
+  if (!cpu)
+  {
+    return -1;
+  }
+  cpu->output = sim->output;
+  cpu->output_context = sim->output_context;
+  if (APEX_cpu_configure(cpu, &sim->config) != 0)
+  {
+    APEX_cpu_error(cpu, "APEX_Error : Unable to allocate the data cache\n");
+    APEX_cpu_stop(cpu);
+    return -1;
+  }
+  const char* conflict = APEX_config_check(
+      &sim->config, sim->profile ? APEX_RUN_PROFILE : 0);
+  if (conflict)
+  {
+    APEX_cpu_error(cpu, "APEX_Error : %s\n", conflict);
+    APEX_cpu_stop(cpu);
+    return -1;
+  }
+  if (sim->profile && APEX_profile_enable(cpu) != 0)
+  {
+    APEX_cpu_error(cpu, "APEX_Error : Out of memory for the profile\n");
+    APEX_cpu_stop(cpu);
+    return -1;
+  }
+  cpu->enable_debug_messages = sim->debug_messages;
+  cpu->enable_display = sim->display;
+  cpu->fast_forward_engine = sim->engine;
+  if (cpu->enable_debug_messages)
+  {
+    APEX_cpu_print_code(cpu);
+  }
+  sim->cpu = cpu;
+  return 0;
+}
+
+long long
+APEX_sim_fast_forward(APEX_Sim* sim, long long instructions)
+{
+  if (!sim->cpu || sim->cpu->clock || instructions < 0)
+  {
+    return -1;
+  }
+  return APEX_cpu_fast_forward(sim->cpu, -1, instructions);
+}
+
+static int
+sim_status(const APEX_Sim* sim)
+{
+  const APEX_CPU* cpu = sim->cpu;
+  if (!cpu)
+  {
+    return APEX_SIM_EMPTY;
+  }
+  if (sim->failed)
+  {
+    return APEX_SIM_ERROR;
+  }
+  if (cpu->data_fault)
+  {
+    return APEX_SIM_FAULT;
+  }
+  if (cpu->halt_flag)
+  {
+    return APEX_SIM_HALTED;
+  }
+  return cpu->reached_end && cpu->clock != cpu->clockcycles
+             ? APEX_SIM_COMPLETED : APEX_SIM_READY;
+}
+
+/* Runs up to cycle limit, or to the end if it is negative */
+static int
+run_to(APEX_Sim* sim, int limit)
+{
+  int status = sim_status(sim);
+  if (status != APEX_SIM_READY)
+  {
+    return status;
+  }
+  APEX_CPU* cpu = sim->cpu;
+  cpu->clockcycles = limit;
+  if (APEX_cpu_run(cpu) != 0 && !cpu->data_fault)
+  {
+    sim->failed = 1;
+  }
+  return sim_status(sim);
+}
+
+int
+APEX_sim_step(APEX_Sim* sim, int cycles)
+{
+  if (!sim->cpu || cycles <= 0)
+  {
+    return sim_status(sim);
+  }
+  int clock = sim->cpu->clock;
+  return run_to(sim, cycles < INT_MAX - clock ? clock + cycles : INT_MAX);
+}
+
+int
+APEX_sim_run_until(APEX_Sim* sim, APEX_Until until, void* context,
+                   int max_cycles)
+{
+  if (!until)
+  {
+    return max_cycles < 0 ? run_to(sim, -1) : APEX_sim_step(sim, max_cycles);
+  }
+  int status = sim_status(sim);
+  for (int n = 0; status == APEX_SIM_READY && (max_cycles < 0 || n < max_cycles);
+       ++n)
+  {
+    if (until(context, sim))
+    {
+      break;
+    }
+    status = APEX_sim_step(sim, 1);
+  }
+  return status;
+}
+
+int
+APEX_sim_stats(const APEX_Sim* sim, APEX_Sim_Stats* stats)
+{
+  memset(stats, 0, sizeof(*stats));
+  stats->status = sim_status(sim);
+  const APEX_CPU* cpu = sim->cpu;
+  if (cpu)
+  {
+    stats->pc = cpu->pc;
+    stats->cycles = cpu->clock;
+    stats->retired = cpu->stats.retired;
+    stats->fast_forwarded = cpu->stats.fast_forwarded;
+    stats->branches = cpu->stats.branches;
+    stats->mispredicted = cpu->stats.mispredicted;
+    stats->dcache_hits = cpu->stats.dcache_hits;
+    stats->dcache_misses = cpu->stats.dcache_misses;
+  }
+  return stats->status;
+}
+
+int
+APEX_sim_register(const APEX_Sim* sim, int reg)
+{
+  return sim->cpu && reg >= 0 && reg < 16 ? sim->cpu->regs[reg] : 0;
+}
+
+int
+APEX_sim_memory(const APEX_Sim* sim, int address)
+{
+  if (!sim->cpu || address < 0)
+  {
+    return 0;
+  }
+  const int* page = APEX_data_page(&sim->cpu->data_memory,
+                                   (uint32_t)address >> APEX_PAGE_SHIFT);
+  return page ? page[address & (APEX_PAGE_WORDS - 1)] : 0;
+}
+
+void
+APEX_sim_display(APEX_Sim* sim)
+{
+  if (sim->cpu)
+  {
+    APEX_cpu_display(sim->cpu);
+    APEX_profile_print(sim->cpu);
+  }
+}
+
+void
+APEX_sim_destroy(APEX_Sim* sim)
+{
+  if (sim)
+  {
+    if (sim->cpu)
+    {
+      APEX_cpu_stop(sim->cpu);
+    }
+    free(sim);
+  }
+}
@@ -0,0 +1,558 @@
+/*
+ *  lockstep.c
+ *  Runs one program functionally for many instances at once, each with
+ *  its own seeded registers and data memory, for Monte Carlo studies.
+ *  Instances at the same pc are packed into the lanes of a group that
+ *  keeps its registers as one vector per register, so every ALU
+ *  instruction is a single vector operation across the group
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+/* Lanes of a group: one AVX-512 register of 32-bit words, or two AVX2 */
+#define LANES 16
+
+typedef uint32_t Lanes __attribute__((vector_size(4 * LANES)));
+
+/* Instances a group is formed from, so lanes that part can be refilled
+ * from the others */
+#define LOCKSTEP_WINDOW  (4 * LANES)
+
+/* The vector step is compiled for AVX-512 and AVX2 too and picked by the
+ * host at load time; elsewhere GCC splits the vectors as it can */
+#if defined(__x86_64__) && defined(__GNUC__) && defined(__linux__)
+#define LANE_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define LANE_CLONES
+#endif
+
+enum
+{
+  LANE_RUNNING,
+  LANE_HALTED,      // Stopped before HALT
+  LANE_COMPLETED,   // Left code memory
+  LANE_FAULT,       // Stopped before a load or store outside data memory
+  LANE_LIMIT,       // Executed the most instructions allowed
+};
+
+static const char* const lane_status[] = {
+  [LANE_RUNNING]   = "running",
+  [LANE_HALTED]    = "halted",
+  [LANE_COMPLETED] = "completed",
+  [LANE_FAULT]     = "fault",
+  [LANE_LIMIT]     = "limit",
+};
+
+/* One run of the program; its registers are only current while it is
+ * not in a group */
+typedef struct Instance
+{
+  int regs[16];
+  int z;
+  int pc;
+  int status;
+  int grouped;          // In the running group
+  long long executed;
+  APEX_Data_Memory memory;
+} Instance;
+
+/* Instances at one pc, lane l holding register r in regs[r][l] */
+typedef struct Group
+{
+  int pc;
+  int count;
+  Instance* lane[LANES];
+  Lanes regs[16];
+  Lanes z;          // All ones where Z is set
+  int next_pc[LANES];
+} Group;
+
+static void
+gather(Group* g, Instance** instances, int count)
+{
+  g->pc = instances[0]->pc;
+  g->count = count;
+  for (int l = 0; l < count; ++l)
+  {
+    Instance* instance = instances[l];
+    g->lane[l] = instance;
+    for (int r = 0; r < 16; ++r)
+    {
+      g->regs[r][l] = instance->regs[r];
+    }
+    g->z[l] = instance->z ? UINT32_MAX : 0;
+  }
+}
+
+static void
+scatter(const Group* g)
+{
+  for (int l = 0; l < g->count; ++l)
+  {
+    Instance* instance = g->lane[l];
+    for (int r = 0; r < 16; ++r)
+    {
+      instance->regs[r] = (int)g->regs[r][l];
+    }
+    instance->z = g->z[l] != 0;
+  }
+}
+
+/*
+ * Runs the group from its pc up to and including the next BZ, BNZ or
+ * JUMP, or until HALT, the end of code memory, a fault or the lane with
+ * the most instructions reaching max. Lanes that stop get their status,
+ * pc and count; the others' next pc is left in next_pc and the number
+ * of instructions they ran is returned.
+ */
+LANE_CLONES static long long
+step(Group* g, const APEX_Instruction* code, int size, long long max)
+{
+  long long most = 0;
+  for (int l = 0; l < g->count; ++l)
+  {
+    if (g->lane[l]->executed > most)
+    {
+      most = g->lane[l]->executed;
+    }
+  }
+  long long room = max - most;
+  Lanes* r = g->regs;
+  int pc = g->pc;
+  long long n = 0;
+  int stop = 0;
+
+  int branched = 0;
+
+  while (!stop && n < room)
+  {
+    unsigned int index = (unsigned int)(pc - 4000) >> 2;
+    if (pc < 4000 || index >= (unsigned int)size ||
+        code[index].opcode == OPCODE_HALT)
+    {
+      for (int l = 0; l < g->count; ++l)
+      {
+        g->lane[l]->status = (pc < 4000 || index >= (unsigned int)size)
+                                 ? LANE_COMPLETED : LANE_HALTED;
+        g->lane[l]->pc = pc;
+        g->lane[l]->executed += n;
+      }
+      break;
+    }
+
+    const APEX_Instruction* ins = &code[index];
+    Lanes addr;
+    int next = pc + 4;
+    switch (ins->opcode)
+    {
+      case OPCODE_MOVC:
+        r[ins->rd] = (Lanes){ 0 } + (uint32_t)ins->imm;
+        break;
+
+      case OPCODE_ADD:
+        r[ins->rd] = r[ins->rs1] + r[ins->rs2];
+        g->z = (Lanes)(r[ins->rd] == 0);
+        break;
+
+      case OPCODE_ADDL:
+        r[ins->rd] = r[ins->rs1] + (uint32_t)ins->imm;
+        g->z = (Lanes)(r[ins->rd] == 0);
+        break;
+
+      case OPCODE_SUB:
+        r[ins->rd] = r[ins->rs1] - r[ins->rs2];
+        g->z = (Lanes)(r[ins->rd] == 0);
+        break;
+
+      case OPCODE_SUBL:
+        r[ins->rd] = r[ins->rs1] - (uint32_t)ins->imm;
+        g->z = (Lanes)(r[ins->rd] == 0);
+        break;
+
+      case OPCODE_MUL:
+        r[ins->rd] = r[ins->rs1] * r[ins->rs2];
+        g->z = (Lanes)(r[ins->rd] == 0);
+        break;
+
+      case OPCODE_AND:
+        r[ins->rd] = r[ins->rs1] & r[ins->rs2];
+        break;
+
+      case OPCODE_OR:
+        r[ins->rd] = r[ins->rs1] | r[ins->rs2];
+        break;
+
+      case OPCODE_EXOR:
+        r[ins->rd] = r[ins->rs1] ^ r[ins->rs2];
+        break;
+
+      /* Each lane has its own data memory, so accesses go lane by lane;
+       * a lane that faults stops and the others end the step with it */
+      case OPCODE_LOAD:
+      case OPCODE_LDR:
+      case OPCODE_STORE:
+      case OPCODE_STR:
+        if (ins->opcode == OPCODE_LOAD)
+        {
+          addr = r[ins->rs1] + (uint32_t)ins->imm;
+        }
+        else if (ins->opcode == OPCODE_LDR)
+        {
+          addr = r[ins->rs1] + r[ins->rs2];
+        }
+        else if (ins->opcode == OPCODE_STORE)
+        {
+          addr = r[ins->rs2] + (uint32_t)ins->imm;
+        }
+        else
+        {
+          addr = r[ins->rs2] + r[ins->rs3];
+        }
+        for (int l = 0; l < g->count; ++l)
+        {
+          Instance* instance = g->lane[l];
+          int value;
+          int failed;
+          if (ins->opcode == OPCODE_LOAD || ins->opcode == OPCODE_LDR)
+          {
+            failed = APEX_data_load(&instance->memory, (int)addr[l], &value);
+            if (!failed)
+            {
+              r[ins->rd][l] = value;
+            }
+          }
+          else
+          {
+            failed = APEX_data_store(&instance->memory, (int)addr[l],
+                                     (int)r[ins->rs1][l]);
+          }
+          if (failed)
+          {
+            instance->status = LANE_FAULT;
+            instance->pc = pc;
+            instance->executed += n;
+            stop = 1;
+          }
+        }
+        break;
+
+      case OPCODE_BZ:
+      case OPCODE_BNZ:
+      {
+        Lanes taken = ins->opcode == OPCODE_BZ ? g->z : ~g->z;
+        Lanes target = (taken & (uint32_t)APEX_add(pc, ins->imm)) |
+                       (~taken & (uint32_t)(pc + 4));
+        for (int l = 0; l < g->count; ++l)
+        {
+          g->next_pc[l] = (int)target[l];
+        }
+        branched = 1;
+        stop = 1;
+        break;
+      }
+
+      case OPCODE_JUMP:
+      {
+        Lanes target = r[ins->rs1] + (uint32_t)ins->imm;
+        for (int l = 0; l < g->count; ++l)
+        {
+          g->next_pc[l] = (int)target[l];
+        }
+        branched = 1;
+        stop = 1;
+        break;
+      }
+
+      default:
+        break;
+    }
+
+    n++;
+    pc = next;
+  }
+  for (int l = 0; l < g->count && !branched; ++l)
+  {
+    g->next_pc[l] = pc;
+  }
+  return n;
+}
+
+/*
+ * Reads one instance per line of "R<n>=<value>" and "MEM[<address>]=
+ * <value>" items separated by spaces or commas; a line holding only '-'
+ * seeds nothing. Blank lines and lines starting with '#' are skipped.
+ * Returns the number of instances, or -1 on an error.
+ */
+static int
+read_seeds(const char* filename, Instance** out)
+{
+  FILE* fp = fopen(filename, "r");
+  if (!fp)
+  {
+    fprintf(stderr, "APEX_Error : Unable to read seeds %s\n", filename);
+    return -1;
+  }
+
+  char* line = NULL;
+  size_t len = 0;
+  int capacity = 0;
+  int count = 0;
+  int line_num = 0;
+  int failed = 0;
+  Instance* instances = NULL;
+
+  while (!failed && getline(&line, &len, fp) != -1)
+  {
+    line_num++;
+    char* item = strtok(line, " ,\t\r\n");
+    if (!item || item[0] == '#')
+    {
+      continue;
+    }
+    if (count == capacity)
+    {
+      capacity = capacity ? capacity * 2 : 64;
+      Instance* grown = realloc(instances, sizeof(*instances) * capacity);
+      if (!grown)
+      {
+        fprintf(stderr, "APEX_Error : Out of memory reading seeds %s\n",
+                filename);
+        failed = 1;
+        break;
+      }
+      instances = grown;
+    }
+
+    Instance* instance = &instances[count++];
+    memset(instance, 0, sizeof(*instance));
+    instance->pc = 4000;
+    APEX_data_init(&instance->memory);
+    for (; item && !failed; item = strtok(NULL, " ,\t\r\n"))
+    {
+      int reg, addr, value, used = 0;
+      if (strcmp(item, "-") == 0)
+      {
+        continue;
+      }
+      if (sscanf(item, "R%d=%d%n", &reg, &value, &used) == 2 &&
+          !item[used] && reg >= 0 && reg < 16)
+      {
+        instance->regs[reg] = value;
+      }
+      else if (sscanf(item, "MEM[%d]=%d%n", &addr, &value, &used) == 2 &&
+               !item[used] && APEX_data_store(&instance->memory, addr, value) == 0)
+      {
+        continue;
+      }
+      else
+      {
+        fprintf(stderr, "APEX_Error : %s:%d: invalid seed %s\n", filename,
+                line_num, item);
+        failed = 1;
+      }
+    }
+  }
+
+  free(line);
+  fclose(fp);
+  if (failed)
+  {
+    for (int i = 0; i < count; ++i)
+    {
+      APEX_data_free(&instances[i].memory);
+    }
+    free(instances);
+    return -1;
+  }
+  *out = instances;
+  return count;
+}
+/*
+ * Runs a window of instances to their end. The group at the lowest pc
+ * runs next and takes up to LANES of the instances waiting there, so
+ * lanes that took different paths join again where the paths meet.
+ * Whenever its lanes part, or an instance waits below its pc, or at it
+ * with a lane free, the group is written back and formed again, dense,
+ * from the instances then waiting.
+ */
+static void
+run_window(Instance* instances, int count, const APEX_Instruction* code,
+           int size, long long max, long long* lane_steps, long long* steps)
+{
+  Group g;
+  int grouped = 0;
+  int waiting_pc = INT_MAX;   // Lowest pc of the instances not in the group
+
+  for (;;)
+  {
+    if (!grouped)
+    {
+      int pc = INT_MAX;
+      int found = 0;
+      for (int i = 0; i < count; ++i)
+      {
+        if (instances[i].status == LANE_RUNNING && instances[i].pc <= pc)
+        {
+          pc = instances[i].pc;
+          found = 1;
+        }
+      }
+      if (!found)
+      {
+        break;
+      }
+      Instance* lanes[LANES];
+      int lanes_count = 0;
+      for (int i = 0; i < count && lanes_count < LANES; ++i)
+      {
+        if (instances[i].status == LANE_RUNNING && instances[i].pc == pc)
+        {
+          lanes[lanes_count++] = &instances[i];
+          instances[i].grouped = 1;
+        }
+      }
+      gather(&g, lanes, lanes_count);
+      grouped = 1;
+      waiting_pc = INT_MAX;
+      for (int i = 0; i < count; ++i)
+      {
+        if (instances[i].status == LANE_RUNNING && !instances[i].grouped &&
+            instances[i].pc < waiting_pc)
+        {
+          waiting_pc = instances[i].pc;
+        }
+      }
+    }
+
+    long long n = step(&g, code, size, max);
+    *lane_steps += n * g.count;
+    *steps += n;
+
+    int next_pc = g.next_pc[0];
+    int keep = 1;
+    for (int l = 0; l < g.count; ++l)
+    {
+      Instance* instance = g.lane[l];
+      if (instance->status == LANE_RUNNING)
+      {
+        instance->executed += n;
+        instance->pc = g.next_pc[l];
+        if (instance->executed == max)
+        {
+          instance->status = LANE_LIMIT;
+        }
+      }
+      keep = keep && instance->status == LANE_RUNNING &&
+             instance->pc == next_pc;
+    }
+    keep = keep && (next_pc < waiting_pc ||
+                    (next_pc == waiting_pc && g.count == LANES));
+    if (keep)
+    {
+      g.pc = next_pc;
+    }
+    else
+    {
+      scatter(&g);
+      for (int l = 0; l < g.count; ++l)
+      {
+        g.lane[l]->grouped = 0;
+      }
+      grouped = 0;
+    }
+  }
+}
+
+static void
+print_instance(int index, const Instance* instance, int json)
+{
+  if (json)
+  {
+    printf("{\"instance\":%d,\"status\":\"%s\",\"instructions\":%lld,"
+           "\"pc\":%d,\"z\":%d,\"regs\":[",
+           index, lane_status[instance->status], instance->executed,
+           instance->pc, instance->z);
+    for (int r = 0; r < 16; ++r)
+    {
+      printf("%s%d", r ? "," : "", instance->regs[r]);
+    }
+    printf("]}\n");
+    return;
+  }
+  printf("%d,%s,%lld,%d,%d", index, lane_status[instance->status],
+         instance->executed, instance->pc, instance->z);
+  for (int r = 0; r < 16; ++r)
+  {
+    printf(",%d", instance->regs[r]);
+  }
+  printf("\n");
+}
+
+/*
+ * Runs the program once per line of the seed file, each run starting at
+ * 4000 from zeroed registers and memory with its seeds applied, until it
+ * halts, leaves code memory, faults or executes max instructions. A row
+ * per run is printed in seed file order, as CSV or JSON lines, and the
+ * share of busy lanes goes to stderr.
+ * Returns 0, 1 if a run faulted, or -1 if the runs cannot be set up.
+ */
+int
+APEX_run_lockstep(const char* filename, const char* seeds, long long max,
+                  int json)
+{
+  APEX_CPU* cpu = APEX_cpu_init(filename, "quiet", 0);
+  if (!cpu)
+  {
+    fprintf(stderr, "APEX_Error : Unable to initialize from %s\n", filename);
+    return -1;
+  }
+  Instance* instances = NULL;
+  int count = read_seeds(seeds, &instances);
+  if (count < 0)
+  {
+    APEX_cpu_stop(cpu);
+    return -1;
+  }
+
+  long long lane_steps = 0;
+  long long steps = 0;
+  for (int i = 0; i < count; i += LOCKSTEP_WINDOW)
+  {
+    int window = count - i < LOCKSTEP_WINDOW ? count - i : LOCKSTEP_WINDOW;
+    run_window(&instances[i], window, cpu->code_memory, cpu->code_memory_size,
+               max, &lane_steps, &steps);
+  }
+
+  int status = 0;
+  if (!json)
+  {
+    printf("instance,status,instructions,pc,z");
+    for (int r = 0; r < 16; ++r)
+    {
+      printf(",R%d", r);
+    }
+    printf("\n");
+  }
+  for (int i = 0; i < count; ++i)
+  {
+    print_instance(i, &instances[i], json);
+    status |= instances[i].status == LANE_FAULT;
+    APEX_data_free(&instances[i].memory);
+  }
+  fprintf(stderr, "APEX_Lockstep : %d instances, %lld instructions in groups"
+          " of %d lanes, %.1f%% of lanes busy\n",
+          count, lane_steps, LANES,
+          steps ? 100.0 * lane_steps / (steps * LANES) : 0.0);
+
+  free(instances);
+  APEX_cpu_stop(cpu);
+  return status;
+}
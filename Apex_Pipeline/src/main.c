@@ -0,0 +1,318 @@
+/*
+ *  main.c
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+static void
+usage(const char* prog)
+{
+  fprintf(stderr, "APEX_Help : Usage %s <input_file|-> <simulate|display|quiet> <clock_cycles> [options]\n", prog);
+  fprintf(stderr, "APEX_Help :   --fast-forward <n>      execute n instructions functionally first\n");
+  fprintf(stderr, "APEX_Help :   --fast-forward-to <pc>  execute functionally until pc is reached\n");
+  fprintf(stderr, "APEX_Help :   --fast-forward-engine <translate|threaded|interpret>  how it runs\n");
+  fprintf(stderr, "APEX_Help :   --check                 compare the final state with the functional model\n");
+  fprintf(stderr, "APEX_Help :   --checkpoint-at <cycle> <file>  save the cpu state after that cycle\n");
+  fprintf(stderr, "APEX_Help :   --restore <file>        resume from a saved checkpoint\n");
+  fprintf(stderr, "APEX_Help :   --trace <file>          record every cycle to a binary trace\n");
+  fprintf(stderr, "APEX_Help :   --profile               list the program with what each instruction did\n");
+  fprintf(stderr, "APEX_Help :   --bypass <paths|none>   forward results from ex1,ex2,mem1,mem2,wb\n");
+  fprintf(stderr, "APEX_Help :   --halt <block|squash>   stages behind HALT hold or are cleared\n");
+  fprintf(stderr, "APEX_Help :   --predictor <static|bimodal|gshare>  predict BZ and BNZ\n");
+  fprintf(stderr, "APEX_Help :   --btb <entries>         JUMP targets remembered, 0 or a power of two\n");
+  fprintf(stderr, "APEX_Help :   --dcache <on|off|fields>  L1 data cache, fields sets=,ways=,line=,\n");
+  fprintf(stderr, "APEX_Help :                           replace=lru|random,write=back|through,miss=\n");
+  fprintf(stderr, "APEX_Help :   --width <n>             fetch, issue and retire up to n instructions per cycle\n");
+  fprintf(stderr, "APEX_Help :   --units <limits>        instructions issued per cycle by unit, alu=,mul=,mem=,branch=\n");
+  fprintf(stderr, "APEX_Help :   --core <inorder|ooo>    in-order pipeline or out-of-order core\n");
+  fprintf(stderr, "APEX_Help :   --ooo <sizes>           out-of-order structure sizes, rob=,iq=,lsq=,regs=\n");
+  fprintf(stderr, "APEX_Help :   --cores <file>[,<file>...]  more cores, each running its own program over shared data memory\n");
+  fprintf(stderr, "APEX_Help :   --quantum <cycles>      cycles the cores run between synchronizations\n");
+  fprintf(stderr, "APEX_Help :   --coherence <msi|mesi>  protocol keeping the cores' data caches coherent\n");
+  fprintf(stderr, "APEX_Help :       %s --batch <manifest> [-j <threads>] [--json]\n", prog);
+  fprintf(stderr, "APEX_Help :       %s --lockstep <input_file> <seed_file> [--max <instructions>] [--json]\n", prog);
+  exit(1);
+}
+
+/* Runs every program listed in a manifest, see batch.c */
+static int
+batch_main(int argc, char const* argv[])
+{
+  const char* manifest = argv[2];
+  int jobs = 1;
+  int json = 0;
+
+  for (int i = 3; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+    {
+      jobs = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--json") == 0)
+    {
+      json = 1;
+    }
+    else
+    {
+      usage(argv[0]);
+    }
+  }
+
+  return APEX_run_batch(manifest, jobs, json) == 0 ? 0 : 1;
+}
+
+/* Runs one program from every line of seeds, see lockstep.c */
+static int
+lockstep_main(int argc, char const* argv[])
+{
+  long long max = LLONG_MAX;
+  int json = 0;
+
+  for (int i = 4; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--max") == 0 && i + 1 < argc)
+    {
+      max = atoll(argv[++i]);
+      if (max <= 0)
+      {
+        usage(argv[0]);
+      }
+    }
+    else if (strcmp(argv[i], "--json") == 0)
+    {
+      json = 1;
+    }
+    else
+    {
+      usage(argv[0]);
+    }
+  }
+
+  return APEX_run_lockstep(argv[2], argv[3], max, json) == 0 ? 0 : 1;
+}
+
+int
+main(int argc, char const* argv[])
+{
+  if (argc >= 3 && strcmp(argv[1], "--batch") == 0) {
+    return batch_main(argc, argv);
+  }
+  if (argc >= 4 && strcmp(argv[1], "--lockstep") == 0) {
+    return lockstep_main(argc, argv);
+  }
+  if (argc < 4) {
+    usage(argv[0]);
+  }
+  if (strcmp(argv[2], "simulate") != 0 && strcmp(argv[2], "display") != 0 &&
+      strcmp(argv[2], "quiet") != 0)
+  {
+    usage(argv[0]);
+  }
+
+  long long fast_forward = -1;
+  int fast_forward_pc = -1;
+  const char* checkpoint_file = NULL;
+  int checkpoint_cycle = 0;
+  const char* restore_file = NULL;
+  const char* trace_file = NULL;
+  int profile = 0;
+  int engine = APEX_ENGINE_TRANSLATE;
+  int check = 0;
+  const char* filenames[APEX_MAX_CORES] = { argv[1] };
+  int num_cores = 1;
+  int quantum = 100;
+  APEX_Config config;
+  int config_set = 0;
+  int set;
+  APEX_config_default(&config);
+  for (int i = 4; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--fast-forward") == 0 && i + 1 < argc)
+    {
+      fast_forward = atoll(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--fast-forward-to") == 0 && i + 1 < argc)
+    {
+      fast_forward_pc = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--fast-forward-engine") == 0 && i + 1 < argc)
+    {
+      engine = APEX_find_name(engine_names, APEX_ENGINE_NUM, argv[++i]);
+      if (engine < 0)
+      {
+        usage(argv[0]);
+      }
+    }
+    else if (strcmp(argv[i], "--check") == 0)
+    {
+      check = 1;
+    }
+    else if (strcmp(argv[i], "--checkpoint-at") == 0 && i + 2 < argc)
+    {
+      checkpoint_cycle = atoi(argv[++i]);
+      checkpoint_file = argv[++i];
+    }
+    else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc)
+    {
+      restore_file = argv[++i];
+    }
+    else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+    {
+      trace_file = argv[++i];
+    }
+    else if (strcmp(argv[i], "--profile") == 0)
+    {
+      profile = 1;
+    }
+    else if (strcmp(argv[i], "--cores") == 0 && i + 1 < argc)
+    {
+      /* The list stays in argv, split in place */
+      char* list = (char*)argv[++i];
+      for (char* file = strtok(list, ","); file; file = strtok(NULL, ","))
+      {
+        if (num_cores == APEX_MAX_CORES)
+        {
+          fprintf(stderr, "APEX_Error : At most %d cores\n", APEX_MAX_CORES);
+          exit(1);
+        }
+        filenames[num_cores++] = file;
+      }
+    }
+    else if (strcmp(argv[i], "--quantum") == 0 && i + 1 < argc)
+    {
+      quantum = atoi(argv[++i]);
+      if (quantum < 1)
+      {
+        fprintf(stderr, "APEX_Error : Quantum must be at least one cycle\n");
+        exit(1);
+      }
+    }
+    else if (strncmp(argv[i], "--", 2) == 0 && i + 1 < argc &&
+             (set = APEX_config_set(&config, argv[i] + 2, argv[i + 1])) != -2)
+    {
+      /* One of the pipeline options, see APEX_config_set */
+      if (set != 0)
+      {
+        fprintf(stderr, "APEX_Error : Invalid %s %s\n", argv[i], argv[i + 1]);
+        exit(1);
+      }
+      config_set = 1;
+      ++i;
+    }
+    else
+    {
+      usage(argv[0]);
+    }
+  }
+
+  unsigned features =
+      (strcmp(argv[2], "simulate") == 0 ? APEX_RUN_SIMULATE : 0) |
+      (trace_file ? APEX_RUN_TRACE : 0) |
+      (checkpoint_file ? APEX_RUN_CHECKPOINT : 0) |
+      (restore_file ? APEX_RUN_RESTORE : 0) |
+      (fast_forward >= 0 || fast_forward_pc >= 0 ? APEX_RUN_FAST_FORWARD : 0) |
+      (check ? APEX_RUN_CHECK : 0) | (profile ? APEX_RUN_PROFILE : 0) |
+      (config_set ? APEX_RUN_CONFIGURED : 0) |
+      (num_cores > 1 ? APEX_RUN_MULTICORE : 0);
+  const char* conflict = APEX_config_check(&config, features);
+  if (conflict)
+  {
+    fprintf(stderr, "APEX_Error : %s\n", conflict);
+    exit(1);
+  }
+
+  if (num_cores > 1)
+  {
+    int status = APEX_run_multicore(filenames, num_cores, argv[2],
+                                    atoi(argv[3]), &config, quantum);
+    return status != 0;
+  }
+
+  int clockcycles = atoi(argv[3]);
+  APEX_CPU* cpu = APEX_cpu_init(argv[1],argv[2],clockcycles);
+  if (!cpu) 
+  {
+    fprintf(stderr, "APEX_Error : Unable to initialize CPU\n");
+    exit(1);
+  }
+  if (APEX_cpu_configure(cpu, &config) != 0)
+  {
+    fprintf(stderr, "APEX_Error : Unable to allocate the data cache\n");
+    APEX_cpu_stop(cpu);
+    exit(1);
+  }
+
+  if (restore_file && APEX_cpu_load_checkpoint(cpu, restore_file) != 0)
+  {
+    fprintf(stderr, "APEX_Error : Unable to restore checkpoint %s\n", restore_file);
+    APEX_cpu_stop(cpu);
+    exit(1);
+  }
+  cpu->checkpoint_file = checkpoint_file;
+  cpu->checkpoint_cycle = checkpoint_cycle;
+  cpu->fast_forward_engine = engine;
+
+  /* Run functionally up to the region of interest, then hand over */
+  if (fast_forward >= 0 || fast_forward_pc >= 0)
+  {
+    long long executed = APEX_cpu_fast_forward(
+        cpu, fast_forward_pc, fast_forward >= 0 ? fast_forward : LLONG_MAX);
+    if (cpu->enable_debug_messages)
+    {
+      fprintf(stderr, "APEX_CPU : Fast-forwarded %lld instructions to pc(%d)\n",
+              executed, cpu->pc);
+    }
+  }
+
+  if (trace_file)
+  {
+    cpu->trace = APEX_trace_open(trace_file, cpu);
+    if (!cpu->trace)
+    {
+      fprintf(stderr, "APEX_Error : Unable to create trace %s\n", trace_file);
+      APEX_cpu_stop(cpu);
+      exit(1);
+    }
+  }
+
+  /* Only the cycles run from here on are counted */
+  if (profile && APEX_profile_enable(cpu) != 0)
+  {
+    fprintf(stderr, "APEX_Error : Out of memory for the profile\n");
+    APEX_cpu_stop(cpu);
+    exit(1);
+  }
+
+  int status = APEX_cpu_run(cpu) != 0;
+  APEX_cpu_report(cpu);
+  APEX_profile_print(cpu);
+
+  /* Only a run that ended by itself has a state the model reaches too */
+  if (check)
+  {
+    if (cpu->halt_flag || cpu->data_fault || clockcycles < 0 ||
+        cpu->clock < clockcycles)
+    {
+      status |= APEX_cpu_check(cpu) != 0;
+    }
+    else
+    {
+      fprintf(stderr, "APEX_Check : Skipped, the run stopped at the cycle limit\n");
+    }
+  }
+  if (cpu->trace && APEX_trace_close(cpu->trace) != 0)
+  {
+    fprintf(stderr, "APEX_Error : Unable to write trace %s\n", trace_file);
+    status = 1;
+  }
+  APEX_cpu_stop(cpu);
+  return status;
+}
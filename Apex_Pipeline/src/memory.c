@@ -0,0 +1,220 @@
+/*
+ *  memory.c
+ *  Contains the sparse data memory: word addressed, backed by pages
+ *  allocated on demand through a two level page table, and optionally
+ *  shared by the cores of a multicore run
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+/* Pages several cores read and write. Each core's own tables only point
+ * to them, so its inline loads and stores stay free of locks; a core
+ * takes the lock only to find or allocate a page it has not seen yet.
+ * Pages are never freed while the cores run, so the pointers stay valid.
+ */
+struct APEX_Shared_Memory
+{
+  APEX_Data_Memory memory;
+  pthread_mutex_t lock;
+};
+
+void
+APEX_data_init(APEX_Data_Memory* memory)
+{
+  memset(memory, 0, sizeof(*memory));
+  memory->last_number = UINT32_MAX;
+}
+
+/* Releases every page, leaving an empty memory. Shared pages are left
+ * to APEX_shared_memory_free */
+void
+APEX_data_free(APEX_Data_Memory* memory)
+{
+  for (int i = 0; i < APEX_PAGE_TABLES; ++i)
+  {
+    int** table = memory->tables[i];
+    if (!table)
+    {
+      continue;
+    }
+    for (int j = 0; j < APEX_TABLE_PAGES && !memory->shared; ++j)
+    {
+      free(table[j]);
+    }
+    free(table);
+  }
+  APEX_data_init(memory);
+}
+
+/* Page with that number, or NULL if none was allocated */
+const int*
+APEX_data_page(const APEX_Data_Memory* memory, uint32_t number)
+{
+  int** table = memory->tables[number >> APEX_TABLE_SHIFT];
+  return table ? table[number & (APEX_TABLE_PAGES - 1)] : NULL;
+}
+
+/* Table entry of the page with that number, allocating the table when
+ * it is missing */
+static int**
+page_entry(APEX_Data_Memory* memory, uint32_t number)
+{
+  int*** table = &memory->tables[number >> APEX_TABLE_SHIFT];
+  if (!*table)
+  {
+    *table = calloc(APEX_TABLE_PAGES, sizeof(int*));
+    if (!*table)
+    {
+      return NULL;
+    }
+  }
+  return &(*table)[number & (APEX_TABLE_PAGES - 1)];
+}
+
+/* Page with that number, allocated along with its table when missing */
+static int*
+allocate_page(APEX_Data_Memory* memory, uint32_t number)
+{
+  int** page = page_entry(memory, number);
+  if (!page)
+  {
+    return NULL;
+  }
+  if (!*page)
+  {
+    *page = calloc(APEX_PAGE_WORDS, sizeof(int));
+    if (!*page)
+    {
+      return NULL;
+    }
+    memory->pages++;
+  }
+  return *page;
+}
+
+/* Looks up, or allocates if asked, the page in the shared memory and
+ * enters it in this core's tables */
+static int*
+shared_page(APEX_Data_Memory* memory, uint32_t number, int allocate)
+{
+  APEX_Shared_Memory* shared = memory->shared;
+  pthread_mutex_lock(&shared->lock);
+  int* page = allocate ? allocate_page(&shared->memory, number)
+                       : (int*)APEX_data_page(&shared->memory, number);
+  pthread_mutex_unlock(&shared->lock);
+  if (!page)
+  {
+    return NULL;
+  }
+  int** entry = page_entry(memory, number);
+  if (!entry)
+  {
+    return NULL;
+  }
+  *entry = page;
+  return page;
+}
+
+/*
+ * Makes the page with that number the last accessed one, allocating it
+ * first if allocate is set. Returns NULL, leaving the last page as it
+ * was, when the page is missing or cannot be allocated.
+ */
+int*
+APEX_data_refill(APEX_Data_Memory* memory, uint32_t number, int allocate)
+{
+  int* page = (int*)APEX_data_page(memory, number);
+  if (!page && memory->shared)
+  {
+    page = shared_page(memory, number, allocate);
+  }
+  else if (!page && allocate)
+  {
+    page = allocate_page(memory, number);
+  }
+  if (page)
+  {
+    memory->last_number = number;
+    memory->last_page = page;
+  }
+  return page;
+}
+
+/* Lowest address at which the two memories hold different words, or -1
+ * if none; words never stored read as zero */
+int
+APEX_data_compare(const APEX_Data_Memory* a, const APEX_Data_Memory* b)
+{
+  static const int zero[APEX_PAGE_WORDS];
+  for (int i = 0; i < APEX_PAGE_TABLES; ++i)
+  {
+    if (!a->tables[i] && !b->tables[i])
+    {
+      continue;
+    }
+    for (int j = 0; j < APEX_TABLE_PAGES; ++j)
+    {
+      uint32_t number = ((uint32_t)i << APEX_TABLE_SHIFT) | j;
+      const int* page_a = APEX_data_page(a, number);
+      const int* page_b = APEX_data_page(b, number);
+      if (page_a == page_b)
+      {
+        continue;
+      }
+      page_a = page_a ? page_a : zero;
+      page_b = page_b ? page_b : zero;
+      for (int k = 0; k < APEX_PAGE_WORDS; ++k)
+      {
+        if (page_a[k] != page_b[k])
+        {
+          return (int)(number << APEX_PAGE_SHIFT) + k;
+        }
+      }
+    }
+  }
+  return -1;
+}
+
+/* Pages allocated, by every core for a shared memory */
+int
+APEX_data_pages(const APEX_Data_Memory* memory)
+{
+  return memory->shared ? memory->shared->memory.pages : memory->pages;
+}
+
+APEX_Shared_Memory*
+APEX_shared_memory_create(void)
+{
+  APEX_Shared_Memory* shared = malloc(sizeof(*shared));
+  if (!shared)
+  {
+    return NULL;
+  }
+  APEX_data_init(&shared->memory);
+  pthread_mutex_init(&shared->lock, NULL);
+  return shared;
+}
+
+/* Frees the pages, once no core uses them */
+void
+APEX_shared_memory_free(APEX_Shared_Memory* shared)
+{
+  APEX_data_free(&shared->memory);
+  pthread_mutex_destroy(&shared->lock);
+  free(shared);
+}
+
+/* Makes an empty memory use the pages of shared from now on */
+void
+APEX_data_share(APEX_Data_Memory* memory, APEX_Shared_Memory* shared)
+{
+  APEX_data_free(memory);
+  memory->shared = shared;
+}
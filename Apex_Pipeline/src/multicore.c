@@ -0,0 +1,282 @@
+/*
+ *  multicore.c
+ *  Runs several cores, each with its own program, over one shared data
+ *  memory. Every core is simulated on its own host thread, and the
+ *  threads meet once per quantum of simulated cycles
+ *
+ *  Within a quantum the cores run freely, so the order in which they
+ *  reach the same word or cache line varies between runs unless the
+ *  quantum is 1. The data caches are kept coherent by cache.c.
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+/* State shared by the core threads */
+typedef struct APEX_Multicore
+{
+  APEX_CPU** cores;
+  int num_cores;
+  int quantum;
+  int clockcycles;          // Limit of every core, INT_MAX for none
+
+  pthread_mutex_t lock;
+  pthread_cond_t started;
+  int start;                // 1 once every thread exists, -1 if one failed
+  pthread_barrier_t barrier;
+  int running;              // Cores not done, changed only before the
+                            // first barrier of a quantum
+} APEX_Multicore;
+
+typedef struct APEX_Core_Thread
+{
+  APEX_Multicore* multicore;
+  APEX_CPU* cpu;
+  pthread_t thread;
+} APEX_Core_Thread;
+
+/*
+ * Runs a core up to the end of the quantum ending at cycle end. Returns
+ * 1 once the core is done: halted, faulted, out of program or at the
+ * cycle limit.
+ */
+static int
+run_quantum(APEX_Multicore* multicore, APEX_CPU* cpu, long long end)
+{
+  cpu->clockcycles = end < multicore->clockcycles ? end : multicore->clockcycles;
+  APEX_cpu_run(cpu);
+  return cpu->halt_flag || cpu->data_fault || cpu->clock < cpu->clockcycles ||
+         cpu->clock == multicore->clockcycles;
+}
+
+static void*
+core_worker(void* arg)
+{
+  APEX_Core_Thread* thread = arg;
+  APEX_Multicore* multicore = thread->multicore;
+
+  pthread_mutex_lock(&multicore->lock);
+  while (!multicore->start)
+  {
+    pthread_cond_wait(&multicore->started, &multicore->lock);
+  }
+  int start = multicore->start;
+  pthread_mutex_unlock(&multicore->lock);
+  if (start < 0)
+  {
+    return NULL;
+  }
+
+  int done = 0;
+  for (long long end = multicore->quantum; ; end += multicore->quantum)
+  {
+    if (!done)
+    {
+      done = run_quantum(multicore, thread->cpu, end);
+      if (done)
+      {
+        pthread_mutex_lock(&multicore->lock);
+        multicore->running--;
+        pthread_mutex_unlock(&multicore->lock);
+      }
+    }
+
+    /* Everyone has finished the quantum before running is read, and
+     * read it before anyone can change it again */
+    pthread_barrier_wait(&multicore->barrier);
+    int running = multicore->running;
+    pthread_barrier_wait(&multicore->barrier);
+    if (!running)
+    {
+      break;
+    }
+  }
+  return NULL;
+}
+
+/* Runs the cores one quantum after the other on the calling thread, if
+ * not every thread could be started */
+static void
+run_serial(APEX_Multicore* multicore)
+{
+  int done[APEX_MAX_CORES] = { 0 };
+  for (long long end = multicore->quantum; multicore->running;
+       end += multicore->quantum)
+  {
+    for (int i = 0; i < multicore->num_cores; ++i)
+    {
+      if (!done[i])
+      {
+        done[i] = run_quantum(multicore, multicore->cores[i], end);
+        multicore->running -= done[i];
+      }
+    }
+  }
+}
+
+static const char*
+core_status(const APEX_CPU* cpu, int clockcycles)
+{
+  if (cpu->data_fault)
+  {
+    return "fault";
+  }
+  if (cpu->halt_flag)
+  {
+    return "halted";
+  }
+  return cpu->clock == clockcycles ? "cycle_limit" : "completed";
+}
+
+/* Prints one row per core: how it ended, its IPC and what the other
+ * cores cost it */
+static void
+print_cores(APEX_CPU** cores, const char* const* filenames, int num_cores,
+            int clockcycles)
+{
+  printf("==================CORES==============\n");
+  for (int i = 0; i < num_cores; ++i)
+  {
+    const APEX_CPU* cpu = cores[i];
+    const APEX_Stats* stats = &cpu->stats;
+    printf(" | core %d | %s | %s | cycles=%d | retired=%lld | IPC=%.3f |"
+           " misses=%lld | coherence misses=%lld | invalidated=%lld |"
+           " bus wait=%lld |\n",
+           i, filenames[i], core_status(cpu, clockcycles), cpu->clock,
+           stats->retired,
+           cpu->clock ? (double)stats->retired / cpu->clock : 0.0,
+           stats->dcache_misses, stats->dcache_coherence_misses,
+           stats->dcache_invalidated, stats->bus_wait_cycles);
+  }
+}
+
+/*
+ * Runs one core per program, all with the same configuration, sharing
+ * data memory, until every core is done. In "display" mode each core's
+ * registers and counters are printed, then a row per core and the
+ * interconnect counters.
+ * Returns 0, 1 if a core faulted, or -1 if the cores cannot be set up.
+ */
+int
+APEX_run_multicore(const char* const* filenames, int num_cores,
+                   const char* simulate, int clockcycles,
+                   const APEX_Config* config, int quantum)
+{
+  APEX_CPU* cores[APEX_MAX_CORES];
+  APEX_Core_Thread threads[APEX_MAX_CORES];
+  APEX_Interconnect* interconnect = NULL;
+  int created = 0;
+  int status = -1;
+
+  APEX_Shared_Memory* shared = APEX_shared_memory_create();
+  if (!shared)
+  {
+    fprintf(stderr, "APEX_Error : Unable to allocate shared data memory\n");
+    return -1;
+  }
+  for (; created < num_cores; ++created)
+  {
+    APEX_CPU* cpu = APEX_cpu_init(filenames[created], "quiet", clockcycles);
+    if (!cpu)
+    {
+      fprintf(stderr, "APEX_Error : Unable to initialize core %d from %s\n",
+              created, filenames[created]);
+      goto done;
+    }
+    cores[created] = cpu;
+    if (APEX_cpu_configure(cpu, config) != 0)
+    {
+      fprintf(stderr, "APEX_Error : Unable to allocate the data cache\n");
+      created++;
+      goto done;
+    }
+    APEX_data_share(&cpu->data_memory, shared);
+  }
+  interconnect = APEX_interconnect_create(cores, num_cores);
+  if (!interconnect)
+  {
+    fprintf(stderr, "APEX_Error : Unable to allocate the interconnect\n");
+    goto done;
+  }
+
+  APEX_Multicore multicore;
+  multicore.cores = cores;
+  multicore.num_cores = num_cores;
+  multicore.quantum = quantum;
+  multicore.clockcycles = clockcycles >= 0 ? clockcycles : INT_MAX;
+  multicore.start = 0;
+  multicore.running = num_cores;
+  pthread_mutex_init(&multicore.lock, NULL);
+  pthread_cond_init(&multicore.started, NULL);
+  pthread_barrier_init(&multicore.barrier, NULL, num_cores);
+
+  int started = 0;
+  pthread_mutex_lock(&multicore.lock);
+  for (; started < num_cores; ++started)
+  {
+    threads[started].multicore = &multicore;
+    threads[started].cpu = cores[started];
+    if (pthread_create(&threads[started].thread, NULL, core_worker,
+                       &threads[started]) != 0)
+    {
+      break;
+    }
+  }
+  multicore.start = started == num_cores ? 1 : -1;
+  pthread_cond_broadcast(&multicore.started);
+  pthread_mutex_unlock(&multicore.lock);
+  for (int i = 0; i < started; ++i)
+  {
+    pthread_join(threads[i].thread, NULL);
+  }
+  if (started < num_cores)
+  {
+    run_serial(&multicore);
+  }
+
+  APEX_interconnect_collect(interconnect);
+  for (int i = 0; i < num_cores; ++i)
+  {
+    APEX_cpu_print_fault(cores[i]);
+  }
+  pthread_barrier_destroy(&multicore.barrier);
+  pthread_cond_destroy(&multicore.started);
+  pthread_mutex_destroy(&multicore.lock);
+
+  if (strcmp(simulate, "display") == 0)
+  {
+    printf("(apex) >> Simulation Complete");
+    for (int i = 0; i < num_cores; ++i)
+    {
+      printf("\n==================CORE %d : %s==============", i, filenames[i]);
+      APEX_cpu_display(cores[i]);
+    }
+    print_cores(cores, filenames, num_cores, multicore.clockcycles);
+    APEX_interconnect_print(interconnect);
+  }
+  status = 0;
+  for (int i = 0; i < num_cores; ++i)
+  {
+    status |= cores[i]->data_fault;
+  }
+
+done:
+  if (interconnect)
+  {
+    APEX_interconnect_free(interconnect);
+  }
+  for (int i = 0; i < created; ++i)
+  {
+    APEX_cpu_stop(cores[i]);
+  }
+  APEX_shared_memory_free(shared);
+  return status;
+}
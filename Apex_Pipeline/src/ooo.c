@@ -0,0 +1,857 @@
+/*
+ *  ooo.c
+ *  Contains the out-of-order core model: register renaming onto a
+ *  physical register file, a unified issue queue, a load-store queue and
+ *  a reorder buffer that commits in program order
+ *
+ *  It runs the same programs as the pipeline in cpu.c, selected with
+ *  --core ooo, and leaves the same registers, Z flag and data memory
+ *  behind.
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+const char* const core_names[APEX_CORE_NUM] = {
+  [APEX_CORE_INORDER] = "inorder",
+  [APEX_CORE_OOO]     = "ooo",
+};
+
+const char* const ooo_names[APEX_OOO_NUM] = {
+  [APEX_OOO_ROB]  = "rob",
+  [APEX_OOO_IQ]   = "iq",
+  [APEX_OOO_LSQ]  = "lsq",
+  [APEX_OOO_REGS] = "regs",
+};
+
+static const int ooo_max[APEX_OOO_NUM] = {
+  [APEX_OOO_ROB]  = APEX_OOO_MAX_ROB,
+  [APEX_OOO_IQ]   = APEX_OOO_MAX_IQ,
+  [APEX_OOO_LSQ]  = APEX_OOO_MAX_LSQ,
+  [APEX_OOO_REGS] = APEX_OOO_MAX_REGS,
+};
+
+/* Architectural register the Z flag is renamed as */
+#define Z_REG  16
+
+/* Cycles from issue until a result can be read: ALU, MUL and branches
+ * finish in Execute 1 and loads in Memory 1, as on the pipeline, plus
+ * the cycles a data cache miss adds */
+#define EXECUTE_LATENCY  1
+#define LOAD_LATENCY     3
+
+/* Why fetch is not fetching */
+enum
+{
+  FETCH_RUNNING,
+  FETCH_HALT,   // HALT fetched, waits for a redirect or the end
+  FETCH_END     // pc left the program
+};
+
+/* An instruction between fetch and rename */
+typedef struct OoO_Fetched
+{
+  int pc;
+  int index;          // Code memory entry
+  int predicted_pc;   // pc fetched after it
+} OoO_Fetched;
+
+/*
+ * Reorder buffer entry. The instruction is held in a pipeline latch so
+ * it prints the same way: buffer receives the result, mem_address the
+ * address of a load or store and rs1_value the word a store writes.
+ */
+typedef struct OoO_Entry
+{
+  CPU_Stage ins;
+  int src[3];         // Physical registers read for rs1, rs2, rs3, or -1;
+                      // BZ and BNZ read Z through src[0]
+  int dest;           // Physical register written, or -1
+  uint8_t issued;
+  uint8_t taken;      // Branch outcome
+  uint8_t missed;     // Load that missed in the data cache
+  uint8_t fault;      // Address outside data memory, raised at commit
+  int done_cycle;     // First cycle the result can be read and committed
+  int predicted_pc;   // pc fetch followed
+  int next_pc;        // pc that really follows, known once issued
+} OoO_Entry;
+
+/* State of the core, kept in the cpu from one APEX_cpu_run to the next.
+ * The issue queue and the LSQ hold ROB indices, oldest first; the
+ * physical registers hold values, the cycle each becomes readable and
+ * the number of committed mappings to it */
+struct APEX_OoO
+{
+  int size[APEX_OOO_NUM];
+  int width;
+
+  OoO_Entry rob[APEX_OOO_MAX_ROB];
+  int rob_head;
+  int rob_count;
+
+  int iq[APEX_OOO_MAX_IQ];
+  int iq_count;
+
+  int lsq[APEX_OOO_MAX_LSQ];
+  int lsq_head;
+  int lsq_count;
+
+  OoO_Fetched fetched[2 * APEX_MAX_WIDTH];
+  int fetch_head;
+  int fetch_count;
+  int fetch_pc;
+  int fetch_state;    // FETCH_*
+
+  int values[APEX_OOO_MAX_REGS];
+  int ready_cycle[APEX_OOO_MAX_REGS];
+  int refs[APEX_OOO_MAX_REGS];
+  int free_regs[APEX_OOO_MAX_REGS];
+  int free_count;
+  int map[APEX_OOO_ARCH_REGS];            // Newest mapping, used by rename
+  int committed_map[APEX_OOO_ARCH_REGS];  // Mapping of the committed state
+
+  int commit_pc;      // pc after the last committed instruction
+  int recovering;     // A branch redirected fetch since the last commit
+};
+
+/*
+ * Sets structure sizes from a comma separated list of rob=N, iq=N, lsq=N
+ * and regs=N. Returns 0 on success, -1 on an unknown structure or a size
+ * outside 1 to its maximum, or fewer than 18 physical registers.
+ */
+int
+APEX_ooo_parse(APEX_OoO_Config* config, const char* list)
+{
+  APEX_OoO_Config parsed = *config;
+  const char* field = list;
+  while (1)
+  {
+    size_t length = strcspn(field, ",");
+    const char* value = memchr(field, '=', length);
+    int kind = 0;
+    while (value && kind < APEX_OOO_NUM &&
+           (strlen(ooo_names[kind]) != (size_t)(value - field) ||
+            strncmp(field, ooo_names[kind], value - field) != 0))
+    {
+      ++kind;
+    }
+    if (!value || kind == APEX_OOO_NUM)
+    {
+      return -1;
+    }
+    parsed.size[kind] = atoi(value + 1);
+    if (parsed.size[kind] < 1 || parsed.size[kind] > ooo_max[kind])
+    {
+      return -1;
+    }
+    if (field[length] == '\0')
+    {
+      break;
+    }
+    field += length + 1;
+  }
+  if (parsed.size[APEX_OOO_REGS] <= APEX_OOO_ARCH_REGS)
+  {
+    return -1;
+  }
+  *config = parsed;
+  return 0;
+}
+
+/* Position of a ROB entry counted from the oldest */
+static inline int
+rob_age(const APEX_OoO* core, int index)
+{
+  int age = index - core->rob_head;
+  return age < 0 ? age + core->size[APEX_OOO_ROB] : age;
+}
+
+static inline OoO_Entry*
+lsq_entry(APEX_OoO* core, int i)
+{
+  return &core->rob[core->lsq[(core->lsq_head + i) % core->size[APEX_OOO_LSQ]]];
+}
+
+/* Maps every register to a physical register holding its value, and Z
+ * to one holding 0 when it is set; the rest are free */
+static void
+ooo_init(APEX_CPU* cpu, APEX_OoO* core)
+{
+  memcpy(core->size, cpu->config.ooo.size, sizeof(core->size));
+  core->width = cpu->config.width;
+  for (int i = 0; i < APEX_OOO_ARCH_REGS; ++i)
+  {
+    core->values[i] = i == Z_REG ? !cpu->z_flag_set : cpu->regs[i];
+    core->map[i] = i;
+    core->committed_map[i] = i;
+    core->refs[i] = 1;
+  }
+  for (int reg = core->size[APEX_OOO_REGS] - 1; reg >= APEX_OOO_ARCH_REGS; --reg)
+  {
+    core->free_regs[core->free_count++] = reg;
+  }
+  core->fetch_pc = cpu->pc;
+  core->commit_pc = cpu->pc;
+}
+
+/*
+ * Fetches up to the width of instructions into the fetch queue, which
+ * holds two groups. Like the pipeline, a group ends after a control
+ * instruction, whose predicted target is fetched the next cycle. Fetch
+ * stops at HALT and outside the program until a branch redirects it.
+ */
+static void
+ooo_fetch(APEX_CPU* cpu, APEX_OoO* core)
+{
+  int capacity = 2 * core->width;
+  for (int n = 0; n < core->width && core->fetch_state == FETCH_RUNNING &&
+                  core->fetch_count < capacity; ++n)
+  {
+    int pc = core->fetch_pc;
+    int index = get_code_index(pc);
+    if (pc < 4000 || index >= cpu->code_memory_size)
+    {
+      core->fetch_state = FETCH_END;
+      break;
+    }
+
+    const APEX_Instruction* code = &cpu->code_memory[index];
+    int flags = opcode_info[code->opcode].flags;
+    OoO_Fetched* fetched =
+        &core->fetched[(core->fetch_head + core->fetch_count++) % capacity];
+    fetched->pc = pc;
+    fetched->index = index;
+    fetched->predicted_pc = (flags & OPF_CONTROL)
+                                ? APEX_predict_next_pc(cpu, code, pc)
+                                : pc + 4;
+    core->fetch_pc = fetched->predicted_pc;
+
+    if (cpu->enable_debug_messages)
+    {
+      CPU_Stage stage;
+      memset(&stage, 0, sizeof(stage));
+      stage.pc = pc;
+      stage.opcode = code->opcode;
+      stage.rd = code->rd;
+      stage.rs1 = code->rs1;
+      stage.rs2 = code->rs2;
+      stage.rs3 = code->rs3;
+      stage.imm = code->imm;
+      print_stage_content(cpu, "Fetch", &stage);
+    }
+
+    if (code->opcode == OPCODE_HALT)
+    {
+      core->fetch_state = FETCH_HALT;
+      break;
+    }
+    if (flags & OPF_CONTROL)
+    {
+      break;
+    }
+  }
+}
+
+/*
+ * Renames up to the width of fetched instructions in program order and
+ * dispatches them to the ROB, the issue queue and, for loads and stores,
+ * the LSQ. Each destination gets a free physical register, which also
+ * becomes Z for the instructions that set it. Rename stops at the first
+ * instruction a full structure cannot take.
+ */
+static void
+ooo_rename(APEX_CPU* cpu, APEX_OoO* core)
+{
+  int capacity = 2 * core->width;
+  for (int n = 0; n < core->width && core->fetch_count; ++n)
+  {
+    const OoO_Fetched* fetched = &core->fetched[core->fetch_head];
+    const APEX_Instruction* code = &cpu->code_memory[fetched->index];
+    int flags = opcode_info[code->opcode].flags;
+    int queued = code->opcode != OPCODE_HALT && code->opcode != OPCODE_NONE;
+    int memory = flags & (OPF_LOAD | OPF_STORE);
+
+    int full = -1;
+    if (core->rob_count == core->size[APEX_OOO_ROB])
+    {
+      full = APEX_OOO_ROB;
+    }
+    else if (queued && core->iq_count == core->size[APEX_OOO_IQ])
+    {
+      full = APEX_OOO_IQ;
+    }
+    else if (memory && core->lsq_count == core->size[APEX_OOO_LSQ])
+    {
+      full = APEX_OOO_LSQ;
+    }
+    else if ((flags & OPF_WRITES_RD) && !core->free_count)
+    {
+      full = APEX_OOO_REGS;
+    }
+    if (full >= 0)
+    {
+      cpu->stats.ooo_full[full]++;
+      break;
+    }
+
+    int index = (core->rob_head + core->rob_count++) % core->size[APEX_OOO_ROB];
+    OoO_Entry* entry = &core->rob[index];
+    memset(entry, 0, sizeof(*entry));
+    entry->ins.pc = fetched->pc;
+    entry->ins.opcode = code->opcode;
+    entry->ins.rd = code->rd;
+    entry->ins.rs1 = code->rs1;
+    entry->ins.rs2 = code->rs2;
+    entry->ins.rs3 = code->rs3;
+    entry->ins.imm = code->imm;
+    entry->predicted_pc = fetched->predicted_pc;
+    entry->next_pc = fetched->predicted_pc;
+
+    entry->src[0] = (flags & OPF_READS_RS1) ? core->map[code->rs1] : -1;
+    entry->src[1] = (flags & OPF_READS_RS2) ? core->map[code->rs2] : -1;
+    entry->src[2] = (flags & OPF_READS_RS3) ? core->map[code->rs3] : -1;
+    if (code->opcode == OPCODE_BZ || code->opcode == OPCODE_BNZ)
+    {
+      entry->src[0] = core->map[Z_REG];
+    }
+
+    entry->dest = -1;
+    if (flags & OPF_WRITES_RD)
+    {
+      entry->dest = core->free_regs[--core->free_count];
+      core->ready_cycle[entry->dest] = INT_MAX;
+      core->map[code->rd] = entry->dest;
+      if (flags & OPF_SETS_Z)
+      {
+        core->map[Z_REG] = entry->dest;
+      }
+    }
+
+    if (queued)
+    {
+      core->iq[core->iq_count++] = index;
+    }
+    else
+    {
+      entry->issued = 1;
+      entry->done_cycle = cpu->clock + 1;
+    }
+    if (memory)
+    {
+      core->lsq[(core->lsq_head + core->lsq_count++) % core->size[APEX_OOO_LSQ]] =
+          index;
+    }
+
+    core->fetch_head = (core->fetch_head + 1) % capacity;
+    core->fetch_count--;
+    if (cpu->enable_debug_messages)
+    {
+      print_stage_content(cpu, "Rename", &entry->ins);
+    }
+  }
+}
+
+/*
+ * Removes every instruction younger than the branch at ROB index and
+ * refetches from where the branch really goes. The newest mapping is
+ * rebuilt from the committed one and the older instructions still in
+ * the ROB, and the registers the younger ones took are freed.
+ */
+static void
+ooo_squash(APEX_CPU* cpu, APEX_OoO* core, int index)
+{
+  int keep = rob_age(core, index) + 1;
+  for (int i = keep; i < core->rob_count; ++i)
+  {
+    OoO_Entry* young = &core->rob[(core->rob_head + i) % core->size[APEX_OOO_ROB]];
+    if (young->dest >= 0)
+    {
+      core->free_regs[core->free_count++] = young->dest;
+    }
+    cpu->stats.ooo_squashed++;
+  }
+  core->rob_count = keep;
+
+  memcpy(core->map, core->committed_map, sizeof(core->map));
+  for (int i = 0; i < keep; ++i)
+  {
+    OoO_Entry* older = &core->rob[(core->rob_head + i) % core->size[APEX_OOO_ROB]];
+    if (older->dest >= 0)
+    {
+      core->map[older->ins.rd] = older->dest;
+      if (opcode_info[older->ins.opcode].flags & OPF_SETS_Z)
+      {
+        core->map[Z_REG] = older->dest;
+      }
+    }
+  }
+
+  int kept = 0;
+  for (int i = 0; i < core->iq_count; ++i)
+  {
+    if (rob_age(core, core->iq[i]) < keep)
+    {
+      core->iq[kept++] = core->iq[i];
+    }
+  }
+  core->iq_count = kept;
+  while (core->lsq_count &&
+         rob_age(core, core->lsq[(core->lsq_head + core->lsq_count - 1) %
+                                 core->size[APEX_OOO_LSQ]]) >= keep)
+  {
+    core->lsq_count--;
+  }
+
+  core->fetch_count = 0;
+  core->fetch_pc = core->rob[index].next_pc;
+  core->fetch_state = FETCH_RUNNING;
+  core->recovering = 1;
+}
+
+/* True once every source of an entry can be read this cycle */
+static int
+operands_ready(const APEX_CPU* cpu, const APEX_OoO* core, const OoO_Entry* entry)
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    if (entry->src[i] >= 0 && core->ready_cycle[entry->src[i]] > cpu->clock)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* A load waits until every older store in the LSQ knows its address */
+static int
+older_stores_issued(APEX_OoO* core, const OoO_Entry* load)
+{
+  for (int i = 0; i < core->lsq_count; ++i)
+  {
+    const OoO_Entry* older = lsq_entry(core, i);
+    if (older == load)
+    {
+      break;
+    }
+    if (!older->issued)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+ * Reads the word a load wants: from the youngest older store to the
+ * same address still in the LSQ, or else from data memory through the
+ * data cache. Returns the cycles a miss adds to the load.
+ */
+static int
+execute_load(APEX_CPU* cpu, APEX_OoO* core, OoO_Entry* entry)
+{
+  CPU_Stage* ins = &entry->ins;
+  if (ins->mem_address < 0)
+  {
+    entry->fault = 1;
+    return 0;
+  }
+
+  const OoO_Entry* store = NULL;
+  for (int i = 0; i < core->lsq_count; ++i)
+  {
+    const OoO_Entry* older = lsq_entry(core, i);
+    if (older == entry)
+    {
+      break;
+    }
+    if ((opcode_info[older->ins.opcode].flags & OPF_STORE) &&
+        older->ins.mem_address == ins->mem_address)
+    {
+      store = older;
+    }
+  }
+  if (store)
+  {
+    ins->buffer = store->ins.rs1_value;
+    cpu->stats.ooo_forwarded++;
+    return 0;
+  }
+
+  APEX_data_load(&cpu->data_memory, ins->mem_address, &ins->buffer);
+  if (!cpu->config.dcache.sets)
+  {
+    return 0;
+  }
+  int latency = APEX_dcache_access(cpu, ins->mem_address, 0);
+  entry->missed = latency > 0;
+  return latency;
+}
+
+/* Computes the result, address or branch outcome of an issued entry
+ * from its source registers; a store only takes its address and data,
+ * data memory is written when it commits */
+static void
+ooo_execute(APEX_CPU* cpu, APEX_OoO* core, OoO_Entry* entry)
+{
+  CPU_Stage* ins = &entry->ins;
+  int a = entry->src[0] >= 0 ? core->values[entry->src[0]] : 0;
+  int b = entry->src[1] >= 0 ? core->values[entry->src[1]] : 0;
+  int c = entry->src[2] >= 0 ? core->values[entry->src[2]] : 0;
+  int latency = EXECUTE_LATENCY;
+
+  switch (ins->opcode)
+  {
+    case OPCODE_STORE:
+      ins->mem_address = APEX_add(b, ins->imm);
+      ins->rs1_value = a;
+      break;
+
+    case OPCODE_STR:
+      ins->mem_address = APEX_add(b, c);
+      ins->rs1_value = a;
+      break;
+
+    case OPCODE_LOAD:
+      ins->mem_address = APEX_add(a, ins->imm);
+      latency = LOAD_LATENCY + execute_load(cpu, core, entry);
+      break;
+
+    case OPCODE_LDR:
+      ins->mem_address = APEX_add(a, b);
+      latency = LOAD_LATENCY + execute_load(cpu, core, entry);
+      break;
+
+    case OPCODE_MOVC:
+      ins->buffer = ins->imm;
+      break;
+
+    case OPCODE_ADD:
+      ins->buffer = APEX_add(a, b);
+      break;
+
+    case OPCODE_ADDL:
+      ins->buffer = APEX_add(a, ins->imm);
+      break;
+
+    case OPCODE_SUB:
+      ins->buffer = APEX_sub(a, b);
+      break;
+
+    case OPCODE_SUBL:
+      ins->buffer = APEX_sub(a, ins->imm);
+      break;
+
+    case OPCODE_MUL:
+      ins->buffer = APEX_mul(a, b);
+      break;
+
+    case OPCODE_AND:
+      ins->buffer = a & b;
+      break;
+
+    case OPCODE_OR:
+      ins->buffer = a | b;
+      break;
+
+    case OPCODE_EXOR:
+      ins->buffer = a ^ b;
+      break;
+
+    /* Z is set when the register renamed as Z holds 0 */
+    case OPCODE_BZ:
+      entry->taken = a == 0;
+      entry->next_pc = entry->taken ? APEX_add(ins->pc, ins->imm) : ins->pc + 4;
+      break;
+
+    case OPCODE_BNZ:
+      entry->taken = a != 0;
+      entry->next_pc = entry->taken ? APEX_add(ins->pc, ins->imm) : ins->pc + 4;
+      break;
+
+    case OPCODE_JUMP:
+      entry->taken = 1;
+      entry->next_pc = APEX_add(a, ins->imm);
+      break;
+
+    default:
+      break;
+  }
+
+  entry->issued = 1;
+  entry->done_cycle = cpu->clock + latency;
+  if (entry->dest >= 0)
+  {
+    core->values[entry->dest] = ins->buffer;
+    core->ready_cycle[entry->dest] = entry->done_cycle;
+  }
+}
+
+/*
+ * Selects the oldest entries of the issue queue whose operands are
+ * ready, up to the width and the limit of each unit, and executes them.
+ * A dependent entry can issue in the cycle its producer's result is
+ * ready. A mispredicted branch squashes everything younger at once.
+ * Returns the number of entries issued.
+ */
+static int
+ooo_issue(APEX_CPU* cpu, APEX_OoO* core)
+{
+  int used[APEX_UNIT_NUM] = { 0 };
+  int issued = 0;
+  int i = 0;
+  while (i < core->iq_count && issued < core->width)
+  {
+    int index = core->iq[i];
+    OoO_Entry* entry = &core->rob[index];
+    int unit = opcode_info[entry->ins.opcode].unit;
+    if (!operands_ready(cpu, core, entry) ||
+        used[unit] == APEX_unit_limit(&cpu->config, unit) ||
+        ((opcode_info[entry->ins.opcode].flags & OPF_LOAD) &&
+         !older_stores_issued(core, entry)))
+    {
+      i++;
+      continue;
+    }
+
+    used[unit]++;
+    issued++;
+    core->iq_count--;
+    memmove(&core->iq[i], &core->iq[i + 1],
+            (core->iq_count - i) * sizeof(core->iq[0]));
+    ooo_execute(cpu, core, entry);
+    if (cpu->enable_debug_messages)
+    {
+      print_stage_content(cpu, "Issue", &entry->ins);
+    }
+    if (entry->next_pc != entry->predicted_pc)
+    {
+      ooo_squash(cpu, core, index);
+      break;
+    }
+  }
+  return issued;
+}
+
+/* Points an architectural register at the physical register an
+ * instruction wrote, freeing the one it replaces once nothing maps to it */
+static void
+commit_mapping(APEX_OoO* core, int reg, int dest)
+{
+  int old = core->committed_map[reg];
+  core->committed_map[reg] = dest;
+  core->refs[dest]++;
+  if (--core->refs[old] == 0)
+  {
+    core->free_regs[core->free_count++] = old;
+  }
+}
+
+/*
+ * Commits up to the width of finished instructions from the head of the
+ * ROB. Stores write data memory here, behind a store buffer that hides
+ * the data cache. Branches update the predictor and the branch counters,
+ * so wrong-path branches are never counted. A load or store outside data
+ * memory, or HALT, commits nothing after it.
+ * Returns the number of instructions committed.
+ */
+static int
+ooo_commit(APEX_CPU* cpu, APEX_OoO* core)
+{
+  int committed = 0;
+  while (committed < core->width && core->rob_count)
+  {
+    OoO_Entry* entry = &core->rob[core->rob_head];
+    CPU_Stage* ins = &entry->ins;
+    int flags = opcode_info[ins->opcode].flags;
+    if (!entry->issued || entry->done_cycle > cpu->clock)
+    {
+      break;
+    }
+
+    if ((flags & OPF_STORE) && !entry->fault)
+    {
+      entry->fault = APEX_data_store(&cpu->data_memory, ins->mem_address,
+                                     ins->rs1_value) != 0;
+      if (!entry->fault && cpu->config.dcache.sets)
+      {
+        APEX_dcache_access(cpu, ins->mem_address, 1);
+      }
+    }
+    if (entry->fault)
+    {
+      cpu->data_fault = 1;
+      cpu->fault_pc = ins->pc;
+      cpu->fault_address = ins->mem_address;
+      core->commit_pc = ins->pc;
+      break;
+    }
+
+    if (entry->dest >= 0)
+    {
+      commit_mapping(core, ins->rd, entry->dest);
+      if (flags & OPF_SETS_Z)
+      {
+        commit_mapping(core, Z_REG, entry->dest);
+      }
+    }
+    if (flags & OPF_CONTROL)
+    {
+      int target = ins->opcode == OPCODE_JUMP ? entry->next_pc
+                                              : APEX_add(ins->pc, ins->imm);
+      APEX_predictor_update(cpu, ins->pc, ins->opcode, entry->taken, target);
+      APEX_Branch_Stats* branch = &cpu->branch_stats[get_code_index(ins->pc)];
+      branch->executed++;
+      branch->taken += entry->taken;
+      cpu->stats.branches++;
+      if (entry->next_pc != entry->predicted_pc)
+      {
+        branch->mispredicted++;
+        cpu->stats.mispredicted++;
+      }
+    }
+    if (flags & (OPF_LOAD | OPF_STORE))
+    {
+      core->lsq_head = (core->lsq_head + 1) % core->size[APEX_OOO_LSQ];
+      core->lsq_count--;
+    }
+    if (ins->opcode != OPCODE_NONE)
+    {
+      cpu->ins_completed++;
+      cpu->stats.retired++;
+    }
+    if (cpu->enable_debug_messages)
+    {
+      print_stage_content(cpu, "Commit", ins);
+    }
+
+    core->commit_pc = entry->next_pc;
+    core->rob_head = (core->rob_head + 1) % core->size[APEX_OOO_ROB];
+    core->rob_count--;
+    committed++;
+    if (ins->opcode == OPCODE_HALT)
+    {
+      cpu->halt_flag = 1;
+      core->commit_pc = ins->pc;
+      break;
+    }
+  }
+  return committed;
+}
+
+/*
+ * Charges a cycle to the instructions committed in it, or to why none
+ * was: an empty ROB refilling behind a mispredicted branch or waiting on
+ * fetch, a load at its head waiting on a data cache miss, or an oldest
+ * instruction still waiting on its operands or its result.
+ */
+static int
+cycle_cause(APEX_CPU* cpu, const APEX_OoO* core, int committed)
+{
+  if (committed)
+  {
+    return APEX_CPI_BASE;
+  }
+  if (cpu->data_fault)
+  {
+    return APEX_CPI_HALT;
+  }
+  if (!core->rob_count)
+  {
+    return core->recovering ? APEX_CPI_BRANCH : APEX_CPI_FETCH;
+  }
+  return core->rob[core->rob_head].missed ? APEX_CPI_DCACHE : APEX_CPI_RAW;
+}
+
+/* Leaves the committed state in the cpu. Registers with a younger write
+ * still in the ROB are marked busy, as the pipeline's scoreboard would */
+static void
+ooo_finish(APEX_CPU* cpu, APEX_OoO* core)
+{
+  cpu->scoreboard.busy = 0;
+  for (int i = 0; i < 16; ++i)
+  {
+    cpu->regs[i] = core->values[core->committed_map[i]];
+    if (core->map[i] != core->committed_map[i])
+    {
+      cpu->scoreboard.busy |= 1u << i;
+    }
+  }
+  cpu->z_flag_set = core->values[core->committed_map[Z_REG]] == 0;
+  cpu->pc = core->commit_pc;
+}
+
+/*
+ *  Out-of-order simulation loop, resuming where the previous one stopped. Every cycle commits, issues, renames
+ *  and fetches, in that order, so an instruction fetched in one cycle is
+ *  renamed in the next, can issue in the one after and commits once its
+ *  result is ready. The run ends at the cycle limit, when HALT commits,
+ *  at a faulting load or store, or once fetch has left the program and
+ *  everything fetched has committed.
+ *
+ *  Returns 0, or -1 if the core cannot be allocated.
+ */
+int
+APEX_ooo_run(APEX_CPU* cpu)
+{
+  APEX_OoO* core = cpu->ooo;
+  if (!core)
+  {
+    core = calloc(1, sizeof(*core));
+    if (!core)
+    {
+      return -1;
+    }
+    ooo_init(cpu, core);
+    cpu->ooo = core;
+  }
+
+  while (!cpu->halt_flag && !cpu->data_fault)
+  {
+    if (cpu->clock == cpu->clockcycles ||
+        (core->fetch_state == FETCH_END && !core->fetch_count &&
+         !core->rob_count))
+    {
+      cpu->reached_end = 1;
+      break;
+    }
+
+    ++cpu->clock;
+    if (cpu->enable_debug_messages)
+    {
+      APEX_cpu_printf(cpu, "--------------------------------\n");
+      APEX_cpu_printf(cpu, "Clock Cycle #: %d\n", cpu->clock);
+      APEX_cpu_printf(cpu, "--------------------------------\n");
+    }
+
+    int committed = ooo_commit(cpu, core);
+    int issued = 0;
+    if (committed)
+    {
+      core->recovering = 0;
+    }
+    if (!cpu->halt_flag && !cpu->data_fault)
+    {
+      issued = ooo_issue(cpu, core);
+      ooo_rename(cpu, core);
+      ooo_fetch(cpu, core);
+    }
+
+    cpu->stats.cycles[cycle_cause(cpu, core, committed)]++;
+    cpu->stats.issued[issued]++;
+    cpu->stats.ooo_occupancy[APEX_OOO_ROB] += core->rob_count;
+    cpu->stats.ooo_occupancy[APEX_OOO_IQ] += core->iq_count;
+    cpu->stats.ooo_occupancy[APEX_OOO_LSQ] += core->lsq_count;
+    cpu->stats.ooo_occupancy[APEX_OOO_REGS] +=
+        core->size[APEX_OOO_REGS] - core->free_count;
+  }
+
+  ooo_finish(cpu, core);
+  return 0;
+}
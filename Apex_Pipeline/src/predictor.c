@@ -0,0 +1,109 @@
+/*
+ *  predictor.c
+ *  Contains the branch prediction unit used by the fetch stage: a
+ *  direction predictor for BZ and BNZ and a branch target buffer for JUMP
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <string.h>
+
+#include "cpu.h"
+
+const char* const predictor_names[APEX_PREDICT_NUM] = {
+  [APEX_PREDICT_STATIC]  = "static",
+  [APEX_PREDICT_BIMODAL] = "bimodal",
+  [APEX_PREDICT_GSHARE]  = "gshare",
+};
+
+/* Counters start weakly not taken, the BTB starts empty */
+void
+APEX_predictor_reset(APEX_Predictor* predictor)
+{
+  predictor->history = 0;
+  memset(predictor->counters, 1, sizeof(predictor->counters));
+  memset(predictor->btb, 0, sizeof(predictor->btb));
+}
+
+/* Counter of a conditional branch, by pc alone or hashed with the
+ * global history */
+static uint8_t*
+counter_of(APEX_CPU* cpu, int pc)
+{
+  uint32_t index = (uint32_t)pc >> 2;
+  if (cpu->config.predictor == APEX_PREDICT_GSHARE)
+  {
+    index ^= cpu->predictor.history;
+  }
+  return &cpu->predictor.counters[index & (APEX_BHT_ENTRIES - 1)];
+}
+
+/* Direct mapped, tagged with the full pc; NULL without a BTB */
+static APEX_BTB_Entry*
+btb_entry_of(APEX_CPU* cpu, int pc)
+{
+  if (!cpu->config.btb_entries)
+  {
+    return NULL;
+  }
+  uint32_t index = ((uint32_t)pc >> 2) & (cpu->config.btb_entries - 1);
+  return &cpu->predictor.btb[index];
+}
+
+/*
+ * Predicts the pc fetched after the control instruction ins at pc.
+ * BZ and BNZ carry their target, so only their direction is predicted;
+ * a JUMP is followed to the target the BTB last saw it take, or falls
+ * through on a BTB miss.
+ */
+int
+APEX_predict_next_pc(APEX_CPU* cpu, const APEX_Instruction* ins, int pc)
+{
+  if (ins->opcode == OPCODE_JUMP)
+  {
+    APEX_BTB_Entry* entry = btb_entry_of(cpu, pc);
+    return (entry && entry->pc == pc) ? entry->target : pc + 4;
+  }
+  if (cpu->config.predictor != APEX_PREDICT_STATIC &&
+      *counter_of(cpu, pc) >= 2)
+  {
+    return APEX_add(pc, ins->imm);
+  }
+  return pc + 4;
+}
+
+/*
+ * Trains the predictor with a branch resolved in Execute 1. The global
+ * history is updated at resolution, so a branch fetched while an older
+ * one is still in flight is predicted with a history one outcome short.
+ */
+void
+APEX_predictor_update(APEX_CPU* cpu, int pc, int opcode, int taken, int target)
+{
+  if (opcode == OPCODE_JUMP)
+  {
+    APEX_BTB_Entry* entry = btb_entry_of(cpu, pc);
+    if (entry)
+    {
+      entry->pc = pc;
+      entry->target = target;
+    }
+    return;
+  }
+
+  if (cpu->config.predictor == APEX_PREDICT_STATIC)
+  {
+    return;
+  }
+  uint8_t* counter = counter_of(cpu, pc);
+  if (taken && *counter < 3)
+  {
+    ++*counter;
+  }
+  else if (!taken && *counter > 0)
+  {
+    --*counter;
+  }
+  cpu->predictor.history = (cpu->predictor.history << 1) | (taken != 0);
+}
@@ -0,0 +1,189 @@
+/*
+ *  profile.c
+ *  Contains the per-instruction profile of the in-order pipeline: how
+ *  often each code memory entry was fetched, retired and squashed and
+ *  how many cycles it waited in decode and why, printed as an annotated
+ *  listing of the program
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+
+const char* const stall_names[APEX_STALL_NUM] = {
+  [APEX_STALL_RAW]   = "raw",
+  [APEX_STALL_WAW]   = "waw",
+  [APEX_STALL_UNIT]  = "unit",
+  [APEX_STALL_ORDER] = "order",
+  [APEX_STALL_HELD]  = "held",
+};
+
+/* Starts counting from zero. Returns 0, or -1 out of memory */
+int
+APEX_profile_enable(APEX_CPU* cpu)
+{
+  free(cpu->profile);
+  cpu->profile = calloc(cpu->code_memory_size ? cpu->code_memory_size : 1,
+                        sizeof(APEX_Profile_Entry));
+  return cpu->profile ? 0 : -1;
+}
+
+/* True for a latch slot that holds an instruction decode has not issued
+ * yet. Decode leaves the instructions that issued in its latch until
+ * fetch overwrites them, but those carry an issue number */
+static int
+waiting(const APEX_CPU* cpu, const CPU_Stage* slot)
+{
+  int index = get_code_index(slot->pc);
+  return slot->opcode != OPCODE_NONE && slot->opcode != OPCODE_EMPTY &&
+         !slot->seq && index >= 0 && index < cpu->code_memory_size;
+}
+
+/*
+ * Called by a mispredicted branch before it clears the latches of fetch
+ * and decode. Fetch hands its latch on to decode in the cycle it fills
+ * it, so it only holds instructions of its own while decode stalls.
+ */
+void
+APEX_profile_squash(APEX_CPU* cpu)
+{
+  for (int i = 0; i < cpu->config.width; ++i)
+  {
+    const CPU_Stage* slot = &cpu->stage[DRF][i];
+    if (waiting(cpu, slot))
+    {
+      cpu->profile[get_code_index(slot->pc)].squashed++;
+    }
+    slot = &cpu->stage[F][i];
+    if (cpu->stage[F][0].stalled && waiting(cpu, slot))
+    {
+      cpu->profile[get_code_index(slot->pc)].squashed++;
+    }
+  }
+}
+
+/*
+ * Charges a stall cycle to every instruction other than HALT left
+ * waiting in the decode latch once decode has run, or that it could
+ * not reach because a later stage held it. The oldest waiting
+ * instruction is in slot 0 and is the one that stalled, the rest wait
+ * behind it.
+ */
+void
+APEX_profile_decode(APEX_CPU* cpu, int held)
+{
+  const CPU_Stage* slots = cpu->stage[DRF];
+  const APEX_Scoreboard* scoreboard = &cpu->scoreboard;
+  held |= slots[0].busy;
+  for (int i = 0; i < cpu->config.width; ++i)
+  {
+    const CPU_Stage* slot = &slots[i];
+    if (!waiting(cpu, slot) || slot->opcode == OPCODE_HALT)
+    {
+      continue;
+    }
+
+    int cause = APEX_STALL_HELD;
+    if (!held && i > 0)
+    {
+      cause = APEX_STALL_ORDER;
+    }
+    else if (!held && (scoreboard->busy & slot->src_mask))
+    {
+      cause = APEX_STALL_RAW;
+    }
+    else if (!held && (scoreboard->busy & slot->dst_mask))
+    {
+      cause = APEX_STALL_WAW;
+    }
+    else if (!held && slot->stalled)
+    {
+      cause = APEX_STALL_UNIT;
+    }
+    cpu->profile[get_code_index(slot->pc)].stalled[cause]++;
+  }
+}
+
+/*
+ * Prints the program one instruction per line, in code memory order,
+ * each with its counts and its share of all the decode stall cycles,
+ * left blank where it has none, so the costly instructions of a loop
+ * stand out next to their neighbours. A line starting with '>' is where
+ * a taken branch or JUMP landed.
+ */
+void
+APEX_profile_print(APEX_CPU* cpu)
+{
+  const APEX_Profile_Entry* profile = cpu->profile;
+  if (!profile)
+  {
+    return;
+  }
+
+  long long totals[APEX_STALL_NUM] = { 0 };
+  long long stalls = 0;
+  long long fetched = 0;
+  long long squashed = 0;
+  for (int i = 0; i < cpu->code_memory_size; ++i)
+  {
+    fetched += profile[i].fetched;
+    squashed += profile[i].squashed;
+    for (int cause = 0; cause < APEX_STALL_NUM; ++cause)
+    {
+      totals[cause] += profile[i].stalled[cause];
+      stalls += profile[i].stalled[cause];
+    }
+  }
+
+  APEX_cpu_printf(cpu, "==================PROFILE==============\n");
+  APEX_cpu_printf(cpu, " | cycles=%d | fetched=%lld | retired=%lld | squashed=%lld |"
+                  " decode stalls=%lld |\n",
+                  cpu->clock, fetched, cpu->stats.retired, squashed, stalls);
+  APEX_cpu_printf(cpu, " %7s %10s %10s %9s |", "stall%", "fetched", "retired", "squashed");
+  for (int cause = 0; cause < APEX_STALL_NUM; ++cause)
+  {
+    APEX_cpu_printf(cpu, " %8s", stall_names[cause]);
+  }
+  APEX_cpu_printf(cpu, " |   pc      instruction\n");
+
+  for (int i = 0; i < cpu->code_memory_size; ++i)
+  {
+    const APEX_Profile_Entry* entry = &profile[i];
+    long long stalled = 0;
+    for (int cause = 0; cause < APEX_STALL_NUM; ++cause)
+    {
+      stalled += entry->stalled[cause];
+    }
+    if (stalled)
+    {
+      APEX_cpu_printf(cpu, " %6.2f%%", 100.0 * stalled / stalls);
+    }
+    else
+    {
+      APEX_cpu_printf(cpu, " %7s", "");
+    }
+    APEX_cpu_printf(cpu, " %10lld %10lld %9lld |", entry->fetched, entry->retired,
+                    entry->squashed);
+    for (int cause = 0; cause < APEX_STALL_NUM; ++cause)
+    {
+      APEX_cpu_printf(cpu, " %8lld", entry->stalled[cause]);
+    }
+    /* Targets of taken branches and JUMPs get a mark like perf
+     * annotate's jump arrows */
+    char text[APEX_INSTRUCTION_TEXT];
+    APEX_format_instruction(text, sizeof(text), &cpu->code_memory[i]);
+    APEX_cpu_printf(cpu, " | %c %d:  %s\n", entry->branched_to ? '>' : ' ',
+                    4000 + 4 * i, text);
+  }
+
+  APEX_cpu_printf(cpu, " %7s %10s %10s %9s |", "", "", "", "");
+  for (int cause = 0; cause < APEX_STALL_NUM; ++cause)
+  {
+    APEX_cpu_printf(cpu, " %8lld", totals[cause]);
+  }
+  APEX_cpu_printf(cpu, " | total\n");
+}
@@ -0,0 +1,397 @@
+/*
+ *  threaded.c
+ *  Contains the threaded-code interpreter used to fast-forward a program
+ *  where it is not translated: code memory is decoded once into basic
+ *  blocks of handler records, and each handler jumps straight to the
+ *  next one through a computed goto instead of a switch
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+#if defined(__GNUC__)
+
+/* Instructions per block */
+#define BLOCK_INSTRUCTIONS  64
+
+/* A decoded instruction */
+typedef struct Op
+{
+  const void* handler;
+  int32_t imm;        // Literal, or the target pc of BZ and BNZ
+  uint8_t rd;
+  uint8_t rs1;
+  uint8_t rs2;
+  uint8_t rs3;
+} Op;
+
+/* Decoded instructions from pc up to the first BZ, BNZ or JUMP, or else
+ * followed by a record that leaves for the next pc */
+typedef struct Block
+{
+  int pc;
+  int count;                // Instructions, without that last record
+  struct Block* next[2];    // Taken and not taken successors once known
+  Op ops[];
+} Block;
+
+struct APEX_Threaded
+{
+  Block** blocks;   // Block starting at each code memory index, or NULL
+  int stop_pc;      // Blocks end before it
+};
+
+/* Handlers other than those of the opcodes */
+enum
+{
+  HANDLER_NEXT = NUM_OPCODES,   // Leave the block for the next pc
+  NUM_HANDLERS
+};
+
+/* Forgets every block */
+static void
+flush(APEX_Threaded* t, int size)
+{
+  for (int i = 0; i < size; ++i)
+  {
+    free(t->blocks[i]);
+    t->blocks[i] = NULL;
+  }
+}
+
+/* Whether the instruction can be part of a block */
+static int
+decodable(const APEX_Instruction* ins)
+{
+  return ins->opcode != OPCODE_HALT && ins->rd < 16 && ins->rs1 < 16 &&
+         ins->rs2 < 16 && ins->rs3 < 16;
+}
+
+/*
+ * Block at pc, decoded with the handlers on first use. Returns NULL for
+ * stop_pc, HALT, a pc outside code memory or an odd one, or when out of
+ * memory, all of which are left to APEX_cpu_interpret.
+ */
+static Block*
+block_at(APEX_Threaded* t, const APEX_CPU* cpu, int pc,
+         const void* const* handlers)
+{
+  unsigned int start = (unsigned int)(pc - 4000) >> 2;
+  int size = cpu->code_memory_size;
+  if (pc < 4000 || (pc & 3) || start >= (unsigned int)size ||
+      pc == t->stop_pc)
+  {
+    return NULL;
+  }
+  if (t->blocks[start])
+  {
+    return t->blocks[start];
+  }
+  if (!decodable(&cpu->code_memory[start]))
+  {
+    return NULL;
+  }
+
+  Block* block = malloc(sizeof(*block) +
+                        (BLOCK_INSTRUCTIONS + 1) * sizeof(Op));
+  if (!block)
+  {
+    return NULL;
+  }
+  block->pc = pc;
+  block->next[0] = NULL;
+  block->next[1] = NULL;
+
+  int n = 0;
+  for (;;)
+  {
+    unsigned int index = start + n;
+    int ins_pc = pc + 4 * n;
+    Op* op = &block->ops[n];
+    if (n == BLOCK_INSTRUCTIONS || index >= (unsigned int)size ||
+        ins_pc == t->stop_pc || !decodable(&cpu->code_memory[index]))
+    {
+      op->handler = handlers[HANDLER_NEXT];
+      op->imm = ins_pc;
+      break;
+    }
+
+    const APEX_Instruction* ins = &cpu->code_memory[index];
+    op->handler = handlers[ins->opcode];
+    op->imm = ins->imm;
+    op->rd = ins->rd;
+    op->rs1 = ins->rs1;
+    op->rs2 = ins->rs2;
+    op->rs3 = ins->rs3;
+    n++;
+    if (ins->opcode == OPCODE_BZ || ins->opcode == OPCODE_BNZ)
+    {
+      op->imm = APEX_add(ins_pc, ins->imm);
+      break;
+    }
+    if (ins->opcode == OPCODE_JUMP)
+    {
+      break;
+    }
+  }
+  block->count = n;
+  t->blocks[start] = block;
+  return block;
+}
+
+/*
+ * Executes instructions like APEX_cpu_interpret, with the same stopping
+ * rules, through decoded blocks. Registers and Z stay in locals until the
+ * run stops. Returns the number executed, or -1 without executing any if
+ * the block table cannot be allocated.
+ */
+long long
+APEX_cpu_threaded(APEX_CPU* cpu, int stop_pc, long long max_instructions)
+{
+  static const void* const handlers[NUM_HANDLERS] = {
+    [OPCODE_NONE]  = &&op_nop,
+    [OPCODE_STORE] = &&op_store,
+    [OPCODE_STR]   = &&op_str,
+    [OPCODE_LOAD]  = &&op_load,
+    [OPCODE_LDR]   = &&op_ldr,
+    [OPCODE_MOVC]  = &&op_movc,
+    [OPCODE_ADD]   = &&op_add,
+    [OPCODE_ADDL]  = &&op_addl,
+    [OPCODE_SUB]   = &&op_sub,
+    [OPCODE_SUBL]  = &&op_subl,
+    [OPCODE_MUL]   = &&op_mul,
+    [OPCODE_AND]   = &&op_and,
+    [OPCODE_OR]    = &&op_or,
+    [OPCODE_EXOR]  = &&op_exor,
+    [OPCODE_BZ]    = &&op_bz,
+    [OPCODE_BNZ]   = &&op_bnz,
+    [OPCODE_JUMP]  = &&op_jump,
+    [OPCODE_HALT]  = &&op_nop,
+    [OPCODE_EMPTY] = &&op_nop,
+    [HANDLER_NEXT] = &&op_next,
+  };
+
+  APEX_Threaded* t = cpu->threaded;
+  if (!t)
+  {
+    t = calloc(1, sizeof(*t));
+    if (!t || !(t->blocks = calloc(cpu->code_memory_size + 1,
+                                   sizeof(*t->blocks))))
+    {
+      free(t);
+      return -1;
+    }
+    t->stop_pc = -1;
+    cpu->threaded = t;
+  }
+  if (t->stop_pc != stop_pc)
+  {
+    flush(t, cpu->code_memory_size);
+    t->stop_pc = stop_pc;
+  }
+
+  int regs[16];
+  memcpy(regs, cpu->regs, sizeof(regs));
+  int z = cpu->z_flag_set;
+  int pc = cpu->pc;
+  long long budget = max_instructions;
+  APEX_Data_Memory* data_memory = &cpu->data_memory;
+  Block* block;
+  const Op* op;
+  int way;      // Successor followed, 0 for a taken branch or the only one
+
+#define NEXT    do { op++; goto *op->handler; } while (0)
+
+  while (budget > 0 && pc != stop_pc)
+  {
+    block = block_at(t, cpu, pc, handlers);
+    if (!block)
+    {
+      goto interpret;
+    }
+
+enter:
+    if (block->count > budget)
+    {
+      goto interpret;
+    }
+    budget -= block->count;
+    op = block->ops;
+    goto *op->handler;
+
+op_nop:
+    NEXT;
+
+op_store:
+    if (APEX_data_store(data_memory, APEX_add(regs[op->rs2], op->imm), regs[op->rs1]))
+    {
+      goto fault;
+    }
+    NEXT;
+
+op_str:
+    if (APEX_data_store(data_memory, APEX_add(regs[op->rs2], regs[op->rs3]),
+                        regs[op->rs1]))
+    {
+      goto fault;
+    }
+    NEXT;
+
+op_load:
+    if (APEX_data_load(data_memory, APEX_add(regs[op->rs1], op->imm), &regs[op->rd]))
+    {
+      goto fault;
+    }
+    NEXT;
+
+op_ldr:
+    if (APEX_data_load(data_memory, APEX_add(regs[op->rs1], regs[op->rs2]),
+                       &regs[op->rd]))
+    {
+      goto fault;
+    }
+    NEXT;
+
+op_movc:
+    regs[op->rd] = op->imm;
+    NEXT;
+
+op_add:
+    regs[op->rd] = APEX_add(regs[op->rs1], regs[op->rs2]);
+    z = (regs[op->rd] == 0);
+    NEXT;
+
+op_addl:
+    regs[op->rd] = APEX_add(regs[op->rs1], op->imm);
+    z = (regs[op->rd] == 0);
+    NEXT;
+
+op_sub:
+    regs[op->rd] = APEX_sub(regs[op->rs1], regs[op->rs2]);
+    z = (regs[op->rd] == 0);
+    NEXT;
+
+op_subl:
+    regs[op->rd] = APEX_sub(regs[op->rs1], op->imm);
+    z = (regs[op->rd] == 0);
+    NEXT;
+
+op_mul:
+    regs[op->rd] = APEX_mul(regs[op->rs1], regs[op->rs2]);
+    z = (regs[op->rd] == 0);
+    NEXT;
+
+op_and:
+    regs[op->rd] = regs[op->rs1] & regs[op->rs2];
+    NEXT;
+
+op_or:
+    regs[op->rd] = regs[op->rs1] | regs[op->rs2];
+    NEXT;
+
+op_exor:
+    regs[op->rd] = regs[op->rs1] ^ regs[op->rs2];
+    NEXT;
+
+op_bz:
+    way = !z;
+    goto branch;
+
+op_bnz:
+    way = (z != 0);
+    goto branch;
+
+op_jump:
+    /* Computed, so looked up every time */
+    pc = APEX_add(regs[op->rs1], op->imm);
+    continue;
+
+op_next:
+    pc = op->imm;
+    way = 0;
+    goto follow;
+
+branch:
+    pc = way ? block->pc + 4 * block->count : op->imm;
+
+follow:
+    /* Successors are remembered, stop_pc never starts a block */
+    if (!block->next[way])
+    {
+      block->next[way] = block_at(t, cpu, pc, handlers);
+      if (!block->next[way])
+      {
+        continue;
+      }
+    }
+    block = block->next[way];
+    goto enter;
+
+fault:
+    /* Stop before the load or store, which the pipeline reports */
+    budget += block->count - (op - block->ops);
+    pc = block->pc + 4 * (int)(op - block->ops);
+    break;
+
+interpret:
+    /* HALT, an odd pc or one outside code memory, or too few
+     * instructions left for the block */
+    memcpy(cpu->regs, regs, sizeof(regs));
+    cpu->z_flag_set = z;
+    cpu->pc = pc;
+    long long executed = APEX_cpu_interpret(
+        cpu, stop_pc, block ? budget : 1);
+    memcpy(regs, cpu->regs, sizeof(regs));
+    z = cpu->z_flag_set;
+    pc = cpu->pc;
+    budget -= executed;
+    if (!executed || block)
+    {
+      break;
+    }
+  }
+
+#undef NEXT
+
+  memcpy(cpu->regs, regs, sizeof(regs));
+  cpu->z_flag_set = z;
+  cpu->pc = pc;
+  return max_instructions - budget;
+}
+
+void
+APEX_threaded_free(APEX_Threaded* t, int size)
+{
+  if (t)
+  {
+    flush(t, size);
+    free(t->blocks);
+    free(t);
+  }
+}
+
+#else
+
+/* Without computed goto fast-forward interprets */
+long long
+APEX_cpu_threaded(APEX_CPU* cpu, int stop_pc, long long max_instructions)
+{
+  (void)cpu;
+  (void)stop_pc;
+  (void)max_instructions;
+  return -1;
+}
+
+void
+APEX_threaded_free(APEX_Threaded* t, int size)
+{
+  (void)t;
+  (void)size;
+}
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ *  trace.c
+ *  Contains the binary pipeline trace. The simulation loop copies one
+ *  record per cycle into a lock-free ring buffer and a writer thread
+ *  encodes and writes the records, so tracing costs the simulator a
+ *  few stores per cycle instead of formatted output
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "cpu.h"
+
+/* Records in the ring buffer, a power of two */
+#define APEX_TRACE_RING_SIZE  8192
+
+/* Records encoded per write by the writer thread */
+#define APEX_TRACE_BATCH      256
+
+/* Trace file and ring buffer shared by the simulator and the writer */
+struct APEX_Trace
+{
+  FILE* fp;
+  pthread_t writer;
+  int width;    // Slots of every stage written per record
+
+  /* Single producer, single consumer: head is only written by the
+   * simulator, tail only by the writer thread */
+  _Atomic size_t head;
+  _Atomic size_t tail;
+  _Atomic int done;
+
+  int failed;   // Set by the writer if the file could not be written
+  APEX_Trace_Record ring[APEX_TRACE_RING_SIZE];
+};
+
+static uint8_t*
+put_le32(uint8_t* out, uint32_t value)
+{
+  for (int i = 0; i < 4; ++i)
+  {
+    *out++ = value >> (8 * i);
+  }
+  return out;
+}
+
+/* Fixed width little endian layout, see APEX_TRACE_RECORD_BYTES */
+static void
+encode_record(uint8_t* out, const APEX_Trace_Record* record, int width)
+{
+  out = put_le32(out, record->clock);
+  for (int i = 0; i < NUM_STAGES; ++i)
+  {
+    for (int j = 0; j < width; ++j)
+    {
+      out = put_le32(out, record->stage[i][j].pc);
+      *out++ = record->stage[i][j].opcode;
+      *out++ = record->stage[i][j].state;
+    }
+  }
+}
+
+/* Waits briefly for the other side of the ring buffer */
+static void
+trace_backoff(int* spins)
+{
+  if (++*spins < 64)
+  {
+    sched_yield();
+  }
+  else
+  {
+    struct timespec delay = { 0, 50000 };
+    nanosleep(&delay, NULL);
+  }
+}
+
+/* Drains the ring buffer into the trace file until the trace is closed */
+static void*
+trace_writer(void* arg)
+{
+  APEX_Trace* trace = arg;
+  size_t record_bytes = APEX_TRACE_RECORD_BYTES(trace->width);
+  uint8_t buffer[APEX_TRACE_BATCH * APEX_TRACE_RECORD_BYTES(APEX_MAX_WIDTH)];
+  int spins = 0;
+
+  while (1)
+  {
+    size_t tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
+    if (head == tail)
+    {
+      if (atomic_load_explicit(&trace->done, memory_order_acquire) &&
+          head == atomic_load_explicit(&trace->head, memory_order_acquire))
+      {
+        break;
+      }
+      trace_backoff(&spins);
+      continue;
+    }
+    spins = 0;
+
+    size_t count = head - tail;
+    if (count > APEX_TRACE_BATCH)
+    {
+      count = APEX_TRACE_BATCH;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+      encode_record(&buffer[i * record_bytes],
+                    &trace->ring[(tail + i) & (APEX_TRACE_RING_SIZE - 1)],
+                    trace->width);
+    }
+    atomic_store_explicit(&trace->tail, tail + count, memory_order_release);
+
+    if (!trace->failed &&
+        fwrite(buffer, record_bytes, count, trace->fp) != count)
+    {
+      trace->failed = 1;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Creates the trace file, writes its header and starts the writer
+ * thread. Returns NULL if the file cannot be created.
+ */
+APEX_Trace*
+APEX_trace_open(const char* filename, const APEX_CPU* cpu)
+{
+  APEX_Trace* trace = malloc(sizeof(*trace));
+  if (!trace)
+  {
+    return NULL;
+  }
+  trace->fp = fopen(filename, "wb");
+  if (!trace->fp)
+  {
+    free(trace);
+    return NULL;
+  }
+  atomic_init(&trace->head, 0);
+  atomic_init(&trace->tail, 0);
+  atomic_init(&trace->done, 0);
+  trace->failed = 0;
+  trace->width = cpu->config.width;
+
+  uint8_t header[20];
+  uint8_t* out = put_le32(header, APEX_TRACE_MAGIC);
+  out = put_le32(out, APEX_TRACE_VERSION);
+  out = put_le32(out, NUM_STAGES);
+  out = put_le32(out, trace->width);
+  put_le32(out, cpu->code_memory_size);
+  if (fwrite(header, sizeof(header), 1, trace->fp) != 1 ||
+      pthread_create(&trace->writer, NULL, trace_writer, trace) != 0)
+  {
+    fclose(trace->fp);
+    free(trace);
+    return NULL;
+  }
+  return trace;
+}
+
+/*
+ * Queues what every stage works on in the current cycle. Called before
+ * the stages run, when each latch still holds the instructions its stage
+ * is about to process; fetch is about to read the group at pc.
+ */
+void
+APEX_trace_cycle(APEX_Trace* trace, const APEX_CPU* cpu)
+{
+  size_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+  int spins = 0;
+  while (head - atomic_load_explicit(&trace->tail, memory_order_acquire) ==
+         APEX_TRACE_RING_SIZE)
+  {
+    trace_backoff(&spins);
+  }
+
+  APEX_Trace_Record* record = &trace->ring[head & (APEX_TRACE_RING_SIZE - 1)];
+  record->clock = cpu->clock;
+  for (int i = 0; i < NUM_STAGES; ++i)
+  {
+    for (int j = 0; j < trace->width; ++j)
+    {
+      const CPU_Stage* stage = &cpu->stage[i][j];
+      record->stage[i][j].pc = stage->pc;
+      record->stage[i][j].opcode = stage->opcode;
+      record->stage[i][j].state = (stage->busy ? APEX_TRACE_BUSY : 0) |
+                                  (stage->stalled ? APEX_TRACE_STALLED : 0);
+    }
+  }
+  if (!cpu->stage[F][0].busy && !cpu->stage[F][0].stalled)
+  {
+    int count = APEX_fetch_group(cpu, cpu->pc);
+    for (int j = 0; j < count; ++j)
+    {
+      int index = get_code_index(cpu->pc + 4 * j);
+      record->stage[F][j].pc = cpu->pc + 4 * j;
+      record->stage[F][j].opcode = (index >= 0 && index < cpu->code_memory_size)
+                                       ? cpu->code_memory[index].opcode
+                                       : OPCODE_NONE;
+    }
+    for (int j = count; j < trace->width; ++j)
+    {
+      record->stage[F][j].pc = 0;
+      record->stage[F][j].opcode = OPCODE_EMPTY;
+    }
+  }
+  atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+/*
+ * Waits for the writer to drain the ring buffer and closes the file.
+ * Returns -1 if any record could not be written.
+ */
+int
+APEX_trace_close(APEX_Trace* trace)
+{
+  atomic_store_explicit(&trace->done, 1, memory_order_release);
+  pthread_join(trace->writer, NULL);
+
+  int failed = trace->failed || ferror(trace->fp);
+  if (fclose(trace->fp) != 0)
+  {
+    failed = 1;
+  }
+  free(trace);
+  return failed ? -1 : 0;
+}
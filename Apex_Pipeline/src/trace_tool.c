@@ -0,0 +1,164 @@
+/*
+ *  trace_tool.c
+ *  Contains 'apex_trace', which renders a binary pipeline trace written
+ *  by 'apex_sim --trace' as the per-cycle text view of simulate mode
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+
+/* Stages in the order simulate mode prints them */
+static const struct
+{
+  int stage;
+  const char* name;
+} stage_order[NUM_STAGES] = {
+  { WB,   "Writeback Stage" },
+  { MEM2, "Memory 2 Stage" },
+  { MEM1, "Memory 1 Stage" },
+  { EX2,  "Execute 2 Stage" },
+  { EX1,  "Execute 1 Stage" },
+  { DRF,  "Decode/RF Stage" },
+  { F,    "Fetch Stage" },
+};
+
+static int
+get_le32(FILE* fp, uint32_t* value)
+{
+  uint8_t bytes[4];
+  if (fread(bytes, 1, sizeof(bytes), fp) != sizeof(bytes))
+  {
+    return -1;
+  }
+  *value = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+  return 0;
+}
+
+/* Prints the instruction at pc as written in the input file */
+static void
+print_instruction(const APEX_Instruction* code_memory, int size, int pc,
+                  int opcode)
+{
+  int index = (pc - 4000) / 4;
+  if (pc < 4000 || index >= size || code_memory[index].opcode != opcode)
+  {
+    printf("%s", opcode == OPCODE_EMPTY ? "EMPTY" : opcode_info[opcode].name);
+    return;
+  }
+
+  char text[APEX_INSTRUCTION_TEXT];
+  APEX_format_instruction(text, sizeof(text), &code_memory[index]);
+  printf("%s", text);
+}
+
+int
+main(int argc, char const* argv[])
+{
+  if (argc < 3 || argc > 5)
+  {
+    fprintf(stderr, "APEX_Help : Usage %s <input_file> <trace_file> [<first_cycle> [<last_cycle>]]\n", argv[0]);
+    exit(1);
+  }
+  long first = argc > 3 ? atol(argv[3]) : 0;
+  long last = argc > 4 ? atol(argv[4]) : -1;
+
+  int size = 0;
+  size_t length = 0;
+  APEX_Instruction* code_memory;
+  if (is_code_image(argv[1]))
+  {
+    code_memory = map_code_image(argv[1], &size, &length);
+  }
+  else
+  {
+    code_memory = create_code_memory(argv[1], &size);
+  }
+  if (!code_memory)
+  {
+    fprintf(stderr, "APEX_Error : Unable to parse %s\n", argv[1]);
+    exit(1);
+  }
+
+  FILE* fp = fopen(argv[2], "rb");
+  if (!fp)
+  {
+    fprintf(stderr, "APEX_Error : Unable to read trace %s\n", argv[2]);
+    exit(1);
+  }
+
+  uint32_t magic, version, stages, width, trace_size;
+  if (get_le32(fp, &magic) || get_le32(fp, &version) ||
+      get_le32(fp, &stages) || get_le32(fp, &width) ||
+      get_le32(fp, &trace_size) ||
+      magic != APEX_TRACE_MAGIC || version != APEX_TRACE_VERSION ||
+      stages != NUM_STAGES || width < 1 || width > APEX_MAX_WIDTH)
+  {
+    fprintf(stderr, "APEX_Error : %s is not an APEX trace\n", argv[2]);
+    exit(1);
+  }
+  if (trace_size != (uint32_t)size)
+  {
+    fprintf(stderr, "APEX_Error : %s was recorded from a program of %u instructions\n",
+            argv[2], trace_size);
+    exit(1);
+  }
+
+  uint8_t raw[APEX_TRACE_RECORD_BYTES(APEX_MAX_WIDTH)];
+  while (fread(raw, APEX_TRACE_RECORD_BYTES(width), 1, fp) == 1)
+  {
+    const uint8_t* in = raw;
+    long clock = in[0] | in[1] << 8 | in[2] << 16 | (uint32_t)in[3] << 24;
+    if (clock < first)
+    {
+      continue;
+    }
+    if (last >= 0 && clock > last)
+    {
+      break;
+    }
+
+    printf("--------------------------------\n");
+    printf("Clock Cycle #: %ld\n", clock);
+    printf("--------------------------------\n");
+    for (int i = 0; i < NUM_STAGES; ++i)
+    {
+      /* Slot 0 stands for the latch, the others show only instructions */
+      in = raw + 4 + 6 * width * stage_order[i].stage;
+      if (in[5] & APEX_TRACE_BUSY)
+      {
+        continue;
+      }
+      for (uint32_t j = 0; j < width; ++j, in += 6)
+      {
+        int pc = (int32_t)(in[0] | in[1] << 8 | in[2] << 16 | (uint32_t)in[3] << 24);
+        int opcode = in[4];
+        int state = in[5];
+        if (opcode == OPCODE_NONE || opcode >= NUM_OPCODES ||
+            (j > 0 && opcode == OPCODE_EMPTY))
+        {
+          continue;
+        }
+
+        printf("%-15s: pc(%d) ", stage_order[i].name, pc);
+        print_instruction(code_memory, size, pc, opcode);
+        printf("%s\n", (state & APEX_TRACE_STALLED) ? " (stalled)" : "");
+      }
+    }
+  }
+
+  fclose(fp);
+  if (length)
+  {
+    unmap_code_image(code_memory, length);
+  }
+  else
+  {
+    free(code_memory);
+  }
+  return 0;
+}
@@ -0,0 +1,766 @@
+/*
+ *  translate.c
+ *  Contains the binary translator used to fast-forward a program: basic
+ *  blocks of code memory are compiled to x86-64 machine code on first
+ *  use, cached by start pc and chained to each other, so a loop runs
+ *  without returning to C. Anything the generated code does not handle
+ *  is left to the interpreter of functional.c one instruction at a time.
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+
+/* Code buffer, flushed whole when a block might not fit. It is never
+ * writable and executable at once: blocks are emitted and chained while
+ * it is writable, and it is made executable before any of them runs */
+#define CODE_BYTES          (4 << 20)
+
+/* Instructions per block, and the most bytes such a block can take */
+#define BLOCK_INSTRUCTIONS  64
+#define BLOCK_BYTES         (BLOCK_INSTRUCTIONS * 128 + 256)
+
+/* Architectural state the generated code works on, pointed to by rbx */
+typedef struct Guest
+{
+  int regs[16];
+  int z;                // 0 or 1, only the low byte is written
+  int pc;               // Next pc, stored by every exit
+  long long budget;     // Instructions still allowed
+} Guest;
+
+#define GUEST_Z       offsetof(Guest, z)
+#define GUEST_PC      offsetof(Guest, pc)
+#define GUEST_BUDGET  offsetof(Guest, budget)
+
+/* What the generated code returns: the exit kinds below, or else the
+ * address of the rel32 of a jump to chain to the block at the new pc */
+enum
+{
+  EXIT_LOOKUP,      // Continue at pc
+  EXIT_STEP,        // Interpret the instruction at pc
+  STUB_REFILL,      // Not returned: a stub that refills the last page
+};
+
+typedef void* (*Enter_Fn)(Guest* guest, const uint8_t* block);
+
+struct APEX_Translation
+{
+  uint8_t* code;
+  size_t used;
+  Enter_Fn enter;           // Saves rbx, points it at the guest, jumps
+  const uint8_t* epilogue;  // Restores rbx and returns
+  size_t reserved;          // Bytes of both, never flushed
+  uint8_t** blocks;         // Entry of the block at each code memory
+                            // index, or NULL
+  int* counts;              // Instructions in each block
+  int stop_pc;              // Blocks end before it
+  unsigned flushes;
+  int writable;             // The buffer is writable, else executable
+  int failed;               // mprotect failed, the buffer is not used again
+};
+
+/* Side exit to emit after the body of a block, once its length is known */
+typedef struct Exit_Stub
+{
+  uint8_t* site;    // rel32 jumping to the stub
+  int kind;         // EXIT_LOOKUP to chain, EXIT_STEP or STUB_REFILL
+  int pc;
+  int index;        // Instructions of the block done before it
+  int value_reg;    // STUB_REFILL: register a store writes, -1 for a load
+  uint8_t* resume;  // STUB_REFILL: where the access goes on
+} Exit_Stub;
+
+typedef struct Emitter
+{
+  uint8_t* p;
+  Exit_Stub stubs[2 * BLOCK_INSTRUCTIONS + 2];
+  int num_stubs;
+} Emitter;
+
+static void
+emit8(Emitter* e, int byte)
+{
+  *e->p++ = (uint8_t)byte;
+}
+
+static void
+emit32(Emitter* e, uint32_t value)
+{
+  memcpy(e->p, &value, 4);
+  e->p += 4;
+}
+
+static void
+emit64(Emitter* e, uint64_t value)
+{
+  memcpy(e->p, &value, 8);
+  e->p += 8;
+}
+
+/* Points the rel32 at site to target */
+static void
+patch_rel32(uint8_t* site, const uint8_t* target)
+{
+  int32_t rel = (int32_t)(target - (site + 4));
+  memcpy(site, &rel, 4);
+}
+
+/* Emits a jump or conditional jump whose rel32 goes to a stub */
+static Exit_Stub*
+emit_exit(Emitter* e, int jcc, int kind, int pc, int index)
+{
+  if (jcc)
+  {
+    emit8(e, 0x0f);
+    emit8(e, jcc);
+  }
+  else
+  {
+    emit8(e, 0xe9);
+  }
+  Exit_Stub* stub = &e->stubs[e->num_stubs++];
+  stub->site = e->p;
+  stub->kind = kind;
+  stub->pc = pc;
+  stub->index = index;
+  emit32(e, 0);
+  return stub;
+}
+
+/* op eax, [rbx + 4 * reg], with op one of mov, add, sub, and, or, xor */
+static void
+emit_reg_op(Emitter* e, int op, int reg)
+{
+  emit8(e, op);
+  emit8(e, 0x43);
+  emit8(e, reg * 4);
+}
+
+/* mov [rbx + 4 * reg], eax */
+static void
+emit_store_reg(Emitter* e, int reg)
+{
+  emit_reg_op(e, 0x89, reg);
+}
+
+/* test eax, eax; sete [rbx + z] */
+static void
+emit_set_z(Emitter* e)
+{
+  emit8(e, 0x85);
+  emit8(e, 0xc0);
+  emit8(e, 0x0f);
+  emit8(e, 0x94);
+  emit8(e, 0x43);
+  emit8(e, GUEST_Z);
+}
+
+/* add eax, imm */
+static void
+emit_add_imm(Emitter* e, int32_t imm)
+{
+  if (imm)
+  {
+    emit8(e, 0x05);
+    emit32(e, (uint32_t)imm);
+  }
+}
+
+/*
+ * Turns the address in eax into rdx + 4 * rax, the word in the last
+ * accessed page. Another page is refilled out of line, and an address
+ * below zero or a page that is missing takes a side exit, so that the
+ * interpreter faults or reads zero. value_reg is the register a store
+ * writes, -1 for a load.
+ */
+static void
+emit_data_address(Emitter* e, APEX_Data_Memory* memory, int pc, int index,
+                  int value_reg)
+{
+  emit8(e, 0x85);                       // test eax, eax
+  emit8(e, 0xc0);
+  emit_exit(e, 0x88, EXIT_STEP, pc, index);   // js
+  emit8(e, 0x89);                       // mov ecx, eax
+  emit8(e, 0xc1);
+  emit8(e, 0xc1);                       // shr ecx, APEX_PAGE_SHIFT
+  emit8(e, 0xe9);
+  emit8(e, APEX_PAGE_SHIFT);
+  emit8(e, 0x48);                       // mov rdx, memory
+  emit8(e, 0xba);
+  emit64(e, (uint64_t)(uintptr_t)memory);
+  emit8(e, 0x3b);                       // cmp ecx, [rdx + last_number]
+  emit8(e, 0x8a);
+  emit32(e, offsetof(APEX_Data_Memory, last_number));
+  Exit_Stub* refill = emit_exit(e, 0x85, STUB_REFILL, pc, index);  // jne
+  refill->value_reg = value_reg;
+  emit8(e, 0x48);                       // mov rdx, [rdx + last_page]
+  emit8(e, 0x8b);
+  emit8(e, 0x92);
+  emit32(e, offsetof(APEX_Data_Memory, last_page));
+  emit8(e, 0x25);                       // and eax, APEX_PAGE_WORDS - 1
+  emit32(e, APEX_PAGE_WORDS - 1);
+  refill->resume = e->p;
+}
+
+/*
+ * JUMP: stores the target pc and jumps straight to its block when there
+ * is one, through the table of blocks, or else returns to look it up.
+ */
+static void
+emit_jump(Emitter* e, APEX_Translation* t, int size, const APEX_Instruction* ins)
+{
+  emit_reg_op(e, 0x8b, ins->rs1);
+  emit_add_imm(e, ins->imm);
+  emit8(e, 0x89);                       // mov [rbx + pc], eax
+  emit8(e, 0x43);
+  emit8(e, GUEST_PC);
+  emit8(e, 0x2d);                       // sub eax, 4000
+  emit32(e, 4000);
+  emit8(e, 0xa8);                       // test al, 3
+  emit8(e, 0x03);
+  emit8(e, 0x75);                       // jnz miss
+  emit8(e, 28);
+  emit8(e, 0x3d);                       // cmp eax, 4 * size
+  emit32(e, 4u * size);
+  emit8(e, 0x73);                       // jae miss
+  emit8(e, 21);
+  emit8(e, 0x48);                       // mov rcx, blocks
+  emit8(e, 0xb9);
+  emit64(e, (uint64_t)(uintptr_t)t->blocks);
+  emit8(e, 0x48);                       // mov rcx, [rcx + 2 * rax]
+  emit8(e, 0x8b);
+  emit8(e, 0x0c);
+  emit8(e, 0x41);
+  emit8(e, 0x48);                       // test rcx, rcx
+  emit8(e, 0x85);
+  emit8(e, 0xc9);
+  emit8(e, 0x74);                       // jz miss
+  emit8(e, 2);
+  emit8(e, 0xff);                       // jmp rcx
+  emit8(e, 0xe1);
+  emit8(e, 0x31);                       // miss: xor eax, eax
+  emit8(e, 0xc0);
+  emit8(e, 0xe9);                       // jmp epilogue
+  emit32(e, 0);
+  patch_rel32(e->p - 4, t->epilogue);
+}
+
+/* Emits one instruction that does not end the block */
+static void
+emit_instruction(Emitter* e, APEX_CPU* cpu, const APEX_Instruction* ins,
+                 int pc, int index)
+{
+  switch (ins->opcode)
+  {
+    case OPCODE_MOVC:
+      emit8(e, 0xc7);                   // mov dword [rbx + 4 * rd], imm
+      emit8(e, 0x43);
+      emit8(e, ins->rd * 4);
+      emit32(e, (uint32_t)ins->imm);
+      break;
+
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_AND:
+    case OPCODE_OR:
+    case OPCODE_EXOR:
+    {
+      static const uint8_t op[NUM_OPCODES] = {
+        [OPCODE_ADD] = 0x03, [OPCODE_SUB] = 0x2b, [OPCODE_AND] = 0x23,
+        [OPCODE_OR] = 0x0b, [OPCODE_EXOR] = 0x33,
+      };
+      emit_reg_op(e, 0x8b, ins->rs1);
+      emit_reg_op(e, op[ins->opcode], ins->rs2);
+      emit_store_reg(e, ins->rd);
+      if (ins->opcode == OPCODE_ADD || ins->opcode == OPCODE_SUB)
+      {
+        emit_set_z(e);
+      }
+      break;
+    }
+
+    case OPCODE_MUL:
+      emit_reg_op(e, 0x8b, ins->rs1);
+      emit8(e, 0x0f);                   // imul eax, [rbx + 4 * rs2]
+      emit_reg_op(e, 0xaf, ins->rs2);
+      emit_store_reg(e, ins->rd);
+      emit_set_z(e);
+      break;
+
+    case OPCODE_ADDL:
+    case OPCODE_SUBL:
+      emit_reg_op(e, 0x8b, ins->rs1);
+      emit8(e, ins->opcode == OPCODE_ADDL ? 0x05 : 0x2d);
+      emit32(e, (uint32_t)ins->imm);
+      emit_store_reg(e, ins->rd);
+      emit_set_z(e);
+      break;
+
+    case OPCODE_LOAD:
+    case OPCODE_LDR:
+      emit_reg_op(e, 0x8b, ins->rs1);
+      if (ins->opcode == OPCODE_LOAD)
+      {
+        emit_add_imm(e, ins->imm);
+      }
+      else
+      {
+        emit_reg_op(e, 0x03, ins->rs2);
+      }
+      emit_data_address(e, &cpu->data_memory, pc, index, -1);
+      emit8(e, 0x8b);                   // mov eax, [rdx + 4 * rax]
+      emit8(e, 0x04);
+      emit8(e, 0x82);
+      emit_store_reg(e, ins->rd);
+      break;
+
+    case OPCODE_STORE:
+    case OPCODE_STR:
+      emit_reg_op(e, 0x8b, ins->rs2);
+      if (ins->opcode == OPCODE_STORE)
+      {
+        emit_add_imm(e, ins->imm);
+      }
+      else
+      {
+        emit_reg_op(e, 0x03, ins->rs3);
+      }
+      emit_data_address(e, &cpu->data_memory, pc, index, ins->rs1);
+      emit8(e, 0x8b);                   // mov ecx, [rbx + 4 * rs1]
+      emit8(e, 0x4b);
+      emit8(e, ins->rs1 * 4);
+      emit8(e, 0x89);                   // mov [rdx + 4 * rax], ecx
+      emit8(e, 0x0c);
+      emit8(e, 0x82);
+      break;
+
+    default:
+      /* No effect in the interpreter either */
+      break;
+  }
+}
+
+/* Switches the buffer between writable and executable. Returns 0, or
+ * -1 if mprotect fails, after which the buffer is left alone */
+static int
+set_writable(APEX_Translation* t, int writable)
+{
+  if (t->failed)
+  {
+    return -1;
+  }
+  if (t->writable != writable &&
+      mprotect(t->code, CODE_BYTES,
+               writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) != 0)
+  {
+    t->failed = 1;
+    return -1;
+  }
+  t->writable = writable;
+  return 0;
+}
+
+/* Forgets every block, with the chains between them */
+static void
+flush(APEX_Translation* t, int size)
+{
+  memset(t->blocks, 0, size * sizeof(*t->blocks));
+  t->used = t->reserved;
+  t->flushes++;
+}
+
+static APEX_Translation*
+translation_create(APEX_CPU* cpu)
+{
+  APEX_Translation* t = calloc(1, sizeof(*t));
+  if (!t)
+  {
+    return NULL;
+  }
+  t->blocks = calloc(cpu->code_memory_size + 1, sizeof(*t->blocks));
+  t->counts = calloc(cpu->code_memory_size + 1, sizeof(*t->counts));
+  t->code = mmap(NULL, CODE_BYTES, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (!t->blocks || !t->counts || t->code == MAP_FAILED)
+  {
+    if (t->code != MAP_FAILED)
+    {
+      munmap(t->code, CODE_BYTES);
+    }
+    free(t->blocks);
+    free(t->counts);
+    free(t);
+    return NULL;
+  }
+
+  /* r12 keeps an address across APEX_data_refill, and the stack stays
+   * aligned for that call */
+  Emitter e = { .p = t->code };
+  emit8(&e, 0x53);                      // push rbx
+  emit8(&e, 0x41);                      // push r12
+  emit8(&e, 0x54);
+  emit8(&e, 0x48);                      // sub rsp, 8
+  emit8(&e, 0x83);
+  emit8(&e, 0xec);
+  emit8(&e, 0x08);
+  emit8(&e, 0x48);                      // mov rbx, rdi
+  emit8(&e, 0x89);
+  emit8(&e, 0xfb);
+  emit8(&e, 0xff);                      // jmp rsi
+  emit8(&e, 0xe6);
+  t->epilogue = e.p;
+  emit8(&e, 0x48);                      // add rsp, 8
+  emit8(&e, 0x83);
+  emit8(&e, 0xc4);
+  emit8(&e, 0x08);
+  emit8(&e, 0x41);                      // pop r12
+  emit8(&e, 0x5c);
+  emit8(&e, 0x5b);                      // pop rbx
+  emit8(&e, 0xc3);                      // ret
+  t->enter = (Enter_Fn)(void*)t->code;
+  t->reserved = e.p - t->code;
+  t->used = t->reserved;
+  t->stop_pc = -1;
+  t->writable = 1;
+  return t;
+}
+
+/* Whether the instruction can be part of a block */
+static int
+translatable(const APEX_Instruction* ins)
+{
+  return ins->opcode != OPCODE_HALT && ins->rd < 16 && ins->rs1 < 16 &&
+         ins->rs2 < 16 && ins->rs3 < 16;
+}
+
+/*
+ * Compiles the block starting at pc: up to the first BZ, BNZ or JUMP,
+ * or else up to stop_pc, HALT, the end of code memory or the most
+ * instructions a block takes. Returns NULL if the first instruction
+ * cannot start a block, which leaves it to the interpreter.
+ */
+static uint8_t*
+translate_block(APEX_Translation* t, APEX_CPU* cpu, int pc)
+{
+  unsigned int start = (unsigned int)(pc - 4000) >> 2;
+  int size = cpu->code_memory_size;
+  if (pc < 4000 || (pc & 3) || start >= (unsigned int)size ||
+      !translatable(&cpu->code_memory[start]) || set_writable(t, 1) != 0)
+  {
+    return NULL;
+  }
+  if (t->used + BLOCK_BYTES > CODE_BYTES)
+  {
+    flush(t, size);
+  }
+
+  Emitter e;
+  e.p = t->code + t->used;
+  e.num_stubs = 0;
+  uint8_t* entry = e.p;
+
+  /* sub qword [rbx + budget], n; jl back to C with the budget restored */
+  emit8(&e, 0x48);
+  emit8(&e, 0x81);
+  emit8(&e, 0x6b);
+  emit8(&e, GUEST_BUDGET);
+  uint8_t* count_site = e.p;
+  emit32(&e, 0);
+  emit8(&e, 0x0f);
+  emit8(&e, 0x8c);
+  uint8_t* budget_site = e.p;
+  emit32(&e, 0);
+
+  int n = 0;
+  for (;;)
+  {
+    unsigned int index = start + n;
+    int ins_pc = pc + 4 * n;
+    if (n == BLOCK_INSTRUCTIONS || index >= (unsigned int)size ||
+        ins_pc == t->stop_pc || !translatable(&cpu->code_memory[index]))
+    {
+      emit_exit(&e, 0, EXIT_LOOKUP, ins_pc, n);
+      break;
+    }
+
+    const APEX_Instruction* ins = &cpu->code_memory[index];
+    n++;
+    if (ins->opcode == OPCODE_BZ || ins->opcode == OPCODE_BNZ)
+    {
+      emit8(&e, 0x83);                  // cmp dword [rbx + z], 0
+      emit8(&e, 0x7b);
+      emit8(&e, GUEST_Z);
+      emit8(&e, 0x00);
+      emit_exit(&e, ins->opcode == OPCODE_BZ ? 0x85 : 0x84, EXIT_LOOKUP,
+                APEX_add(ins_pc, ins->imm), n);
+      emit_exit(&e, 0, EXIT_LOOKUP, ins_pc + 4, n);
+      break;
+    }
+    if (ins->opcode == OPCODE_JUMP)
+    {
+      emit_jump(&e, t, size, ins);
+      break;
+    }
+    emit_instruction(&e, cpu, ins, ins_pc, n - 1);
+  }
+  memcpy(count_site, &n, 4);
+
+  /* The budget stub undoes the subtraction; a step stub gives back the
+   * instructions it skips; a chain stub hands its rel32 to C to patch */
+  patch_rel32(budget_site, e.p);
+  emit8(&e, 0x48);                      // add qword [rbx + budget], n
+  emit8(&e, 0x81);
+  emit8(&e, 0x43);
+  emit8(&e, GUEST_BUDGET);
+  emit32(&e, n);
+  emit8(&e, 0xc7);                      // mov dword [rbx + pc], pc
+  emit8(&e, 0x43);
+  emit8(&e, GUEST_PC);
+  emit32(&e, pc);
+  emit8(&e, 0x31);                      // xor eax, eax
+  emit8(&e, 0xc0);
+  emit8(&e, 0xe9);                      // jmp epilogue
+  emit32(&e, 0);
+  patch_rel32(e.p - 4, t->epilogue);
+
+  for (int i = 0; i < e.num_stubs; ++i)
+  {
+    const Exit_Stub* stub = &e.stubs[i];
+    patch_rel32(stub->site, e.p);
+    if (stub->kind == STUB_REFILL)
+    {
+      /* Calls APEX_data_refill(memory, number, value) with the number in
+       * ecx, and goes on with the page unless it is missing */
+      emit8(&e, 0x41);                  // mov r12d, eax
+      emit8(&e, 0x89);
+      emit8(&e, 0xc4);
+      emit8(&e, 0x48);                  // mov rdi, memory
+      emit8(&e, 0xbf);
+      emit64(&e, (uint64_t)(uintptr_t)&cpu->data_memory);
+      emit8(&e, 0x89);                  // mov esi, ecx
+      emit8(&e, 0xce);
+      if (stub->value_reg < 0)
+      {
+        emit8(&e, 0x31);                // xor edx, edx
+        emit8(&e, 0xd2);
+      }
+      else
+      {
+        emit8(&e, 0x8b);                // mov edx, [rbx + 4 * value_reg]
+        emit8(&e, 0x53);
+        emit8(&e, stub->value_reg * 4);
+      }
+      emit8(&e, 0x48);                  // mov rax, APEX_data_refill
+      emit8(&e, 0xb8);
+      emit64(&e, (uint64_t)(uintptr_t)APEX_data_refill);
+      emit8(&e, 0xff);                  // call rax
+      emit8(&e, 0xd0);
+      emit8(&e, 0x48);                  // test rax, rax
+      emit8(&e, 0x85);
+      emit8(&e, 0xc0);
+      emit8(&e, 0x74);                  // jz step
+      emit8(&e, 16);
+      emit8(&e, 0x48);                  // mov rdx, rax
+      emit8(&e, 0x89);
+      emit8(&e, 0xc2);
+      emit8(&e, 0x44);                  // mov eax, r12d
+      emit8(&e, 0x89);
+      emit8(&e, 0xe0);
+      emit8(&e, 0x25);                  // and eax, APEX_PAGE_WORDS - 1
+      emit32(&e, APEX_PAGE_WORDS - 1);
+      emit8(&e, 0xe9);                  // jmp resume
+      emit32(&e, 0);
+      patch_rel32(e.p - 4, stub->resume);
+    }
+    if (stub->index != n)
+    {
+      emit8(&e, 0x48);                  // add qword [rbx + budget], n - index
+      emit8(&e, 0x81);
+      emit8(&e, 0x43);
+      emit8(&e, GUEST_BUDGET);
+      emit32(&e, n - stub->index);
+    }
+    emit8(&e, 0xc7);                    // mov dword [rbx + pc], pc
+    emit8(&e, 0x43);
+    emit8(&e, GUEST_PC);
+    emit32(&e, (uint32_t)stub->pc);
+    if (stub->kind != EXIT_LOOKUP)
+    {
+      emit8(&e, 0xb8);                  // mov eax, EXIT_STEP
+      emit32(&e, EXIT_STEP);
+    }
+    else
+    {
+      emit8(&e, 0x48);                  // mov rax, site
+      emit8(&e, 0xb8);
+      emit64(&e, (uint64_t)(uintptr_t)stub->site);
+    }
+    emit8(&e, 0xe9);                    // jmp epilogue
+    emit32(&e, 0);
+    patch_rel32(e.p - 4, t->epilogue);
+  }
+
+  t->used = e.p - t->code;
+  t->blocks[start] = entry;
+  t->counts[start] = n;
+  return entry;
+}
+
+/* Block at pc, compiled on first use; NULL if there can be none */
+static uint8_t*
+block_at(APEX_Translation* t, APEX_CPU* cpu, int pc)
+{
+  unsigned int index = (unsigned int)(pc - 4000) >> 2;
+  if (pc >= 4000 && !(pc & 3) && index < (unsigned int)cpu->code_memory_size &&
+      t->blocks[index])
+  {
+    return t->blocks[index];
+  }
+  return translate_block(t, cpu, pc);
+}
+
+/* Lets the interpreter run up to max instructions on the guest state */
+static long long
+interpret(APEX_CPU* cpu, Guest* guest, int stop_pc, long long max)
+{
+  memcpy(cpu->regs, guest->regs, sizeof(guest->regs));
+  cpu->z_flag_set = guest->z;
+  cpu->pc = guest->pc;
+  long long executed = APEX_cpu_interpret(cpu, stop_pc, max);
+  memcpy(guest->regs, cpu->regs, sizeof(guest->regs));
+  guest->z = cpu->z_flag_set != 0;
+  guest->pc = cpu->pc;
+  guest->budget -= executed;
+  return executed;
+}
+
+/*
+ * Executes instructions like APEX_cpu_interpret, with the same stopping
+ * rules, through translated blocks. Returns the number executed, or -1
+ * without executing any if the code buffer cannot be set up. Should
+ * mprotect fail on the way, the interpreter runs the rest, and every
+ * later call returns -1.
+ */
+long long
+APEX_cpu_translate(APEX_CPU* cpu, int stop_pc, long long max_instructions)
+{
+  APEX_Translation* t = cpu->translation;
+  if (!t)
+  {
+    t = translation_create(cpu);
+    if (!t)
+    {
+      return -1;
+    }
+    cpu->translation = t;
+  }
+  if (t->failed)
+  {
+    return -1;
+  }
+  if (t->stop_pc != stop_pc)
+  {
+    flush(t, cpu->code_memory_size);
+    t->stop_pc = stop_pc;
+  }
+
+  Guest guest;
+  memcpy(guest.regs, cpu->regs, sizeof(guest.regs));
+  guest.z = cpu->z_flag_set != 0;
+  guest.pc = cpu->pc;
+  guest.budget = max_instructions;
+
+  while (guest.budget > 0 && guest.pc != stop_pc)
+  {
+    uint8_t* block = block_at(t, cpu, guest.pc);
+    unsigned int index = (unsigned int)(guest.pc - 4000) >> 2;
+    if (!block)
+    {
+      /* HALT, a pc outside code memory or an odd one, or no buffer to
+       * compile to any more */
+      if (!interpret(cpu, &guest, stop_pc, t->failed ? guest.budget : 1))
+      {
+        break;
+      }
+      continue;
+    }
+    if (t->counts[index] > guest.budget)
+    {
+      interpret(cpu, &guest, stop_pc, guest.budget);
+      break;
+    }
+
+    if (set_writable(t, 0) != 0)
+    {
+      interpret(cpu, &guest, stop_pc, guest.budget);
+      break;
+    }
+    void* exit = t->enter(&guest, block);
+    if ((uintptr_t)exit == EXIT_STEP)
+    {
+      /* A load or store off the last page, or one that faults */
+      if (!interpret(cpu, &guest, stop_pc, 1))
+      {
+        break;
+      }
+    }
+    else if ((uintptr_t)exit != EXIT_LOOKUP && guest.pc != stop_pc)
+    {
+      /* Chain the exit to the block it leads to, unless compiling that
+       * block flushed the buffer */
+      unsigned flushes = t->flushes;
+      uint8_t* next = block_at(t, cpu, guest.pc);
+      if (next && flushes == t->flushes && set_writable(t, 1) == 0)
+      {
+        patch_rel32(exit, next);
+      }
+    }
+  }
+
+  memcpy(cpu->regs, guest.regs, sizeof(guest.regs));
+  cpu->z_flag_set = guest.z;
+  cpu->pc = guest.pc;
+  return max_instructions - guest.budget;
+}
+
+void
+APEX_translation_free(APEX_Translation* t)
+{
+  if (t)
+  {
+    munmap(t->code, CODE_BYTES);
+    free(t->blocks);
+    free(t->counts);
+    free(t);
+  }
+}
+
+#else
+
+/* Other hosts have no translator and fast-forward interprets */
+long long
+APEX_cpu_translate(APEX_CPU* cpu, int stop_pc, long long max_instructions)
+{
+  (void)cpu;
+  (void)stop_pc;
+  (void)max_instructions;
+  return -1;
+}
+
+void
+APEX_translation_free(APEX_Translation* t)
+{
+  (void)t;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef _TEST_H_
+#define _TEST_H_
+/**
+ *  test.h
+ *  Checks shared by the tests: each failed check is reported with its
+ *  line and counted, and main returns the count
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int test_failures;
+static char test_file[64];   // Program written by test_program
+
+#define CHECK(cond)                                                        \
+  do                                                                       \
+  {                                                                        \
+    if (!(cond))                                                           \
+    {                                                                      \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,    \
+              #cond);                                                      \
+      test_failures++;                                                     \
+    }                                                                      \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                     \
+  do                                                                       \
+  {                                                                        \
+    long long a_ = (a), b_ = (b);                                          \
+    if (a_ != b_)                                                          \
+    {                                                                      \
+      fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n",    \
+              __FILE__, __LINE__, #a, #b, a_, b_);                         \
+      test_failures++;                                                     \
+    }                                                                      \
+  } while (0)
+
+/* Writes a program into a temporary file and returns its name, which
+ * stays valid until the next call */
+static const char*
+test_program(const char* text)
+{
+  if (test_file[0])
+  {
+    unlink(test_file);
+  }
+  strcpy(test_file, "/tmp/apex_testXXXXXX");
+  int fd = mkstemp(test_file);
+  if (fd < 0)
+  {
+    perror("mkstemp");
+    exit(2);
+  }
+  FILE* fp = fdopen(fd, "w");
+  fputs(text, fp);
+  fclose(fp);
+  return test_file;
+}
+
+/* Removes the last program and reports the result */
+static int
+test_done(const char* test)
+{
+  if (test_file[0])
+  {
+    unlink(test_file);
+  }
+  printf("%s: %s\n", test, test_failures ? "FAILED" : "passed");
+  return test_failures != 0;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ *  test_engines.c
+ *  Runs one program through the in-order pipeline, the out-of-order
+ *  core and every fast-forward engine and checks that they all end with
+ *  the same registers. The program overflows on purpose, so the engines
+ *  are also checked to wrap around in 32 bits alike
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <limits.h>
+
+#include "cpu.h"
+#include "test.h"
+
+/* Runs the loop twice so the fast-forward engines reach it hot */
+static const char overflow_program[] =
+  "MOVC,R12,#2\n"
+  "MOVC,R1,#2147483647\n"
+  "ADDL,R2,R1,#1\n"           // INT_MIN
+  "ADD,R3,R1,R1\n"            // -2
+  "SUBL,R4,R2,#1\n"           // INT_MAX
+  "SUB,R5,R2,R1\n"            // 1
+  "MUL,R6,R1,R1\n"            // 1
+  "MOVC,R7,#65536\n"
+  "MUL,R8,R7,R7\n"            // 0, and sets Z
+  "BZ,#8\n"
+  "MOVC,R9,#1\n"
+  "MOVC,R10,#-2147483648\n"
+  "SUB,R11,R10,R12\n"         // INT_MAX, the last time round
+  "SUBL,R12,R12,#1\n"
+  "BNZ,#-52\n"
+  "HALT,\n";
+
+static const int overflow_regs[16] = {
+  [1] = INT_MAX,
+  [2] = INT_MIN,
+  [3] = -2,
+  [4] = INT_MAX,
+  [5] = 1,
+  [6] = 1,
+  [7] = 65536,
+  [8] = 0,
+  [10] = INT_MIN,
+  [11] = INT_MAX,
+  [12] = 0,
+};
+
+static void
+check_regs(const char* engine, const APEX_CPU* cpu)
+{
+  for (int i = 0; i < 16; ++i)
+  {
+    if (cpu->regs[i] != overflow_regs[i])
+    {
+      fprintf(stderr, "%s: R%d is %d, expected %d\n", engine, i,
+              cpu->regs[i], overflow_regs[i]);
+      test_failures++;
+    }
+  }
+}
+
+static APEX_CPU*
+load(const char* file, int core, int width)
+{
+  APEX_Config config;
+  APEX_config_default(&config);
+  config.core = core;
+  config.width = width;
+  APEX_CPU* cpu = APEX_cpu_init(file, "quiet", 10000);
+  CHECK(cpu != NULL);
+  if (cpu && APEX_cpu_configure(cpu, &config) != 0)
+  {
+    APEX_cpu_stop(cpu);
+    cpu = NULL;
+    test_failures++;
+  }
+  return cpu;
+}
+
+int
+main()
+{
+  const char* file = test_program(overflow_program);
+
+  for (int engine = 0; engine < APEX_ENGINE_NUM; ++engine)
+  {
+    APEX_CPU* cpu = load(file, APEX_CORE_INORDER, 1);
+    if (cpu)
+    {
+      cpu->fast_forward_engine = engine;
+      CHECK(APEX_cpu_fast_forward(cpu, -1, LLONG_MAX) > 0);
+      check_regs(engine_names[engine], cpu);
+      APEX_cpu_stop(cpu);
+    }
+  }
+
+  static const struct
+  {
+    const char* name;
+    int core;
+    int width;
+  } pipelines[] = {
+    { "in-order", APEX_CORE_INORDER, 1 },
+    { "in-order width 4", APEX_CORE_INORDER, 4 },
+    { "ooo", APEX_CORE_OOO, 1 },
+  };
+  for (size_t i = 0; i < sizeof(pipelines) / sizeof(pipelines[0]); ++i)
+  {
+    APEX_CPU* cpu = load(file, pipelines[i].core, pipelines[i].width);
+    if (cpu)
+    {
+      CHECK_EQ(APEX_cpu_run(cpu), 0);
+      check_regs(pipelines[i].name, cpu);
+      CHECK_EQ(APEX_cpu_check(cpu), 0);
+      APEX_cpu_stop(cpu);
+    }
+  }
+
+  return test_done("test_engines");
+}
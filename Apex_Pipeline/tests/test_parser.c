@@ -0,0 +1,108 @@
+/*
+ *  test_parser.c
+ *  Checks that create_code_memory loads well formed instructions and
+ *  rejects malformed operands, out of range numbers and extra operands
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include "cpu.h"
+#include "test.h"
+
+/* Parses a one line program. Returns 0 and fills ins, or -1 */
+static int
+parse(const char* line, APEX_Instruction* ins)
+{
+  int size = 0;
+  APEX_Instruction* code = create_code_memory(test_program(line), &size);
+  if (!code)
+  {
+    return -1;
+  }
+  *ins = code[0];
+  free(code);
+  return 0;
+}
+
+static void
+accepts(const char* line, int opcode, int rd, int rs1, int rs2, int imm)
+{
+  APEX_Instruction ins;
+  if (parse(line, &ins) != 0)
+  {
+    fprintf(stderr, "rejected: %s", line);
+    test_failures++;
+    return;
+  }
+  CHECK_EQ(ins.opcode, opcode);
+  CHECK_EQ(ins.rd, rd);
+  CHECK_EQ(ins.rs1, rs1);
+  CHECK_EQ(ins.rs2, rs2);
+  CHECK_EQ(ins.imm, imm);
+}
+
+static void
+rejects(const char* line)
+{
+  APEX_Instruction ins;
+  if (parse(line, &ins) == 0)
+  {
+    fprintf(stderr, "accepted: %s", line);
+    test_failures++;
+  }
+}
+
+int
+main()
+{
+  /* As the sample programs write them */
+  accepts("MOVC,R1,#11\n", OPCODE_MOVC, 1, 0, 0, 11);
+  accepts("ADD,R5,R0,R1\n", OPCODE_ADD, 5, 0, 1, 0);
+  accepts("STORE,R1,R3,#10\n", OPCODE_STORE, 0, 1, 3, 10);
+  accepts("LOAD,R2,R3,#-4\r\n", OPCODE_LOAD, 2, 3, 0, -4);
+  accepts("BZ,#-12 \n", OPCODE_BZ, 0, 0, 0, -12);
+  accepts("HALT,\n", OPCODE_HALT, 0, 0, 0, 0);
+  accepts("HALT\n", OPCODE_HALT, 0, 0, 0, 0);
+  accepts("JUMP,R2\n", OPCODE_JUMP, 0, 2, 0, 0);
+  accepts("JUMP,R2,#8\n", OPCODE_JUMP, 0, 2, 0, 8);
+  accepts("MOVC,R15,#2147483647\n", OPCODE_MOVC, 15, 0, 0, 2147483647);
+  accepts("MOVC,R15,#-2147483648\n", OPCODE_MOVC, 15, 0, 0, -2147483647 - 1);
+  accepts("\n", OPCODE_NONE, 0, 0, 0, 0);
+
+  /* Unknown mnemonics and characters after one */
+  rejects("MOV,R1,#1\n");
+  rejects("MOVC R1,#1\n");
+
+  /* Numbers that are not decimal or carry more characters */
+  rejects("MOVC,R1,#0x10\n");
+  rejects("MOVC,R1x,#1\n");
+  rejects("MOVC,R1,#12abc\n");
+  rejects("MOVC,R1,#\n");
+  rejects("MOVC,R1,# 5\n");
+
+  /* The wrong prefix */
+  rejects("MOVC,#1,#1\n");
+  rejects("MOVC,R1,R1\n");
+  rejects("ADD,R1,R2,#3\n");
+  rejects("BZ,R1\n");
+
+  /* Numbers that do not fit an int, or registers that do not exist */
+  rejects("MOVC,R1,#2147483648\n");
+  rejects("MOVC,R1,#-2147483649\n");
+  rejects("MOVC,R1,#99999999999999999999\n");
+  rejects("MOVC,R16,#1\n");
+  rejects("MOVC,R-1,#1\n");
+
+  /* Missing, empty and extra operands */
+  rejects("ADD,R1,R2\n");
+  rejects("ADD,R1,,R3\n");
+  rejects("ADD,R1,R2,R3,R4\n");
+  rejects("MOVC,R1,#1,#2\n");
+  rejects("HALT,R1\n");
+  rejects("BZ,#4,#8\n");
+  rejects("JUMP,R1,#4,#8\n");
+  rejects(",R1\n");
+
+  return test_done("test_parser");
+}
@@ -0,0 +1,110 @@
+/*
+ *  test_skip.c
+ *  Checks that skipping idle cycles, among them the cycles the pipeline
+ *  waits for a data cache miss, changes neither the cycle count nor the
+ *  CPI stack. Each run is compared with the same run profiled, which
+ *  simulates every cycle
+ *
+ *  Author :
+ *  Saheel Raut (sraut1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include "cpu.h"
+#include "test.h"
+
+/* Loads and stores a line apart, so every access misses, then runs
+ * on past the end of the program */
+static const char miss_program[] =
+  "MOVC,R1,#0\n"
+  "MOVC,R2,#6\n"
+  "LOAD,R3,R1,#0\n"
+  "ADDL,R3,R3,#1\n"
+  "STORE,R3,R1,#64\n"
+  "ADDL,R1,R1,#128\n"
+  "SUBL,R2,R2,#1\n"
+  "BNZ,#-20\n"
+  "MOVC,R4,#7\n";
+
+typedef struct Variant
+{
+  const char* name;
+  const char* options[4][2];
+} Variant;
+
+static const Variant variants[] = {
+  { "part b", { { "dcache", "miss=50" } } },
+  { "part a", { { "dcache", "miss=50" }, { "bypass", "wb" }, { "halt", "block" } } },
+  { "wide", { { "dcache", "miss=37,write=through" }, { "width", "2" } } },
+  { "short miss", { { "dcache", "miss=1" } } },
+};
+
+static APEX_CPU*
+run(const char* file, const Variant* variant, int clockcycles, int profile)
+{
+  APEX_Config config;
+  APEX_config_default(&config);
+  for (int i = 0; i < 4 && variant->options[i][0]; ++i)
+  {
+    CHECK_EQ(APEX_config_set(&config, variant->options[i][0],
+                             variant->options[i][1]), 0);
+  }
+  APEX_CPU* cpu = APEX_cpu_init(file, "quiet", clockcycles);
+  if (!cpu || APEX_cpu_configure(cpu, &config) != 0 ||
+      (profile && APEX_profile_enable(cpu) != 0))
+  {
+    fprintf(stderr, "%s: cannot set up the cpu\n", variant->name);
+    exit(2);
+  }
+  APEX_cpu_run(cpu);
+  return cpu;
+}
+
+/* Runs a variant with and without skipping and compares the outcome */
+static void
+compare(const char* file, const Variant* variant, int clockcycles)
+{
+  APEX_CPU* skipped = run(file, variant, clockcycles, 0);
+  APEX_CPU* stepped = run(file, variant, clockcycles, 1);
+
+  CHECK_EQ(skipped->clock, stepped->clock);
+  CHECK_EQ(skipped->stats.retired, stepped->stats.retired);
+  CHECK_EQ(skipped->stats.dcache_misses, stepped->stats.dcache_misses);
+  CHECK_EQ(skipped->dcache_wait, stepped->dcache_wait);
+  for (int i = 0; i < APEX_CPI_NUM; ++i)
+  {
+    if (skipped->stats.cycles[i] != stepped->stats.cycles[i])
+    {
+      fprintf(stderr, "%s, %d cycles: %s is %lld skipped, %lld stepped\n",
+              variant->name, clockcycles, cpi_names[i],
+              skipped->stats.cycles[i], stepped->stats.cycles[i]);
+      test_failures++;
+    }
+  }
+  for (int i = 0; i < 16; ++i)
+  {
+    CHECK_EQ(skipped->regs[i], stepped->regs[i]);
+  }
+  if (clockcycles == 5000)
+  {
+    CHECK(skipped->stats.cycles[APEX_CPI_DCACHE] > 0);
+  }
+  APEX_cpu_stop(skipped);
+  APEX_cpu_stop(stepped);
+}
+
+int
+main()
+{
+  const char* file = test_program(miss_program);
+  for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); ++i)
+  {
+    /* Well past the end, and stopped by the cycle limit in the middle of
+     * misses */
+    compare(file, &variants[i], 5000);
+    for (int clockcycles = 10; clockcycles < 400; clockcycles += 23)
+    {
+      compare(file, &variants[i], clockcycles);
+    }
+  }
+  return test_done("test_skip");
+}